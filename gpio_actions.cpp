@@ -0,0 +1,271 @@
+#include <fcntl.h>
+
+#include <gpio_actions.hpp>
+#include <gpio_measurement.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/bus.hpp>
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <sstream>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Transitions waiting for a worker above this number are dropped **/
+static constexpr size_t actionQueueCapacity = 256;
+
+static constexpr const char* systemdService = "org.freedesktop.systemd1";
+static constexpr const char* systemdObjectPath = "/org/freedesktop/systemd1";
+static constexpr const char* systemdManagerInterface =
+    "org.freedesktop.systemd1.Manager";
+
+/** @brief The system bus connection of a worker, opened on its first DBus
+ * action **/
+struct GpioActions::WorkerBus
+{
+    std::optional<sdbusplus::bus_t> bus;
+
+    sdbusplus::bus_t& get()
+    {
+        if (!bus)
+        {
+            bus.emplace(sdbusplus::bus::new_default_system());
+        }
+        return *bus;
+    }
+};
+
+/** @brief Outcome of a single action **/
+enum class ActionResult
+{
+    done,
+    failed,
+    timedOut,
+};
+
+GpioActions::GpioActions(const GpioJsonConfig& gpioConfig,
+                         GlobalStats& globalStats, unsigned workerCount) :
+    globalStats(globalStats),
+    queue(actionQueueCapacity)
+{
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        pinActions.push_back(
+            PinActions{pin.name, GpioJsonConfig::getActions(pin, true),
+                       GpioJsonConfig::getActions(pin, false),
+                       GpioJsonConfig::getActionTimeoutNs(pin)});
+    }
+    for (auto i = 0u; i < max(workerCount, 1u); ++i)
+    {
+        workers.emplace_back(&GpioActions::runWorker, this);
+    }
+}
+
+GpioActions::~GpioActions()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    transitionQueued.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+bool GpioActions::hasActions(const GpioJsonConfig& gpioConfig)
+{
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        if (pin.onRising.has_value() || pin.onFalling.has_value())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GpioActions::trigger(uint16_t pinIndex, bool rising,
+                          uint64_t detectedNs) noexcept
+{
+    const PinActions& actions = pinActions[pinIndex];
+    if ((rising ? actions.onRising : actions.onFalling).empty())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (queuedCount == queue.size())
+        {
+            globalStats.actionsDropped.inc();
+            return;
+        }
+        queue[(queueHead + queuedCount) % queue.size()] =
+            Transition{pinIndex, rising, detectedNs};
+        ++queuedCount;
+    }
+    transitionQueued.notify_one();
+}
+
+void GpioActions::runWorker() noexcept
+{
+    WorkerBus bus;
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        transitionQueued.wait(lock,
+                              [this]() { return stopping || queuedCount > 0; });
+        if (stopping)
+        {
+            return;
+        }
+        Transition transition = queue[queueHead];
+        queueHead = (queueHead + 1) % queue.size();
+        --queuedCount;
+        lock.unlock();
+        runActions(transition, bus);
+        lock.lock();
+    }
+}
+
+/** @brief Make the @method call with the string @arguments on the @bus,
+ * abandoned after @timeoutNs **/
+static ActionResult callMethod(sdbusplus::bus_t& bus, const char* service,
+                               const char* objectPath, const char* interface,
+                               const char* method,
+                               const vector<string>& arguments,
+                               uint64_t timeoutNs, string& error)
+{
+    try
+    {
+        auto call = bus.new_method_call(service, objectPath, interface, method);
+        for (const auto& argument : arguments)
+        {
+            call.append(argument);
+        }
+        bus.call(call, timeoutNs / 1000);
+        return ActionResult::done;
+    }
+    catch (const sdbusplus::exception::SdBusError& e)
+    {
+        error = e.what();
+        return e.get_errno() == ETIMEDOUT ? ActionResult::timedOut
+                                          : ActionResult::failed;
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+        return ActionResult::failed;
+    }
+}
+
+/** @brief Write @value to the @fileName, like a sysfs attribute **/
+static ActionResult writeFile(const string& fileName, const string& value,
+                              uint64_t timeoutNs, string& error)
+{
+    uint64_t startNs = EdgeMeter::nowNs();
+    int fd = open(fileName.c_str(), O_WRONLY | O_CLOEXEC);
+    bool written = fd >= 0 && write(fd, value.data(), value.size()) ==
+                                  (ssize_t)value.size();
+    int lastErrno = errno;
+    // Closing doesn't fail a sysfs write, it's done by then
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (!written)
+    {
+        error = strerror(lastErrno);
+        return ActionResult::failed;
+    }
+    return EdgeMeter::nowNs() - startNs > timeoutNs ? ActionResult::timedOut
+                                                    : ActionResult::done;
+}
+
+void GpioActions::runActions(const Transition& transition,
+                             WorkerBus& bus) noexcept
+{
+    const PinActions& pin = pinActions[transition.pinIndex];
+    uint64_t startNs = EdgeMeter::nowNs();
+    globalStats.actionLatency.add(
+        startNs > transition.detectedNs ? startNs - transition.detectedNs : 0);
+    for (const auto& action : transition.rising ? pin.onRising : pin.onFalling)
+    {
+        ActionResult result = ActionResult::failed;
+        string error;
+        try
+        {
+            const vector<string>& arguments = action.arguments;
+            switch (action.type)
+            {
+                case PinActionType::startUnit:
+                case PinActionType::stopUnit:
+                case PinActionType::restartUnit:
+                {
+                    const char* method =
+                        action.type == PinActionType::startUnit ? "StartUnit"
+                        : action.type == PinActionType::stopUnit
+                            ? "StopUnit"
+                            : "RestartUnit";
+                    result = callMethod(bus.get(), systemdService,
+                                        systemdObjectPath,
+                                        systemdManagerInterface, method,
+                                        {arguments[0], "replace"},
+                                        pin.timeoutNs, error);
+                    break;
+                }
+                case PinActionType::call:
+                    result = callMethod(
+                        bus.get(), arguments[0].c_str(), arguments[1].c_str(),
+                        arguments[2].c_str(), arguments[3].c_str(),
+                        vector<string>(arguments.begin() + 4, arguments.end()),
+                        pin.timeoutNs, error);
+                    break;
+                case PinActionType::write:
+                    result = writeFile(arguments[0], arguments[1],
+                                       pin.timeoutNs, error);
+                    break;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            // Failed to connect to the bus
+            error = e.what();
+        }
+        if (result != ActionResult::done)
+        {
+            globalStats.actionFailures.inc();
+            stringstream ss;
+            ss << "Action '" << action.text << "' on the "
+               << (transition.rising ? "rising" : "falling") << " transition "
+               << (result == ActionResult::timedOut ? "timed out" : "failed");
+            if (!error.empty())
+            {
+                ss << ": " << error;
+            }
+            logPinOperation<level::WARNING>(ss.str().c_str(), pin.pinName);
+        }
+#ifdef ENABLE_GSH_LOGS
+        else
+        {
+            stringstream ss;
+            ss << "Action '" << action.text << "' done";
+            logPinOperation<level::INFO>(ss.str().c_str(), pin.pinName);
+        }
+#endif
+    }
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <gpio_json_config.hpp>
+#include <gpio_stats.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Runs the actions of the pin transitions (see @ref
+ * GpioJsonConfig::getActions) on a fixed number of worker threads
+ *
+ * A transition only takes a slot of a preallocated queue under a short lock
+ * and wakes up a worker, so the monitoring threads never wait for an action
+ * and allocate no memory. When all the slots are taken, the transition's
+ * actions are dropped and counted (see @ref GlobalStats::actionsDropped).
+ *
+ * A worker runs the actions of a transition one after another. The DBus
+ * method calls, also those starting or stopping the systemd units, are made
+ * on the worker's own blocking system bus connection and abandoned after the
+ * pin's action timeout. A write to a file can't be interrupted, it's only
+ * reported as timed out when it took longer. The time from the detection of
+ * the transition until its first action started is counted in @ref
+ * GlobalStats::actionLatency, the failed actions in @ref
+ * GlobalStats::actionFailures.
+ */
+class GpioActions
+{
+  public:
+    /**
+     * @brief Start @workerCount threads running the actions of the pins of
+     * @gpioConfig, counted in @globalStats.
+     *
+     * Throw @ref GpioConfigError if an action is not valid.
+     */
+    GpioActions(const GpioJsonConfig& gpioConfig, GlobalStats& globalStats,
+                unsigned workerCount);
+
+    /** @brief Stop the workers, once done with their current actions. The
+     * actions still queued are not run. **/
+    ~GpioActions();
+
+    GpioActions(const GpioActions&) = delete;
+    GpioActions& operator=(const GpioActions&) = delete;
+
+    /** @brief True if any pin of the config passed to the constructor has
+     * actions **/
+    static bool hasActions(const GpioJsonConfig& gpioConfig);
+
+    /**
+     * @brief Queue the actions of the @rising or falling transition of the pin
+     * @pinIndex, detected at @detectedNs on the clock of @ref
+     * EdgeMeter::nowNs. Can be called from any thread.
+     */
+    void trigger(uint16_t pinIndex, bool rising, uint64_t detectedNs) noexcept;
+
+  private:
+    /** @brief The actions of a pin, see @ref GpioJsonConfig **/
+    struct PinActions
+    {
+        std::string pinName;
+        std::vector<PinAction> onRising;
+        std::vector<PinAction> onFalling;
+        uint64_t timeoutNs;
+    };
+
+    struct WorkerBus;
+
+    /** @brief A transition waiting for a worker **/
+    struct Transition
+    {
+        uint16_t pinIndex;
+        bool rising;
+        uint64_t detectedNs;
+    };
+
+    GlobalStats& globalStats;
+    /** @brief Indexed by the pin position in the config **/
+    std::vector<PinActions> pinActions;
+
+    std::mutex queueMutex;
+    std::condition_variable transitionQueued;
+    /** @brief Ring of the queued transitions, never reallocated **/
+    std::vector<Transition> queue;
+    size_t queueHead = 0;
+    size_t queuedCount = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void runWorker() noexcept;
+    void runActions(const Transition& transition, WorkerBus& bus) noexcept;
+};
+
+} // namespace gpio_handler
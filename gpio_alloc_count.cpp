@@ -0,0 +1,89 @@
+#include <gpio_alloc_count.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+// Both constant initialized, so usable by the allocations made before any
+// constructor ran
+static atomic<uint64_t> steadyStateAllocations{0};
+static thread_local unsigned steadyStateDepth = 0;
+
+static void countAllocation() noexcept
+{
+    if (steadyStateDepth > 0)
+    {
+        steadyStateAllocations.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+SteadyStateScope::SteadyStateScope() noexcept
+{
+    ++steadyStateDepth;
+}
+
+SteadyStateScope::~SteadyStateScope()
+{
+    --steadyStateDepth;
+}
+
+uint64_t getSteadyStateAllocations() noexcept
+{
+    return steadyStateAllocations.load(memory_order_relaxed);
+}
+
+} // namespace gpio_handler
+
+// The replaceable global allocation functions. The array and the non-throwing
+// forms of the standard library forward to these.
+
+void* operator new(size_t size)
+{
+    gpio_handler::countAllocation();
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size, align_val_t alignment)
+{
+    gpio_handler::countAllocation();
+    // 'aligned_alloc' requires the size to be a multiple of the alignment
+    size_t align = static_cast<size_t>(alignment);
+    void* memory = aligned_alloc(align, (max(size, (size_t)1) + align - 1) /
+                                            align * align);
+    if (memory == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, align_val_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t, align_val_t) noexcept
+{
+    free(memory);
+}
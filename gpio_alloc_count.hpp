@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Marks the calling thread as being in its steady state for the
+ * lifetime of the object
+ *
+ * Once a monitoring thread has started, serving an edge, a poll or a
+ * hand-over up to the DBus property update must not allocate heap memory. In
+ * the SANDBOX_MODE builds the global operator new is replaced by one counting
+ * the allocations made by the threads in the steady state (see @ref
+ * getSteadyStateAllocations). The C libraries allocating with malloc, like
+ * sd-bus for its messages, are not counted. In the other builds the class
+ * does nothing.
+ *
+ * The scopes may nest.
+ */
+class SteadyStateScope
+{
+  public:
+#ifdef SANDBOX_MODE
+    SteadyStateScope() noexcept;
+    ~SteadyStateScope();
+#else
+    SteadyStateScope() noexcept
+    {}
+#endif
+
+    SteadyStateScope(const SteadyStateScope&) = delete;
+    SteadyStateScope& operator=(const SteadyStateScope&) = delete;
+};
+
+#ifdef SANDBOX_MODE
+/** @brief Number of the heap allocations made by the threads in their steady
+ * state since the service started **/
+uint64_t getSteadyStateAllocations() noexcept;
+#endif
+
+} // namespace gpio_handler
@@ -0,0 +1,120 @@
+#include <gpio_change_log.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+namespace gpio_handler
+{
+
+GpioChangeLog::GpioChangeLog(const GpioJsonConfig& jsonConfig,
+                             size_t capacity) :
+    entries(capacity),
+    generation(chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::system_clock::now().time_since_epoch())
+                   .count())
+{
+    if (capacity == 0)
+    {
+        throw invalid_argument("Change log capacity must be positive");
+    }
+    for (const auto& pin : jsonConfig.getPins())
+    {
+        for (const auto& property : GpioJsonConfig::getProperties(pin))
+        {
+            propertyNames.push_back(property.name);
+            isInteger.push_back(property.isInteger);
+            currentValues.push_back(property.initial);
+        }
+    }
+}
+
+void GpioChangeLog::append(uint16_t propertyIndex, uint64_t value) noexcept
+{
+    lock_guard<std::mutex> lock(mutex);
+    entries[(oldest + count) % entries.size()] = Entry{propertyIndex, value};
+    if (count < entries.size())
+    {
+        ++count;
+    }
+    else
+    {
+        oldest = (oldest + 1) % entries.size();
+    }
+    currentValues[propertyIndex] = value;
+    ++generation;
+}
+
+uint64_t GpioChangeLog::getGeneration() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return generation;
+}
+
+uint64_t GpioChangeLog::getValue(uint16_t propertyIndex) const noexcept
+{
+    lock_guard<std::mutex> lock(mutex);
+    return currentValues[propertyIndex];
+}
+
+uint64_t GpioChangeLog::getValues(vector<uint64_t>& values) const
+{
+    lock_guard<std::mutex> lock(mutex);
+    values = currentValues;
+    return generation;
+}
+
+PinChanges GpioChangeLog::getChangesSince(uint64_t since) const
+{
+    lock_guard<std::mutex> lock(mutex);
+    PinChanges result;
+    auto& [fullResync, currentGeneration, values] = result;
+    currentGeneration = generation;
+    // The log holds the generations (generation - count, generation]
+    fullResync = since > generation || generation - since > count;
+    if (fullResync)
+    {
+        for (auto i = 0u; i < propertyNames.size(); ++i)
+        {
+            values[propertyNames[i]] = toPinValue(i, currentValues[i]);
+        }
+    }
+    else
+    {
+        // Oldest first, so that the latest value of a pin wins
+        for (auto i = count - (generation - since); i < count; ++i)
+        {
+            const Entry& entry = entries[(oldest + i) % entries.size()];
+            values[propertyNames[entry.propertyIndex]] =
+                toPinValue(entry.propertyIndex, entry.value);
+        }
+    }
+    return result;
+}
+
+void GpioChangeLog::createDbusInterface(sdbusplus::asio::object_server& server,
+                                        const string& objectPath,
+                                        const string& interfaceName)
+{
+    dbusInterface = server.add_interface(objectPath, interfaceName);
+    dbusInterface->register_property_r(
+        "Generation", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return getGeneration(); });
+    dbusInterface->register_method(
+        "GetChangesSince",
+        [this](uint64_t since) { return getChangesSince(since); });
+    dbusInterface->initialize();
+}
+
+PinValue GpioChangeLog::toPinValue(uint16_t propertyIndex,
+                                   uint64_t value) const
+{
+    if (isInteger[propertyIndex])
+    {
+        return value;
+    }
+    return value != 0;
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <gpio_json_config.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/** @brief Value of a pin property: boolean for a pin, integer for a bus or a
+ * measurement **/
+using PinValue = std::variant<bool, uint64_t>;
+
+/**
+ * @brief Reply of the 'GetChangesSince' method, DBus signature '(bta{sv})':
+ * full resync flag, current generation and the pin values
+ */
+using PinChanges = std::tuple<bool, uint64_t, std::map<std::string, PinValue>>;
+
+/**
+ * @brief Bounded log of the published pin changes, each numbered by a
+ * generation
+ *
+ * Every change published on the DBus interface increments the generation by
+ * one. The last @capacity changes are kept, so a client which knows the
+ * generation it was synchronized at can fetch only the pins changed since
+ * then, rather than all of them with 'GetAll'.
+ *
+ * The generations of a service instance start at the realtime clock in
+ * nanoseconds at its startup. A generation obtained from a previous instance
+ * of the service is thus older than anything in the log (unless the clock went
+ * back) and leads to a full resynchronization.
+ *
+ * The class is thread-safe.
+ */
+class GpioChangeLog
+{
+  public:
+    /**
+     * @brief Create the empty log of the properties of the pins in
+     * @jsonConfig (see @ref GpioJsonConfig::getProperties), holding at most
+     * @capacity changes. The current values are the initial ones.
+     *
+     * Throw @ref std::invalid_argument if @capacity is zero.
+     */
+    GpioChangeLog(const GpioJsonConfig& jsonConfig, size_t capacity);
+
+    GpioChangeLog(const GpioChangeLog&) = delete;
+    GpioChangeLog& operator=(const GpioChangeLog&) = delete;
+
+    /**
+     * @brief Log the publication of @value on the property @propertyIndex (the
+     * position among the properties of all the config entries, see @ref
+     * MonitoredPin::propertyIndex) as the next generation.
+     */
+    void append(uint16_t propertyIndex, uint64_t value) noexcept;
+
+    /** @brief The generation of the last published change **/
+    uint64_t getGeneration() const;
+
+    /** @brief The last published value of the property @propertyIndex, see
+     * @ref append **/
+    uint64_t getValue(uint16_t propertyIndex) const noexcept;
+
+    /**
+     * @brief Copy the last published values of all the properties, by their
+     * position, to @values, resized to fit.
+     *
+     * @return The generation of the last change among the @values.
+     */
+    uint64_t getValues(std::vector<uint64_t>& values) const;
+
+    /**
+     * @brief Get the latest values of the pins changed after @generation,
+     * together with the current generation.
+     *
+     * If the changes since @generation are not all in the log anymore (or
+     * @generation is not known to this instance of the service) the full
+     * resync flag is set and the values of all the pins are returned.
+     */
+    PinChanges getChangesSince(uint64_t generation) const;
+
+    /**
+     * @brief Add the @interfaceName interface to the @objectPath object
+     * in @server with the 'Generation' (t) read-only property and the
+     * 'GetChangesSince' (t) -> (bta{sv}) method.
+     */
+    void createDbusInterface(sdbusplus::asio::object_server& server,
+                             const std::string& objectPath,
+                             const std::string& interfaceName);
+
+  private:
+    struct Entry
+    {
+        uint16_t propertyIndex;
+        uint64_t value;
+    };
+
+    /** @brief Indexed by the property position **/
+    std::vector<std::string> propertyNames;
+    std::vector<bool> isInteger;
+    std::vector<uint64_t> currentValues;
+
+    mutable std::mutex mutex;
+    /** @brief Ring buffer of the last changes, oldest at @ref oldest **/
+    std::vector<Entry> entries;
+    size_t oldest = 0;
+    size_t count = 0;
+    uint64_t generation;
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+
+    PinValue toPinValue(uint16_t propertyIndex, uint64_t value) const;
+};
+
+} // namespace gpio_handler
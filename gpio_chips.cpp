@@ -1,6 +1,8 @@
 #include <gpio_chips.hpp>
 #include <gpio_utils.hpp>
 
+#include <filesystem>
+
 using phosphor::logging::entry;
 using phosphor::logging::level;
 using phosphor::logging::log;
@@ -14,7 +16,7 @@ namespace gpio_handler
 GpioChips::GpioChips(const GpioJsonConfig& jsonConfig)
 {
     int lastErrno = 0;
-    if (!openGpioChips(jsonConfig.getConfig(), lastErrno))
+    if (!openGpioChips(jsonConfig.getPins(), lastErrno))
     {
         throw std::system_error(
             std::error_code(lastErrno, std::system_category()),
@@ -55,10 +57,10 @@ void GpioChips::closeGpioChips() noexcept
 }
 
 // Return 'true' if and only if all gpio chips specified in
-// 'jsonConfig' were opened successfully. If 'false' then the
+// 'pins' were opened successfully. If 'false' then the
 // resulting map 'dbusPropMapChipObj' is always empty.
-// If result is 'true' then all keys in 'jsonConfig' are present in
-// 'dbusPropMapChipObj' as well, and only them.
+// If result is 'true' then all names in 'pins' are present in
+// 'dbusPropMapChipObj' as keys, and only them.
 
 // A specific gpio line on the given chip cannot be requested by
 // means of 'gpiod_line_request_both_edges_events' or the like
@@ -77,58 +79,121 @@ void GpioChips::closeGpioChips() noexcept
 // specified by number only, and the "/dev/gpiochip" prefix is
 // being added by the program itself.
 
-bool GpioChips::openGpioChips(const json& jsonConfig, int& lastErrno) noexcept
+bool GpioChips::openGpioChips(const vector<GpioPinConfig>& pins,
+                              int& lastErrno) noexcept
 {
     // assert(dbusPropMapChipObj.empty()); // (1)
     bool allChipsOpenable = true;
-    for (auto it = jsonConfig.cbegin();
-         it != jsonConfig.cend() && allChipsOpenable; ++it)
+    for (auto it = pins.cbegin(); it != pins.cend() && allChipsOpenable; ++it)
     {
-        string pinName = it.key();
-        unsigned gpioChipNum = it.value()[GpioJsonConfig::configKeyGpioChip];
-        // The call to 'gpiod_chip_open_by_number', if
-        // successful, always results in the allocation of new
-        // object (source: lib source). (101)
-
-#ifdef ENABLE_GSH_LOGS
+        bool missing = false;
+        allChipsOpenable = openGpioChip(*it, missing, lastErrno) || missing;
+        if (missing)
         {
-            stringstream ss;
-            ss << "Opening chip " << gpioChipNum << " (by '" << pinName << "')"
-               << endl;
-            log<level::INFO>(ss.str().c_str(), pinNameEntry(pinName));
+            string chipName =
+                "gpiochip" + to_string(GpioJsonConfig::getChipNumber(*it));
+            log<level::WARNING>(
+                "Gpio chip doesn't exist, pin unavailable until it appears",
+                pinNameEntry(it->name), chipEntry(chipName));
+            missingPins.insert(it->name);
         }
-#endif
-        gpiod_chip_t* gpioChip = gpiod_chip_open_by_number(gpioChipNum);
-        if (gpioChip != NULL)
-        {
+    }
+    if (!allChipsOpenable)
+    {
+        // Close the chips opened so far;
+        closeGpioChips();
+        missingPins.clear();
+    }
+    return allChipsOpenable;
+}
+
+// Open the chip of 'pin' into 'dbusPropMapChipObj'. On failure set 'missing'
+// if the chip doesn't exist, otherwise log the error and set 'lastErrno'.
+bool GpioChips::openGpioChip(const GpioPinConfig& pin, bool& missing,
+                             int& lastErrno) noexcept
+{
+    const string& pinName = pin.name;
+    unsigned gpioChipNum = GpioJsonConfig::getChipNumber(pin);
+    // The call to 'gpiod_chip_open_by_number', if
+    // successful, always results in the allocation of new
+    // object (source: lib source). (101)
+
 #ifdef ENABLE_GSH_LOGS
-            {
-                stringstream ss;
-                ss << "Chip '" << gpiod_chip_name(gpioChip) << "' opened";
-                log<level::INFO>(ss.str().c_str(),
-                                 chipEntry(gpiod_chip_name(gpioChip)),
-                                 pinNameEntry(pinName));
-            }
+    {
+        stringstream ss;
+        ss << "Opening chip " << gpioChipNum << " (by '" << pinName << "')"
+           << endl;
+        log<level::INFO>(ss.str().c_str(), pinNameEntry(pinName));
+    }
 #endif
-            // assert(!dbusPropMapChipObj.contains(pinName));
-            // ^ Satisfied by (1) and keys uniqueness in 'jsonConfig'
-            dbusPropMapChipObj[pinName] = gpioChip;
-        }
-        else // ! gpioChip
+    gpiod_chip_t* gpioChip = gpiod_chip_open_by_number(gpioChipNum);
+    if (gpioChip == NULL)
+    {
+        missing = errno == ENOENT;
+        if (!missing)
         {
             lastErrno = errno;
             stringstream funcall;
             funcall << "gpiod_chip_open_by_number(" << gpioChipNum << ")";
             logLibgpioCallError(funcall, (int)NULL, lastErrno);
-            allChipsOpenable = false;
         }
+        return false;
     }
-    if (!allChipsOpenable)
+#ifdef ENABLE_GSH_LOGS
     {
-        // Close the chips opened so far;
-        closeGpioChips();
+        stringstream ss;
+        ss << "Chip '" << gpiod_chip_name(gpioChip) << "' opened";
+        log<level::INFO>(ss.str().c_str(), chipEntry(gpiod_chip_name(gpioChip)),
+                         pinNameEntry(pinName));
     }
-    return allChipsOpenable;
+#endif
+    // assert(!dbusPropMapChipObj.contains(pinName));
+    // ^ Satisfied by (1) and names uniqueness in 'pins'
+    dbusPropMapChipObj[pinName] = gpioChip;
+    return true;
+}
+
+const set<string>& GpioChips::getMissingPins() const
+{
+    return missingPins;
+}
+
+bool GpioChips::attachPin(const GpioPinConfig& pin, int& lastErrno) noexcept
+{
+    bool missing = false;
+    if (!openGpioChip(pin, missing, lastErrno))
+    {
+        return false;
+    }
+    missingPins.erase(pin.name);
+    return true;
+}
+
+void GpioChips::detachPin(const string& pinName) noexcept
+{
+    auto it = dbusPropMapChipObj.find(pinName);
+    if (it != dbusPropMapChipObj.end())
+    {
+        gpiod_chip_close(it->second);
+        dbusPropMapChipObj.erase(it);
+    }
+    missingPins.insert(pinName);
+}
+
+bool isBusAttachedChip(const string& chipName) noexcept
+{
+    // ie "/sys/devices/platform/ahb/ahb:apb/1e78a100.i2c-bus/i2c-3/3-0020/
+    // gpiochip3"
+    error_code ec;
+    auto devicePath =
+        filesystem::canonical("/sys/bus/gpio/devices/" + chipName, ec);
+    if (ec)
+    {
+        return false;
+    }
+    string path = devicePath.string();
+    return path.find("/i2c-") != string::npos ||
+           path.find("/spi") != string::npos;
 }
 
 } // namespace gpio_handler
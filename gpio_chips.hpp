@@ -6,7 +6,9 @@
 #include <gpio_status_handler.hpp>
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace gpio_handler
 {
@@ -24,9 +26,14 @@ class GpioChips
      * object. If a single gpio chip is associated with multiple entries it is
      * opened multiple times.
      *
-     * Throw @ref std::system_error if not all chips requested in @jsonConfig
-     * could be opened. Strong exception guarantee (the state of the program is
-     * rolled back to the state just before the constructor call).
+     * A chip which doesn't exist (yet) is not an error: its pins are left out
+     * of @ref getDbusPropMapChipObj and listed by @ref getMissingPins, to be
+     * attached when it appears (see @ref attachPin).
+     *
+     * Throw @ref std::system_error if not all the existing chips requested in
+     * @jsonConfig could be opened. Strong exception guarantee (the state of
+     * the program is rolled back to the state just before the constructor
+     * call).
      */
     explicit GpioChips(const GpioJsonConfig& jsonConfig);
 
@@ -45,12 +52,40 @@ class GpioChips
      */
     const std::map<std::string, gpiod_chip_t*>& getDbusPropMapChipObj() const;
 
+    /** @brief Names of the pins whose gpio chip doesn't exist at the moment **/
+    const std::set<std::string>& getMissingPins() const;
+
+    /**
+     * @brief Open the gpio chip of the missing @pin (see @ref getMissingPins).
+     *
+     * @return True if opened. False if the chip still doesn't exist, or
+     * couldn't be opened with @lastErrno set; the pin stays missing.
+     */
+    bool attachPin(const GpioPinConfig& pin, int& lastErrno) noexcept;
+
+    /** @brief Close the gpio chip of the pin @pinName, which becomes
+     * missing **/
+    void detachPin(const std::string& pinName) noexcept;
+
   private:
     std::map<std::string, gpiod_chip_t*> dbusPropMapChipObj;
+    std::set<std::string> missingPins;
 
-    bool openGpioChips(const nlohmann::json& jsonConfig,
+    bool openGpioChips(const std::vector<GpioPinConfig>& pins,
                        int& lastErrno) noexcept;
+    bool openGpioChip(const GpioPinConfig& pin, bool& missing,
+                      int& lastErrno) noexcept;
     void closeGpioChips() noexcept;
 };
 
+/**
+ * @brief True if the gpio chip @chipName (ie "gpiochip3") is a device on an I2C
+ * or SPI bus, like a gpio expander, where every line access is a bus
+ * transaction.
+ *
+ * Decided by the sysfs path of the chip's device. False if it can't be
+ * resolved.
+ */
+bool isBusAttachedChip(const std::string& chipName) noexcept;
+
 } // namespace gpio_handler
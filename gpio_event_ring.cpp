@@ -0,0 +1,117 @@
+#include <poll.h>
+
+#include <gpio_event_ring.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+/** @brief Maximal number of completions reaped at once, before the ones
+ * of the cancellations are filtered out **/
+static constexpr unsigned maxReapedCompletions = 64;
+
+GpioEventRing::GpioEventRing(unsigned requests)
+{
+    // The completion queue is twice as long, leaving room for the
+    // cancellations in flight
+    int result = io_uring_queue_init(requests, &ring, 0);
+    if (result < 0)
+    {
+        throw system_error(error_code(-result, system_category()),
+                           "Failed to set up the io_uring");
+    }
+}
+
+GpioEventRing::~GpioEventRing()
+{
+    io_uring_queue_exit(&ring);
+}
+
+bool GpioEventRing::read(int fd, void* buffer, unsigned size,
+                         void* data) noexcept
+{
+    struct io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+    {
+        return false;
+    }
+    // The offset is ignored by the non-seekable descriptors
+    io_uring_prep_read(sqe, fd, buffer, size, 0);
+    io_uring_sqe_set_data(sqe, data);
+    return true;
+}
+
+bool GpioEventRing::poll(int fd, void* data) noexcept
+{
+    struct io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+    {
+        return false;
+    }
+    io_uring_prep_poll_add(sqe, fd, POLLIN);
+    io_uring_sqe_set_data(sqe, data);
+    return true;
+}
+
+bool GpioEventRing::cancel(void* data) noexcept
+{
+    struct io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+    {
+        return false;
+    }
+    io_uring_prep_cancel(sqe, data, 0);
+    // The ring itself denotes the completions of the cancellations
+    io_uring_sqe_set_data(sqe, this);
+    return true;
+}
+
+int GpioEventRing::wait(int timeoutMs, Completion* completions,
+                        unsigned maxCompletions) noexcept
+{
+    struct __kernel_timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000ll;
+    struct io_uring_cqe* cqe = nullptr;
+    int result = io_uring_submit_and_wait_timeout(
+        &ring, &cqe, 1, timeoutMs < 0 ? nullptr : &timeout, nullptr);
+    if (result < 0 && result != -ETIME && result != -EINTR)
+    {
+        errno = -result;
+        return -1;
+    }
+    // Whatever completed by now, reaped without another system call
+    struct io_uring_cqe* cqes[maxReapedCompletions];
+    unsigned reaped = io_uring_peek_batch_cqe(
+        &ring, cqes, min(maxCompletions, maxReapedCompletions));
+    unsigned taken = 0;
+    for (auto i = 0u; i < reaped; ++i)
+    {
+        void* data = io_uring_cqe_get_data(cqes[i]);
+        if (data != this)
+        {
+            completions[taken++] = Completion{data, cqes[i]->res};
+        }
+    }
+    io_uring_cq_advance(&ring, reaped);
+    return taken;
+}
+
+struct io_uring_sqe* GpioEventRing::getSqe() noexcept
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr)
+    {
+        // The submission queue is full, make room by submitting it early
+        io_uring_submit(&ring);
+        sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <liburing.h>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief The io_uring of a worker thread of the @ref GpioWorkerPool, keeping
+ * a read posted on every line event descriptor of the worker
+ *
+ * The requests are queued without a system call and submitted by the next
+ * @ref wait, which also waits for and reaps the completions, so a wakeup of
+ * the worker costs a single io_uring_enter call, whatever the number of lines
+ * that became ready and of reads re-posted. Every request carries a data
+ * pointer, returned with its completion.
+ *
+ * Used by its worker thread only, except for the construction.
+ */
+class GpioEventRing
+{
+  public:
+    /** @brief A completed request: its data and its result, the number of
+     * bytes read or a negative errno **/
+    struct Completion
+    {
+        void* data;
+        int result;
+    };
+
+    /**
+     * @brief Create a ring for up to @requests outstanding requests.
+     *
+     * Throw @ref std::system_error if the ring could not be set up.
+     */
+    explicit GpioEventRing(unsigned requests);
+
+    ~GpioEventRing();
+
+    GpioEventRing(const GpioEventRing&) = delete;
+    GpioEventRing& operator=(const GpioEventRing&) = delete;
+
+    /** @brief Queue a read of up to @size bytes of @fd into @buffer,
+     * completed with @data. False if the request could not be queued. **/
+    bool read(int fd, void* buffer, unsigned size, void* data) noexcept;
+
+    /** @brief Queue a wait for @fd to become readable, without reading it,
+     * completed with @data. False if the request could not be queued. **/
+    bool poll(int fd, void* data) noexcept;
+
+    /**
+     * @brief Queue the cancellation of the request with @data, completed
+     * with -ECANCELED unless it completes otherwise meanwhile. False if the
+     * cancellation could not be queued.
+     *
+     * The cancellation itself has no completion taken by @ref wait.
+     */
+    bool cancel(void* data) noexcept;
+
+    /**
+     * @brief Submit the queued requests and wait up to @timeoutMs (forever if
+     * negative) for a completion, by a single system call, then take up to
+     * @maxCompletions completions into @completions.
+     *
+     * @return The number of completions taken, 0 if the timeout expired, -1
+     * with errno set on an error.
+     */
+    int wait(int timeoutMs, Completion* completions,
+             unsigned maxCompletions) noexcept;
+
+  private:
+    struct io_uring ring;
+
+    struct io_uring_sqe* getSqe() noexcept;
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,542 @@
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <gpio_alloc_count.hpp>
+#include <gpio_event_stream.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Capacity of the queue between the monitoring threads and the DBus
+ * server thread [records] **/
+static constexpr size_t eventStreamQueueRecords = 16384;
+
+/** @brief Capacity of the buffer of every subscriber [records] **/
+static constexpr size_t subscriberBufferRecords = 4096;
+
+/** @brief Subscribers above this number are refused **/
+static constexpr size_t maxSubscribers = 16;
+
+/**
+ * @brief Memory for the handler of one asynchronous operation at a time
+ *
+ * The asio handler memory cache of a thread keeps a single block, so with the
+ * hand-over wait and a write wait both outstanding one of them would allocate.
+ * The operations of the steady state get their own block instead (see @ref
+ * SteadyStateScope). The block is shared by the handler and its allocator, as
+ * a cancelled operation may be freed after its initiator is gone.
+ */
+struct GpioEventStream::HandlerMemory
+{
+    alignas(max_align_t) unsigned char storage[256];
+    bool inUse = false;
+
+    void* allocate(size_t size)
+    {
+        if (!inUse && size <= sizeof(storage))
+        {
+            inUse = true;
+            return storage;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* memory) noexcept
+    {
+        if (memory == storage)
+        {
+            inUse = false;
+        }
+        else
+        {
+            ::operator delete(memory);
+        }
+    }
+};
+
+namespace
+{
+
+template <typename T>
+struct HandlerAllocator
+{
+    using value_type = T;
+    using HandlerMemory = GpioEventStream::HandlerMemory;
+
+    shared_ptr<HandlerMemory> memory;
+
+    explicit HandlerAllocator(
+        const shared_ptr<HandlerMemory>& memory) noexcept :
+        memory(memory)
+    {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept :
+        memory(other.memory)
+    {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(memory->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, size_t) noexcept
+    {
+        memory->deallocate(p);
+    }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept
+    {
+        return memory == other.memory;
+    }
+};
+
+/** @brief The @handler allocating its operation in @memory **/
+template <typename Handler>
+struct AllocatingHandler
+{
+    using allocator_type = HandlerAllocator<Handler>;
+
+    shared_ptr<GpioEventStream::HandlerMemory> memory;
+    Handler handler;
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type(memory);
+    }
+
+    void operator()(const boost::system::error_code& ec)
+    {
+        handler(ec);
+    }
+};
+
+template <typename Handler>
+AllocatingHandler<Handler>
+    allocateIn(const shared_ptr<GpioEventStream::HandlerMemory>& memory,
+               Handler handler)
+{
+    return AllocatingHandler<Handler>{memory, std::move(handler)};
+}
+
+} // namespace
+
+struct GpioEventStream::Subscriber
+{
+    boost::asio::posix::stream_descriptor socket;
+    /** @brief The pins whose edges the subscriber wants, by the pin index **/
+    vector<bool> pins;
+    /** @brief True once the first filter packet was received **/
+    bool filtered = false;
+    /** @brief Ring of the records not sent yet **/
+    vector<EventStreamRecord> buffer;
+    size_t first = 0;
+    size_t count = 0;
+    /** @brief Edges dropped since the last overflow record **/
+    uint64_t dropped = 0;
+    uint64_t lastDroppedSequence = 0;
+    /** @brief True while waiting for the socket to become writable **/
+    bool writeWaiting = false;
+    shared_ptr<HandlerMemory> writeHandlerMemory =
+        make_shared<HandlerMemory>();
+    bool connected = true;
+
+    Subscriber(boost::asio::io_context& io, int fd, size_t pinCount) :
+        socket(io, fd), pins(pinCount, false), buffer(subscriberBufferRecords)
+    {}
+
+    void append(const EventStreamRecord& record) noexcept
+    {
+        buffer[(first + count) % buffer.size()] = record;
+        ++count;
+    }
+
+    /** @brief Append the overflow record if any edges were dropped and there
+     * is room for @needed more records after it **/
+    void appendOverflow(size_t needed) noexcept
+    {
+        if (dropped > 0 && count + 1 + needed <= buffer.size())
+        {
+            EventStreamRecord overflow{};
+            overflow.sequence = lastDroppedSequence;
+            overflow.timestampNs =
+                chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now().time_since_epoch())
+                    .count();
+            overflow.dropped = dropped;
+            overflow.type = (uint8_t)EventStreamRecordType::overflow;
+            append(overflow);
+            dropped = 0;
+        }
+    }
+
+    void drop(uint64_t edges, uint64_t lastSequence) noexcept
+    {
+        dropped += edges;
+        lastDroppedSequence = lastSequence;
+    }
+
+    /** @brief Buffer the @record, or drop it if there is no room **/
+    void enqueue(const EventStreamRecord& record) noexcept
+    {
+        appendOverflow(1);
+        if (dropped == 0 && count < buffer.size())
+        {
+            append(record);
+        }
+        else
+        {
+            drop(1, record.sequence);
+        }
+    }
+};
+
+GpioEventStream::GpioEventStream(boost::asio::io_context& io,
+                                 const string& socketPath,
+                                 const vector<string>& pinNames) :
+    io(io),
+    socketPath(socketPath), pinCount(pinNames.size()), listener(io),
+    queuedEvent(io), queuedHandlerMemory(make_shared<HandlerMemory>())
+{
+    for (const auto& name : pinNames)
+    {
+        namesPacket.append(name);
+        namesPacket.push_back('\0');
+    }
+    queued.reserve(eventStreamQueueRecords);
+    distributing.reserve(eventStreamQueueRecords);
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw system_error(make_error_code(errc::filename_too_long),
+                           "Event stream socket path too long: " +
+                               socketPath);
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+
+    int lastErrno = 0;
+    int listenFd =
+        socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listenFd, maxSubscribers) != 0)
+    {
+        lastErrno = errno;
+    }
+    if (lastErrno == 0)
+    {
+        queuedFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (queuedFd < 0)
+        {
+            lastErrno = errno;
+        }
+    }
+    if (lastErrno == 0)
+    {
+        boost::system::error_code ec;
+        listener.assign(listenFd, ec);
+        if (!ec)
+        {
+            listenFd = -1;
+            queuedEvent.assign(queuedFd, ec);
+        }
+        lastErrno = ec.value();
+    }
+    if (lastErrno != 0)
+    {
+        if (listenFd >= 0)
+        {
+            close(listenFd);
+        }
+        if (queuedFd >= 0 && !queuedEvent.is_open())
+        {
+            close(queuedFd);
+        }
+        unlink(socketPath.c_str());
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to create the event stream socket " +
+                               socketPath);
+    }
+    acceptSubscribers();
+    waitForQueued();
+}
+
+GpioEventStream::~GpioEventStream()
+{
+    for (auto& subscriber : subscribers)
+    {
+        subscriber->connected = false;
+        boost::system::error_code ec;
+        subscriber->socket.close(ec);
+    }
+    unlink(socketPath.c_str());
+}
+
+void GpioEventStream::push(uint16_t pinIndex, uint8_t bit,
+                           uint64_t timestampNs, bool level) noexcept
+{
+    lock_guard<mutex> lock(queuedMutex);
+    ++lastSequence;
+    if (queued.size() < queued.capacity())
+    {
+        EventStreamRecord record{};
+        record.sequence = lastSequence;
+        record.timestampNs = timestampNs;
+        record.pinIndex = pinIndex;
+        record.type = (uint8_t)EventStreamRecordType::edge;
+        record.level = level;
+        record.bit = bit;
+        queued.push_back(record);
+    }
+    else
+    {
+        ++queueDropped;
+    }
+    if (!queuedPosted)
+    {
+        queuedPosted = true;
+        uint64_t one = 1;
+        if (write(queuedFd, &one, sizeof(one)) != sizeof(one))
+        {
+            log<level::ERR>("Failed to signal the edges to the event stream");
+        }
+    }
+}
+
+void GpioEventStream::acceptSubscribers()
+{
+    listener.async_wait(
+        boost::asio::posix::descriptor_base::wait_read,
+        [this](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            removeDisconnected();
+            int fd;
+            while ((fd = accept4(listener.native_handle(), nullptr, nullptr,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+            {
+                if (subscribers.size() >= maxSubscribers)
+                {
+                    log<level::WARNING>("Too many event stream subscribers, "
+                                        "connection refused");
+                    close(fd);
+                    continue;
+                }
+                auto subscriber = make_shared<Subscriber>(io, fd, pinCount);
+                subscribers.push_back(subscriber);
+#ifdef ENABLE_GSH_LOGS
+                log<level::INFO>("Event stream subscriber connected");
+#endif
+                if (::send(fd, namesPacket.data(), namesPacket.size(),
+                           MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+                {
+                    disconnect(subscriber);
+                    continue;
+                }
+                receiveFilter(subscriber);
+            }
+            acceptSubscribers();
+        });
+}
+
+void GpioEventStream::receiveFilter(const shared_ptr<Subscriber>& subscriber)
+{
+    subscriber->socket.async_wait(
+        boost::asio::posix::descriptor_base::wait_read,
+        [this, subscriber](const boost::system::error_code& ec) {
+            if (ec || !subscriber->connected)
+            {
+                return;
+            }
+            // One more than the pins, to tell an oversized filter
+            vector<uint16_t> filter(pinCount + 1);
+            ssize_t size =
+                recv(subscriber->socket.native_handle(), filter.data(),
+                     filter.size() * sizeof(uint16_t), MSG_DONTWAIT);
+            if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                receiveFilter(subscriber);
+                return;
+            }
+            // 0 is the end of the stream, an empty packet is not valid
+            if (size <= 0 || size % sizeof(uint16_t) != 0 ||
+                (size_t)size > pinCount * sizeof(uint16_t))
+            {
+                disconnect(subscriber);
+                return;
+            }
+            filter.resize(size / sizeof(uint16_t));
+            bool all = find(filter.begin(), filter.end(),
+                            eventStreamAllPins) != filter.end();
+            fill(subscriber->pins.begin(), subscriber->pins.end(), all);
+            for (uint16_t pinIndex : filter)
+            {
+                if (pinIndex < pinCount)
+                {
+                    subscriber->pins[pinIndex] = true;
+                }
+            }
+            subscriber->filtered = true;
+            receiveFilter(subscriber);
+        });
+}
+
+// Runs on the DBus server thread
+void GpioEventStream::waitForQueued()
+{
+    queuedEvent.async_wait(
+        boost::asio::posix::descriptor_base::wait_read,
+        allocateIn(queuedHandlerMemory,
+                   [this](const boost::system::error_code& ec) {
+                       if (!ec)
+                       {
+                           SteadyStateScope steadyState;
+                           distributeQueued();
+                           waitForQueued();
+                       }
+                   }));
+}
+
+// Runs on the DBus server thread
+void GpioEventStream::distributeQueued() noexcept
+{
+    // Reset the event before taking the edges, 'push' signals it again for
+    // any edge queued after the swap below
+    uint64_t signalled;
+    if (read(queuedFd, &signalled, sizeof(signalled)) < 0 && errno != EAGAIN)
+    {
+        log<level::ERR>("Failed to reset the event stream event");
+    }
+    uint64_t dropped;
+    uint64_t lastDroppedSequence;
+    {
+        lock_guard<mutex> lock(queuedMutex);
+        swap(queued, distributing);
+        dropped = queueDropped;
+        // The queue was full up to the swap, so the last edge was dropped
+        lastDroppedSequence = lastSequence;
+        queueDropped = 0;
+        queuedPosted = false;
+    }
+    for (auto& subscriber : subscribers)
+    {
+        if (!subscriber->filtered)
+        {
+            continue;
+        }
+        for (const auto& record : distributing)
+        {
+            if (subscriber->pins[record.pinIndex])
+            {
+                subscriber->enqueue(record);
+            }
+        }
+        if (dropped > 0)
+        {
+            // Not known which pins those were, so all the subscribers lost
+            // them
+            subscriber->drop(dropped, lastDroppedSequence);
+            subscriber->appendOverflow(0);
+        }
+        if (subscriber->count > 0 && !subscriber->writeWaiting)
+        {
+            send(subscriber);
+        }
+    }
+    distributing.clear();
+    removeDisconnected();
+}
+
+// Runs on the DBus server thread
+void GpioEventStream::send(const shared_ptr<Subscriber>& subscriber)
+{
+    EventStreamRecord batch[eventStreamBatchRecords];
+    while (subscriber->count > 0)
+    {
+        size_t n = min(subscriber->count, eventStreamBatchRecords);
+        for (auto i = 0u; i < n; ++i)
+        {
+            batch[i] = subscriber->buffer[(subscriber->first + i) %
+                                          subscriber->buffer.size()];
+        }
+        if (::send(subscriber->socket.native_handle(), batch,
+                   n * sizeof(EventStreamRecord),
+                   MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                disconnect(subscriber);
+                return;
+            }
+            // The subscriber is behind, continue once it has read something
+            subscriber->writeWaiting = true;
+            subscriber->socket.async_wait(
+                boost::asio::posix::descriptor_base::wait_write,
+                allocateIn(
+                    subscriber->writeHandlerMemory,
+                    [this, subscriber](const boost::system::error_code& ec) {
+                        subscriber->writeWaiting = false;
+                        if (!ec && subscriber->connected)
+                        {
+                            SteadyStateScope steadyState;
+                            send(subscriber);
+                        }
+                    }));
+            return;
+        }
+        subscriber->first = (subscriber->first + n) % subscriber->buffer.size();
+        subscriber->count -= n;
+        subscriber->appendOverflow(0);
+    }
+}
+
+// Runs on the DBus server thread. The subscriber is removed from the list
+// later by 'removeDisconnected', as the list may be being iterated.
+void GpioEventStream::disconnect(const shared_ptr<Subscriber>& subscriber)
+{
+    if (!subscriber->connected)
+    {
+        return;
+    }
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Event stream subscriber disconnected");
+#endif
+    subscriber->connected = false;
+    boost::system::error_code ec;
+    subscriber->socket.close(ec);
+}
+
+// Runs on the DBus server thread
+void GpioEventStream::removeDisconnected() noexcept
+{
+    subscribers.erase(remove_if(subscribers.begin(), subscribers.end(),
+                                [](const auto& subscriber) {
+                                    return !subscriber->connected;
+                                }),
+                      subscribers.end());
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @file
+ *
+ * Stream of the gpio edges to the local subscribers over a SOCK_SEQPACKET
+ * Unix domain socket.
+ *
+ * Protocol, all integers little-endian (native on the BMC):
+ *
+ *   1. On connection the service sends a packet with the pin names, each
+ *      followed by a zero byte, in the order of their indices.
+ *   2. The subscriber sends a filter packet: the uint16 indices of the pins
+ *      it wants the edges of, @ref eventStreamAllPins meaning all the pins.
+ *      Nothing is sent before the filter. A new filter may be sent at any
+ *      time.
+ *   3. The service sends packets of up to @ref eventStreamBatchRecords
+ *      @ref EventStreamRecord, in the order of their sequence numbers.
+ */
+
+namespace gpio_handler
+{
+
+/** @brief Maximal number of records in one packet of the stream **/
+static constexpr size_t eventStreamBatchRecords = 64;
+
+/** @brief Pin index in the filter packet standing for all the pins **/
+static constexpr uint16_t eventStreamAllPins = 0xffff;
+
+/** @brief Kinds of the stream records **/
+enum class EventStreamRecordType : uint8_t
+{
+    /** @brief Edge read from a line **/
+    edge = 0,
+    /** @brief Records were dropped in front of this one, see @ref
+     * EventStreamRecord::dropped **/
+    overflow = 1,
+};
+
+/** @brief A single record of the stream **/
+struct EventStreamRecord
+{
+    /** @brief Number of the edge among all the edges of all the pins, from 1.
+     * For an overflow the number of the last dropped edge. **/
+    uint64_t sequence;
+    /** @brief Kernel timestamp of the edge, on CLOCK_MONOTONIC. For an
+     * overflow the time it was detected. [nanoseconds] **/
+    uint64_t timestampNs;
+    /** @brief Number of the edges dropped for the subscriber, 0 for an
+     * edge **/
+    uint64_t dropped;
+    /** @brief Index of the pin in the names packet **/
+    uint16_t pinIndex;
+    /** @brief @ref EventStreamRecordType **/
+    uint8_t type;
+    /** @brief Line level right after the edge: 1 rising, 0 falling **/
+    uint8_t level;
+    /** @brief Position of the line in the bus, 0 for a single pin **/
+    uint8_t bit;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(EventStreamRecord) == 32, "Stream record format changed");
+
+/**
+ * @brief Server of the edge stream
+ *
+ * The monitoring threads only append the edges to a preallocated queue under
+ * a short lock, and signal the DBus server thread by an eventfd when the queue
+ * becomes non-empty. That thread distributes the edges to the subscribers'
+ * buffers and sends them in batches with non-blocking writes.
+ *
+ * Every subscriber has a buffer of a fixed size. When it's full, because the
+ * subscriber doesn't read fast enough, the following edges of that
+ * subscriber are dropped and counted, and an overflow record takes their
+ * place once there is room again. The same happens to all the subscribers
+ * when the edges arrive faster than the DBus server thread distributes them.
+ * Neither ever blocks the monitoring threads.
+ */
+class GpioEventStream
+{
+  public:
+    /**
+     * @brief Listen on the @socketPath for the subscribers to the edges of
+     * @pinNames, served on the @io context.
+     *
+     * An existing @socketPath is replaced. Throw @ref std::system_error if the
+     * socket could not be created.
+     */
+    GpioEventStream(boost::asio::io_context& io, const std::string& socketPath,
+                    const std::vector<std::string>& pinNames);
+
+    /** @brief Disconnect the subscribers and remove the socket **/
+    ~GpioEventStream();
+
+    GpioEventStream(const GpioEventStream&) = delete;
+    GpioEventStream& operator=(const GpioEventStream&) = delete;
+
+    /** @brief Queue the edge read from the line @bit of the pin @pinIndex
+     * for the subscribers. Can be called from any thread. **/
+    void push(uint16_t pinIndex, uint8_t bit, uint64_t timestampNs,
+              bool level) noexcept;
+
+    struct HandlerMemory;
+
+  private:
+    struct Subscriber;
+
+    boost::asio::io_context& io;
+    std::string socketPath;
+    /** @brief The names packet, see the protocol **/
+    std::string namesPacket;
+    size_t pinCount;
+    boost::asio::posix::stream_descriptor listener;
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+
+    std::mutex queuedMutex;
+    /** @brief Edges pushed and not distributed yet, never reallocated **/
+    std::vector<EventStreamRecord> queued;
+    /** @brief Edges being distributed by the DBus server thread **/
+    std::vector<EventStreamRecord> distributing;
+    /** @brief Sequence number of the last pushed edge **/
+    uint64_t lastSequence = 0;
+    /** @brief Edges dropped because @ref queued was full **/
+    uint64_t queueDropped = 0;
+    /** @brief True if @ref queuedEvent was signalled and not drained yet **/
+    bool queuedPosted = false;
+    /** @brief Event descriptor signalled by @ref push when the first edge is
+     * queued **/
+    boost::asio::posix::stream_descriptor queuedEvent;
+    int queuedFd = -1;
+    std::shared_ptr<HandlerMemory> queuedHandlerMemory;
+
+    void acceptSubscribers();
+    void waitForQueued();
+    void distributeQueued() noexcept;
+    void receiveFilter(const std::shared_ptr<Subscriber>& subscriber);
+    void send(const std::shared_ptr<Subscriber>& subscriber);
+    void disconnect(const std::shared_ptr<Subscriber>& subscriber);
+    void removeDisconnected() noexcept;
+};
+
+} // namespace gpio_handler
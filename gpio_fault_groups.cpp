@@ -0,0 +1,261 @@
+#include <sys/eventfd.h>
+
+#include <gpio_fault_groups.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+GpioFaultGroups::GpioFaultGroups(boost::asio::io_context& io,
+                                 const GpioJsonConfig& gpioConfig) :
+    changeEvent(io)
+{
+    map<string, uint64_t> windows;
+    map<string, size_t> memberCounts;
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        if (pin.faultGroup.has_value())
+        {
+            uint64_t& windowNs = windows[*pin.faultGroup];
+            windowNs = max(windowNs, GpioJsonConfig::getFaultWindowNs(pin));
+            ++memberCounts[*pin.faultGroup];
+        }
+    }
+    for (const auto& [name, windowNs] : windows)
+    {
+        Group& group = groups.emplace_back();
+        group.name = name;
+        group.windowNs = windowNs;
+        // At most one assertion per pin, see 'latch'
+        group.latched.reserve(memberCounts[name]);
+    }
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        pinNames.push_back(pin.name);
+        pinGroups.push_back(
+            pin.faultGroup.has_value()
+                ? distance(windows.begin(), windows.find(*pin.faultGroup))
+                : -1);
+        assertedHigh.push_back(GpioJsonConfig::isFaultAssertedHigh(pin));
+    }
+
+    int lastErrno = 0;
+    changeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (changeFd < 0)
+    {
+        lastErrno = errno;
+    }
+    if (lastErrno == 0)
+    {
+        boost::system::error_code ec;
+        changeEvent.assign(changeFd, ec);
+        lastErrno = ec.value();
+    }
+    if (lastErrno != 0)
+    {
+        if (changeFd >= 0 && !changeEvent.is_open())
+        {
+            close(changeFd);
+        }
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to create the fault groups event");
+    }
+    waitForChanges();
+}
+
+bool GpioFaultGroups::hasFaultGroups(const GpioJsonConfig& gpioConfig)
+{
+    return any_of(gpioConfig.getPins().begin(), gpioConfig.getPins().end(),
+                  [](const auto& pin) { return pin.faultGroup.has_value(); });
+}
+
+void GpioFaultGroups::onEdge(uint16_t pinIndex, bool rising,
+                             uint64_t timestampNs) noexcept
+{
+    int groupIndex = pinGroups[pinIndex];
+    if (groupIndex < 0 || rising != assertedHigh[pinIndex])
+    {
+        return;
+    }
+    lock_guard<mutex> lock(groupsMutex);
+    Group& group = groups[groupIndex];
+    if (!latch(group, pinIndex, timestampNs))
+    {
+        return;
+    }
+    group.changed = true;
+    if (!changePosted)
+    {
+        changePosted = true;
+        uint64_t one = 1;
+        if (write(changeFd, &one, sizeof(one)) != sizeof(one))
+        {
+            log<level::ERR>("Failed to signal the fault group change to the "
+                            "DBus thread");
+        }
+    }
+}
+
+// Called with 'groupsMutex' locked
+bool GpioFaultGroups::latch(Group& group, uint16_t pinIndex,
+                            uint64_t timestampNs) noexcept
+{
+    vector<Fault>& latched = group.latched;
+    if (any_of(latched.begin(), latched.end(),
+               [pinIndex](const Fault& f) { return f.pinIndex == pinIndex; }))
+    {
+        return false;
+    }
+    if (!latched.empty() &&
+        timestampNs > latched.front().timestampNs + group.windowNs)
+    {
+        return false;
+    }
+    // Within the reserved capacity, so no allocation
+    latched.insert(upper_bound(latched.begin(), latched.end(), timestampNs,
+                               [](uint64_t ts, const Fault& f) {
+                                   return ts < f.timestampNs;
+                               }),
+                   Fault{timestampNs, pinIndex});
+    // An earlier first fault may leave the latest ones out of its window
+    while (latched.back().timestampNs >
+           latched.front().timestampNs + group.windowNs)
+    {
+        latched.pop_back();
+    }
+    return true;
+}
+
+// Runs on the DBus server thread, except for the first call by the
+// constructor
+void GpioFaultGroups::waitForChanges()
+{
+    changeEvent.async_wait(boost::asio::posix::descriptor_base::wait_read,
+                           [this](const boost::system::error_code& ec) {
+                               if (!ec)
+                               {
+                                   signalChanges();
+                                   waitForChanges();
+                               }
+                           });
+}
+
+// Runs on the DBus server thread
+void GpioFaultGroups::signalChanges()
+{
+    // Reset the event before taking the changes, the monitoring threads
+    // signal it again for any change after the loop below
+    uint64_t signalled;
+    if (read(changeFd, &signalled, sizeof(signalled)) < 0 && errno != EAGAIN)
+    {
+        log<level::ERR>("Failed to reset the fault group change event");
+    }
+    {
+        lock_guard<mutex> lock(groupsMutex);
+        changePosted = false;
+    }
+    for (auto& group : groups)
+    {
+        int first = -1;
+        {
+            lock_guard<mutex> lock(groupsMutex);
+            if (!group.changed)
+            {
+                continue;
+            }
+            group.changed = false;
+            first = group.latched.empty() ? -1 : group.latched.front().pinIndex;
+        }
+        if (first >= 0 && first != group.loggedFirst)
+        {
+            log<level::WARNING>("First fault of the group latched",
+                                entry("FAULT_GROUP=%s", group.name.c_str()),
+                                pinNameEntry(pinNames[first]));
+        }
+        group.loggedFirst = first;
+        if (dbusInterface)
+        {
+            dbusInterface->signal_property(group.name);
+        }
+    }
+}
+
+FaultSequence GpioFaultGroups::getFaults(const Group& group)
+{
+    FaultSequence faults;
+    lock_guard<mutex> lock(groupsMutex);
+    for (const auto& fault : group.latched)
+    {
+        faults.emplace_back(pinNames[fault.pinIndex], fault.timestampNs);
+    }
+    return faults;
+}
+
+// Runs on the DBus server thread
+bool GpioFaultGroups::clear(const string& groupName)
+{
+    auto it = find_if(groups.begin(), groups.end(), [&](const Group& g) {
+        return g.name == groupName;
+    });
+    if (it == groups.end())
+    {
+        return false;
+    }
+    {
+        lock_guard<mutex> lock(groupsMutex);
+        it->latched.clear();
+        it->changed = false;
+    }
+    if (it->loggedFirst >= 0)
+    {
+        log<level::INFO>("Fault group cleared",
+                         entry("FAULT_GROUP=%s", groupName.c_str()));
+    }
+    it->loggedFirst = -1;
+    if (dbusInterface)
+    {
+        dbusInterface->signal_property(groupName);
+    }
+    return true;
+}
+
+void GpioFaultGroups::createDbusInterface(
+    sdbusplus::asio::object_server& server, const string& objectPath,
+    const string& interfaceName)
+{
+    dbusInterface = server.add_interface(objectPath, interfaceName);
+    for (const auto& group : groups)
+    {
+        const Group* g = &group;
+        dbusInterface->register_property_r(
+            group.name, FaultSequence{},
+            sdbusplus::vtable::property_::emits_change,
+            [this, g](const FaultSequence&) { return getFaults(*g); });
+    }
+    dbusInterface->register_method(
+        "Clear", [this](const string& groupName) { return clear(groupName); });
+    dbusInterface->register_method("ClearAll", [this]() {
+        for (const auto& group : groups)
+        {
+            clear(group.name);
+        }
+    });
+    dbusInterface->initialize();
+}
+
+} // namespace gpio_handler
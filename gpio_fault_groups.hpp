@@ -0,0 +1,126 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <gpio_json_config.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/** @brief DBus representation of the latched faults of a group, the pin
+ * names with the kernel timestamps of their assertions [nanoseconds], in the
+ * order of the timestamps; signature 'a(st)' **/
+using FaultSequence = std::vector<std::tuple<std::string, uint64_t>>;
+
+/**
+ * @brief Captures the first fault of the fault groups (see the "fault_group"
+ * config key), ordering the simultaneous edges of their pins by the kernel
+ * timestamps
+ *
+ * When a fault cascades, like a PSU fault tripping the voltage regulator
+ * alerts, the edges of the pins arrive on different monitoring threads within
+ * microseconds, in no particular order. The first pin of a group asserting,
+ * by the timestamp of its edge (@ref gpiod_line_event::ts), is latched as the
+ * first fault, together with the other pins of the group asserting within the
+ * group's window after it. An assertion delivered late but timestamped
+ * earlier takes the first place, dropping the assertions which are then
+ * outside of the window. Only the first assertion of a pin counts, and the
+ * assertions after the window are ignored, until the group is cleared.
+ *
+ * Only the edges count, not the initial values nor the polled changes, which
+ * have no kernel timestamp. The edges are taken by @ref onEdge on the
+ * monitoring threads under a short lock, without allocating memory, and the
+ * changes of the groups are signalled by the DBus server thread (the one
+ * running the @io context), woken up through an event descriptor.
+ */
+class GpioFaultGroups
+{
+  public:
+    /**
+     * @brief Prepare the empty fault groups of the pins of @gpioConfig,
+     * signalled on the @io context.
+     *
+     * Throw @ref std::system_error if the event descriptor could not be
+     * created.
+     */
+    GpioFaultGroups(boost::asio::io_context& io,
+                    const GpioJsonConfig& gpioConfig);
+
+    GpioFaultGroups(const GpioFaultGroups&) = delete;
+    GpioFaultGroups& operator=(const GpioFaultGroups&) = delete;
+
+    /** @brief True if any pin of @gpioConfig belongs to a fault group **/
+    static bool hasFaultGroups(const GpioJsonConfig& gpioConfig);
+
+    /**
+     * @brief Take the @rising or falling edge of the pin @pinIndex,
+     * timestamped by the kernel at @timestampNs. Can be called from any
+     * thread.
+     */
+    void onEdge(uint16_t pinIndex, bool rising, uint64_t timestampNs) noexcept;
+
+    /**
+     * @brief Add the @interfaceName interface to the @objectPath object in
+     * @server with a read-only property per group, named after it, with its
+     * @ref FaultSequence, the 'Clear' (s) -> (b) method clearing a group and
+     * returning false if it doesn't exist, and the 'ClearAll' method.
+     */
+    void createDbusInterface(sdbusplus::asio::object_server& server,
+                             const std::string& objectPath,
+                             const std::string& interfaceName);
+
+  private:
+    /** @brief An assertion of a pin **/
+    struct Fault
+    {
+        uint64_t timestampNs;
+        uint16_t pinIndex;
+    };
+
+    struct Group
+    {
+        std::string name;
+        uint64_t windowNs = 0;
+        /** @brief In the order of the timestamps, never reallocated **/
+        std::vector<Fault> latched;
+        /** @brief True if @ref latched changed and was not signalled yet **/
+        bool changed = false;
+        /** @brief The latched first fault logged last, used by the DBus
+         * server thread only **/
+        int loggedFirst = -1;
+    };
+
+    /** @brief Indexed by the pin position in the config **/
+    std::vector<std::string> pinNames;
+    /** @brief Index of the group of a pin, -1 if none **/
+    std::vector<int> pinGroups;
+    /** @brief True for the pins asserting their fault by the high level **/
+    std::vector<bool> assertedHigh;
+    /** @brief In the order of their names **/
+    std::vector<Group> groups;
+    std::mutex groupsMutex;
+    /** @brief True if @ref changeEvent was signalled and not drained yet **/
+    bool changePosted = false;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+    /** @brief Event descriptor signalled on a change of any group **/
+    boost::asio::posix::stream_descriptor changeEvent;
+    /** @brief The descriptor of @ref changeEvent, owned by it **/
+    int changeFd = -1;
+
+    static bool latch(Group& group, uint16_t pinIndex,
+                      uint64_t timestampNs) noexcept;
+    void waitForChanges();
+    void signalChanges();
+    FaultSequence getFaults(const Group& group);
+    bool clear(const std::string& groupName);
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,307 @@
+#include <gpio_flight_recorder.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+static constexpr char flightRecorderMagic[4] = {'G', 'S', 'H', 'F'};
+
+/** @brief Alignment of the first record in the file [bytes] **/
+static constexpr size_t recordsAlignment = 64;
+
+static_assert(atomic_ref<uint64_t>::is_always_lock_free,
+              "The records are appended without locking");
+
+static int64_t getRealtimeOffsetNs()
+{
+    struct timespec realtime;
+    struct timespec monotonic;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    return (int64_t)(realtime.tv_sec - monotonic.tv_sec) * 1000000000ll +
+           (realtime.tv_nsec - monotonic.tv_nsec);
+}
+
+/** @brief Size of the names table in the file format [bytes] **/
+static size_t getNamesSize(const vector<string>& names)
+{
+    if (names.size() > numeric_limits<uint16_t>::max())
+    {
+        throw invalid_argument(
+            "Too many names for the flight recorder file format");
+    }
+    size_t size = 0;
+    for (const auto& name : names)
+    {
+        if (name.size() > numeric_limits<uint8_t>::max())
+        {
+            throw invalid_argument(
+                "Name too long for the flight recorder file format: " + name);
+        }
+        size += 1 + name.size();
+    }
+    return size;
+}
+
+static char* writeNames(char* position, const vector<string>& names)
+{
+    for (const auto& name : names)
+    {
+        *position++ = (char)name.size();
+        position = copy(name.begin(), name.end(), position);
+    }
+    return position;
+}
+
+FlightRecorder::FlightRecorder(const string& fileName,
+                               const vector<string>& pinNames,
+                               const vector<string>& propertyNames,
+                               uint32_t recordCount)
+{
+    if (recordCount == 0)
+    {
+        throw invalid_argument("The flight recorder needs at least 1 record");
+    }
+    size_t recordsOffset = (sizeof(FlightRecorderHeader) +
+                            getNamesSize(pinNames) +
+                            getNamesSize(propertyNames) + recordsAlignment -
+                            1) /
+                           recordsAlignment * recordsAlignment;
+    mappingSize = recordsOffset + (size_t)recordCount * sizeof(FlightRecord);
+
+    // Keep the records of the previous run, most likely the interesting ones
+    string previousFileName = fileName + ".1";
+    if (rename(fileName.c_str(), previousFileName.c_str()) != 0 &&
+        errno != ENOENT)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to rename the flight recorder " + fileName +
+                               " to " + previousFileName);
+    }
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+    if (fd < 0)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to create the flight recorder " +
+                               fileName);
+    }
+    // Allocated up front, so storing to the mapping can't fail with SIGBUS
+    // on a full file system
+    int result = posix_fallocate(fd, 0, mappingSize);
+    if (result != 0)
+    {
+        close(fd);
+        throw system_error(error_code(result, system_category()),
+                           "Failed to allocate the flight recorder " +
+                               fileName);
+    }
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    int lastErrno = errno;
+    // The mapping keeps the file open
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to map the flight recorder " + fileName);
+    }
+
+    char* bytes = static_cast<char*>(mapping);
+    header = reinterpret_cast<FlightRecorderHeader*>(bytes);
+    records = reinterpret_cast<FlightRecord*>(bytes + recordsOffset);
+    header->version = flightRecorderFormatVersion;
+    header->pinCount = pinNames.size();
+    header->propertyCount = propertyNames.size();
+    header->recordCount = recordCount;
+    header->recordsOffset = recordsOffset;
+    header->realtimeOffsetNs = getRealtimeOffsetNs();
+    header->head = 0;
+    writeNames(writeNames(bytes + sizeof(FlightRecorderHeader), pinNames),
+               propertyNames);
+    // The magic last, so a file cut short by a crash is not taken for valid
+    atomic_thread_fence(memory_order_release);
+    copy(begin(flightRecorderMagic), end(flightRecorderMagic),
+         header->magic);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    sync();
+    munmap(mapping, mappingSize);
+}
+
+void FlightRecorder::recordEdge(uint16_t pinIndex, uint8_t bit,
+                                uint64_t timestampNs, bool rising) noexcept
+{
+    append(FlightRecord{0, timestampNs, 0, pinIndex,
+                        (uint8_t)(rising ? FlightRecordType::risingEdge
+                                         : FlightRecordType::fallingEdge),
+                        bit, 0});
+}
+
+void FlightRecorder::recordPublished(uint16_t propertyIndex, uint64_t value,
+                                     uint64_t timestampNs) noexcept
+{
+    append(FlightRecord{0, timestampNs, value, propertyIndex,
+                        (uint8_t)FlightRecordType::published, 0, 0});
+}
+
+bool FlightRecorder::sync() noexcept
+{
+    return msync(mapping, mappingSize, MS_SYNC) == 0;
+}
+
+void FlightRecorder::append(const FlightRecord& record) noexcept
+{
+    uint64_t sequence =
+        atomic_ref<uint64_t>(header->head).fetch_add(1, memory_order_relaxed) +
+        1;
+    FlightRecord& slot = records[(sequence - 1) % header->recordCount];
+    atomic_ref<uint64_t> slotSequence(slot.sequence);
+    // Invalidate the overwritten record before touching its fields
+    slotSequence.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    // Atomic, as a writer preempted for a whole ring may share the slot with
+    // the next one
+    atomic_ref<uint64_t>(slot.timestampNs)
+        .store(record.timestampNs, memory_order_relaxed);
+    atomic_ref<uint64_t>(slot.value).store(record.value, memory_order_relaxed);
+    atomic_ref<uint16_t>(slot.index).store(record.index, memory_order_relaxed);
+    atomic_ref<uint8_t>(slot.type).store(record.type, memory_order_relaxed);
+    atomic_ref<uint8_t>(slot.bit).store(record.bit, memory_order_relaxed);
+    slotSequence.store(sequence, memory_order_release);
+}
+
+/** @brief Read @count names from @position, not beyond @end **/
+static const char* readNames(const char* position, const char* end,
+                             uint16_t count, vector<string>& names)
+{
+    for (auto i = 0u; i < count && position != nullptr; ++i)
+    {
+        if (position >= end || position + 1 + (uint8_t)*position > end)
+        {
+            return nullptr;
+        }
+        uint8_t nameLen = *position++;
+        names.emplace_back(position, nameLen);
+        position += nameLen;
+    }
+    return position;
+}
+
+FlightRecordReader::FlightRecordReader(const string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to open the flight recorder " + fileName);
+    }
+    vector<char> bytes;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    }
+    bool readFailed = ferror(file);
+    int lastErrno = errno;
+    fclose(file);
+    if (readFailed)
+    {
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to read the flight recorder " + fileName);
+    }
+
+    FlightRecorderHeader header;
+    bool ok = bytes.size() >= sizeof(header);
+    if (ok)
+    {
+        memcpy(&header, bytes.data(), sizeof(header));
+        ok = memcmp(header.magic, flightRecorderMagic,
+                    sizeof(flightRecorderMagic)) == 0 &&
+             header.version == flightRecorderFormatVersion &&
+             header.recordCount > 0 &&
+             header.recordsOffset <= bytes.size() &&
+             (bytes.size() - header.recordsOffset) / sizeof(FlightRecord) >=
+                 header.recordCount;
+    }
+    if (ok)
+    {
+        const char* end = bytes.data() + header.recordsOffset;
+        const char* position = bytes.data() + sizeof(header);
+        position = readNames(position, end, header.pinCount, pinNames);
+        position =
+            readNames(position, end, header.propertyCount, propertyNames);
+        ok = position != nullptr;
+    }
+    if (!ok)
+    {
+        throw runtime_error("Not a valid flight recorder (version " +
+                            to_string(flightRecorderFormatVersion) +
+                            " expected): " + fileName);
+    }
+    realtimeOffsetNs = header.realtimeOffsetNs;
+    appendedCount = header.head;
+
+    for (auto i = 0u; i < header.recordCount; ++i)
+    {
+        FlightRecord record;
+        memcpy(&record,
+               bytes.data() + header.recordsOffset + i * sizeof(record),
+               sizeof(record));
+        // Skip the empty and the torn slots
+        if (record.sequence != 0 &&
+            (record.sequence - 1) % header.recordCount == i)
+        {
+            records.push_back(record);
+        }
+    }
+    sort(records.begin(), records.end(),
+         [](const FlightRecord& a, const FlightRecord& b) {
+             return a.sequence < b.sequence;
+         });
+}
+
+const vector<string>& FlightRecordReader::getPinNames() const
+{
+    return pinNames;
+}
+
+const vector<string>& FlightRecordReader::getPropertyNames() const
+{
+    return propertyNames;
+}
+
+int64_t FlightRecordReader::getRealtimeOffsetNs() const
+{
+    return realtimeOffsetNs;
+}
+
+uint64_t FlightRecordReader::getAppendedCount() const
+{
+    return appendedCount;
+}
+
+const vector<FlightRecord>& FlightRecordReader::getRecords() const
+{
+    return records;
+}
+
+} // namespace gpio_handler
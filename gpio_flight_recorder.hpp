@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @file
+ *
+ * Flight recorder of the pin edges and the published changes, kept in a
+ * memory-mapped circular file which outlives the service.
+ *
+ * File layout, all integers little-endian (native on the BMC):
+ *
+ *   header      @ref FlightRecorderHeader
+ *   pinCount times:
+ *     nameLen   uint8
+ *     name      nameLen bytes, no terminating zero
+ *   propertyCount times:
+ *     nameLen   uint8
+ *     name      nameLen bytes, no terminating zero
+ *   padding     up to @ref FlightRecorderHeader::recordsOffset
+ *   records     @ref FlightRecorderHeader::recordCount times @ref FlightRecord
+ *
+ * The records are a ring: the n-th appended record (counting from 1) is stored
+ * in the slot (n - 1) % recordCount and carries n as its sequence number. The
+ * header's @ref FlightRecorderHeader::head is the number of the records
+ * appended so far.
+ */
+
+namespace gpio_handler
+{
+
+static constexpr uint16_t flightRecorderFormatVersion = 1;
+
+/** @brief Kinds of the flight records **/
+enum class FlightRecordType : uint8_t
+{
+    /** @brief Falling edge event read from a line **/
+    fallingEdge = 0,
+    /** @brief Rising edge event read from a line **/
+    risingEdge = 1,
+    /** @brief New value of a DBus property **/
+    published = 2,
+};
+
+/** @brief Fixed part of the flight recorder file **/
+struct FlightRecorderHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t pinCount;
+    uint16_t propertyCount;
+    uint16_t reserved;
+    /** @brief Capacity of the ring [records] **/
+    uint32_t recordCount;
+    /** @brief Offset of the first record from the beginning of the file **/
+    uint64_t recordsOffset;
+    /** @brief CLOCK_REALTIME - CLOCK_MONOTONIC at the service start, to date
+     * the records [nanoseconds] **/
+    int64_t realtimeOffsetNs;
+    /** @brief Number of the records appended so far, updated atomically **/
+    uint64_t head;
+};
+
+static_assert(sizeof(FlightRecorderHeader) == 40,
+              "Flight recorder header format changed");
+
+/** @brief A single edge or published change as stored in the file **/
+struct FlightRecord
+{
+    /** @brief Number of the record, 1 for the first one ever appended. 0
+     * while the record is being written. **/
+    uint64_t sequence;
+    /** @brief CLOCK_MONOTONIC time: the kernel timestamp of an edge, the
+     * time of the update of a property [nanoseconds] **/
+    uint64_t timestampNs;
+    /** @brief The published value, 0 for an edge **/
+    uint64_t value;
+    /** @brief Index in the pin names table for an edge, in the property
+     * names table for a published change **/
+    uint16_t index;
+    /** @brief @ref FlightRecordType **/
+    uint8_t type;
+    /** @brief Position of the line in the bus for an edge, 0 otherwise **/
+    uint8_t bit;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FlightRecord) == 32, "Flight record format changed");
+
+/**
+ * @brief Writer of the flight recorder file
+ *
+ * The file is created at its full size and mapped into memory, so appending a
+ * record is an atomic increment of the head and a store of 32 bytes, with no
+ * system call and no lock. The records live in the page cache and survive the
+ * crash of the service; on a persistent file system they survive a reboot
+ * too, once written back (see @ref sync). The class is thread-safe.
+ *
+ * A record being written is marked by its zero sequence number, which is set
+ * to the right one last, so the reader drops the records torn by a crash.
+ */
+class FlightRecorder
+{
+  public:
+    /**
+     * @brief Create the @fileName flight recorder for @recordCount records,
+     * listing @pinNames and @propertyNames.
+     *
+     * An existing @fileName, presumably left by the previous run of the
+     * service, is renamed to @fileName with the ".1" suffix rather than
+     * overwritten.
+     *
+     * Throw @ref std::system_error if the file could not be created and
+     * @ref std::invalid_argument if the names don't fit the format.
+     */
+    FlightRecorder(const std::string& fileName,
+                   const std::vector<std::string>& pinNames,
+                   const std::vector<std::string>& propertyNames,
+                   uint32_t recordCount);
+
+    /** @brief Write the records back to the file and unmap it **/
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    /** @brief Append the edge read from the line @bit of the pin @pinIndex at
+     * the kernel time @timestampNs **/
+    void recordEdge(uint16_t pinIndex, uint8_t bit, uint64_t timestampNs,
+                    bool rising) noexcept;
+
+    /** @brief Append the @value published on the property @propertyIndex at
+     * @timestampNs **/
+    void recordPublished(uint16_t propertyIndex, uint64_t value,
+                         uint64_t timestampNs) noexcept;
+
+    /**
+     * @brief Write the dirty records back to the file, blocking until done.
+     *
+     * Only needed for the records to survive a reboot; a crash of the service
+     * doesn't lose them anyway.
+     *
+     * @return False if the write back failed, with errno set.
+     */
+    bool sync() noexcept;
+
+  private:
+    void* mapping;
+    size_t mappingSize;
+    FlightRecorderHeader* header;
+    FlightRecord* records;
+
+    void append(const FlightRecord& record) noexcept;
+};
+
+/** @brief Reader of a flight recorder file, also one the service is still
+ * writing **/
+class FlightRecordReader
+{
+  public:
+    /**
+     * @brief Read the whole @fileName flight recorder.
+     *
+     * Throw @ref std::system_error if the file could not be read and
+     * @ref std::runtime_error if it's not a valid flight recorder.
+     */
+    explicit FlightRecordReader(const std::string& fileName);
+
+    /** @brief Pin names table, indexed by @ref FlightRecord::index of the
+     * edges **/
+    const std::vector<std::string>& getPinNames() const;
+
+    /** @brief Property names table, indexed by @ref FlightRecord::index of
+     * the published changes **/
+    const std::vector<std::string>& getPropertyNames() const;
+
+    /** @brief See @ref FlightRecorderHeader::realtimeOffsetNs **/
+    int64_t getRealtimeOffsetNs() const;
+
+    /** @brief Number of the records appended since the service start,
+     * including those overwritten since **/
+    uint64_t getAppendedCount() const;
+
+    /** @brief The complete records still in the ring, the oldest first **/
+    const std::vector<FlightRecord>& getRecords() const;
+
+  private:
+    std::vector<std::string> pinNames;
+    std::vector<std::string> propertyNames;
+    int64_t realtimeOffsetNs;
+    uint64_t appendedCount;
+    std::vector<FlightRecord> records;
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,281 @@
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
+#include <boost/asio/post.hpp>
+#include <gpio_hotplug.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Netlink multicast group of the uevents sent by the kernel, as
+ * opposed to those re-broadcast by udev **/
+static constexpr uint32_t kernelUeventGroup = 1;
+
+/** @brief Room for the largest uevent, the kernel's limit being 2 KiB of
+ * variables plus the header [bytes] **/
+static constexpr size_t ueventBufferSize = 8192;
+
+/** @brief True if the device node of the gpio chip @chipName exists **/
+static bool chipExists(const string& chipName) noexcept
+{
+    error_code ec;
+    return filesystem::exists("/dev/" + chipName, ec);
+}
+
+GpioHotplug::GpioHotplug(boost::asio::io_context& io, GpioChips& gpioChips,
+                         GpioLines& gpioLines,
+                         const GpioJsonConfig& gpioConfig,
+                         GpioStats& gpioStats, vector<MonitoredPin>& pins,
+                         PinStarter startPin) :
+    io(io),
+    gpioChips(gpioChips), gpioLines(gpioLines), configs(gpioConfig.getPins()),
+    gpioStats(gpioStats), pins(pins), startPin(std::move(startPin)),
+    chipRemoved(make_unique<atomic<bool>[]>(pins.size())), uevents(io),
+    ueventBuffer(ueventBufferSize)
+{
+    for (const auto& pin : pins)
+    {
+        if (gpioChips.getMissingPins().contains(pin.pinName))
+        {
+            gpioStats.setPinAvailable(pin.pinName, false);
+        }
+    }
+
+    int lastErrno = 0;
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    NETLINK_KOBJECT_UEVENT);
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = kernelUeventGroup;
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address),
+                       sizeof(address)) != 0)
+    {
+        lastErrno = errno;
+    }
+    if (lastErrno == 0)
+    {
+        boost::system::error_code ec;
+        uevents.assign(fd, ec);
+        lastErrno = ec.value();
+    }
+    if (lastErrno != 0)
+    {
+        if (fd >= 0 && !uevents.is_open())
+        {
+            close(fd);
+        }
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to open the uevent socket");
+    }
+}
+
+void GpioHotplug::start()
+{
+    receiveUevents();
+    // The chips which appeared before the socket was open announced
+    // themselves to nobody
+    for (auto& pin : pins)
+    {
+        if (gpioChips.getMissingPins().contains(pin.pinName))
+        {
+            attach(pin);
+        }
+    }
+}
+
+bool GpioHotplug::releaseIfChipRemoved(MonitoredPin& pin) noexcept
+{
+    // The chip may be back already if its uevents were not handled yet
+    if (!chipRemoved[pin.pinIndex].load() && chipExists(pin.chipName))
+    {
+        return false;
+    }
+    boost::asio::post(io, [this, &pin]() { detach(pin); });
+    return true;
+}
+
+void GpioHotplug::receiveUevents()
+{
+    uevents.async_wait(
+        boost::asio::posix::descriptor_base::wait_read,
+        [this](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            sockaddr_nl sender{};
+            socklen_t senderSize = sizeof(sender);
+            ssize_t size;
+            while ((size = recvfrom(uevents.native_handle(),
+                                    ueventBuffer.data(), ueventBuffer.size(),
+                                    0, reinterpret_cast<sockaddr*>(&sender),
+                                    &senderSize)) >= 0 ||
+                   errno == ENOBUFS)
+            {
+                if (size < 0)
+                {
+                    // The uevents which didn't fit the socket buffer are lost,
+                    // look for the chips which appeared meanwhile
+                    log<level::WARNING>("Uevents lost, rescanning gpio chips");
+                    start();
+                    return;
+                }
+                // Only the kernel is trusted, not other processes
+                if (sender.nl_pid == 0)
+                {
+                    onUevent(ueventBuffer.data(), size);
+                }
+                senderSize = sizeof(sender);
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                int lastErrno = errno;
+                log<level::WARNING>("Failed to receive the uevents",
+                                    entry("ERRNO=%d", lastErrno),
+                                    entry("ERRNO_STR=%s", strerror(lastErrno)));
+            }
+            receiveUevents();
+        });
+}
+
+// A uevent is the "<action>@<devpath>" header followed by the "KEY=value"
+// variables, all of them zero-terminated
+void GpioHotplug::onUevent(const char* uevent, size_t size)
+{
+    string action;
+    string subsystem;
+    string devName;
+    const char* end = uevent + size;
+    for (const char* variable = uevent; variable < end;
+         variable += strnlen(variable, end - variable) + 1)
+    {
+        string_view v(variable, strnlen(variable, end - variable));
+        if (v.starts_with("ACTION="))
+        {
+            action = v.substr(strlen("ACTION="));
+        }
+        else if (v.starts_with("SUBSYSTEM="))
+        {
+            subsystem = v.substr(strlen("SUBSYSTEM="));
+        }
+        else if (v.starts_with("DEVNAME="))
+        {
+            devName = v.substr(strlen("DEVNAME="));
+        }
+    }
+    // The legacy sysfs gpio chips have no device node, hence no DEVNAME
+    if (subsystem != "gpio" || !devName.starts_with("gpiochip"))
+    {
+        return;
+    }
+    if (action == "add")
+    {
+        onChipAdded(devName);
+    }
+    else if (action == "remove")
+    {
+        onChipRemoved(devName);
+    }
+}
+
+// The kernel creates the device node before sending the "add" uevent, so the
+// chip can be opened right away
+void GpioHotplug::onChipAdded(const string& chipName)
+{
+    for (auto& pin : pins)
+    {
+        if (pin.chipName == chipName &&
+            gpioChips.getMissingPins().contains(pin.pinName))
+        {
+            attach(pin);
+        }
+    }
+}
+
+void GpioHotplug::onChipRemoved(const string& chipName)
+{
+    for (auto& pin : pins)
+    {
+        if (pin.chipName == chipName &&
+            !gpioChips.getMissingPins().contains(pin.pinName))
+        {
+            log<level::WARNING>("Gpio chip removed, pin unavailable",
+                                pinNameEntry(pin.pinName),
+                                chipEntry(chipName));
+            chipRemoved[pin.pinIndex] = true;
+            gpioStats.setPinAvailable(pin.pinName, false);
+            // No thread hands an output back, it's owned by this thread
+            if (pin.isOutput)
+            {
+                detach(pin);
+            }
+        }
+    }
+}
+
+bool GpioHotplug::attach(MonitoredPin& pin)
+{
+    const GpioPinConfig& config = configs[pin.pinIndex];
+    int lastErrno = 0;
+    bool attached = gpioChips.attachPin(config, lastErrno);
+    if (attached && !gpioLines.attachPin(gpioChips, config, lastErrno))
+    {
+        gpioChips.detachPin(config.name);
+        attached = false;
+    }
+    if (!attached)
+    {
+        // Errors logged by 'attachPin', no error if the chip is still missing
+        if (lastErrno != 0)
+        {
+            log<level::WARNING>("Failed to attach the pin, it stays "
+                                "unavailable",
+                                pinNameEntry(pin.pinName),
+                                chipEntry(pin.chipName));
+        }
+        return false;
+    }
+    pin.lines = gpioLines.getDbusPropMapLineObj().at(config.name);
+    gpioStats.setPinAvailable(pin.pinName, true);
+    log<level::INFO>("Gpio chip appeared, pin attached",
+                     pinNameEntry(pin.pinName), chipEntry(pin.chipName));
+    startPin(pin);
+    return true;
+}
+
+void GpioHotplug::detach(MonitoredPin& pin)
+{
+    gpioLines.detachPin(pin.pinName);
+    gpioChips.detachPin(pin.pinName);
+    pin.lines.clear();
+    // A polled pin is attached again with a line request of its own
+    pin.polledLines = nullptr;
+    chipRemoved[pin.pinIndex] = false;
+    gpioStats.setPinAvailable(pin.pinName, false);
+    log<level::WARNING>("Pin detached until its gpio chip appears again",
+                        pinNameEntry(pin.pinName), chipEntry(pin.chipName));
+    // Its "add" uevent was ignored if the chip came back while the pin was
+    // still attached
+    if (chipExists(pin.chipName))
+    {
+        attach(pin);
+    }
+}
+
+} // namespace gpio_handler
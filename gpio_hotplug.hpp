@@ -0,0 +1,105 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <gpio_chips.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_lines.hpp>
+#include <gpio_publisher.hpp>
+#include <gpio_stats.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Attaches the pins of the gpio chips appearing after the service
+ * start, and detaches those of the removed chips, instead of failing
+ *
+ * The pins whose chip is missing at the start (see @ref
+ * GpioChips::getMissingPins) are published with their initial values and
+ * listed in the 'UnavailablePins' statistics property (see @ref
+ * GpioStats::setPinAvailable), while the other pins are served as usual.
+ *
+ * The kernel's uevents are received on a netlink socket by the DBus server
+ * thread (the one running the @io context). When a gpio chip appears, its
+ * missing pins get their lines requested and a monitoring thread of their own
+ * is started. When a chip is removed, its pins are marked unavailable, and
+ * their threads, failing to read the lines, hand them back by @ref
+ * releaseIfChipRemoved instead of stopping the service. The lines and the
+ * chip are then closed on the DBus server thread, and the pins wait for the
+ * chip to appear again. The output pins (see @ref GpioOutputs), having no
+ * thread, are detached right away.
+ *
+ * The pins served by a @ref GpioWorkerPool can't be handed back, a removal of
+ * their chip still stops the service.
+ */
+class GpioHotplug
+{
+  public:
+    /** @brief Starts the monitoring of an attached pin, or takes an attached
+     * output back in use **/
+    using PinStarter = std::function<void(MonitoredPin&)>;
+
+    /**
+     * @brief Mark the missing pins of @gpioChips among the @pins unavailable
+     * in @gpioStats and open the uevent socket on the @io context.
+     *
+     * The @pins are in the order of their config entries in @gpioConfig (see
+     * @ref createMonitoredPins). All the arguments must outlive this object.
+     *
+     * Throw @ref std::system_error if the socket could not be created.
+     */
+    GpioHotplug(boost::asio::io_context& io, GpioChips& gpioChips,
+                GpioLines& gpioLines, const GpioJsonConfig& gpioConfig,
+                GpioStats& gpioStats, std::vector<MonitoredPin>& pins,
+                PinStarter startPin);
+
+    GpioHotplug(const GpioHotplug&) = delete;
+    GpioHotplug& operator=(const GpioHotplug&) = delete;
+
+    /**
+     * @brief Start receiving the uevents, then attach the missing pins whose
+     * chip appeared since the construction, with @startPin.
+     *
+     * To be called on the DBus server thread, once the monitoring threads
+     * run.
+     */
+    void start();
+
+    /**
+     * @brief Hand the @pin, whose monitoring thread is about to finish, back
+     * for detaching if its chip was removed. Can be called from any thread.
+     *
+     * @return True if the chip was removed; the caller must not touch the pin
+     * any more then. False otherwise.
+     */
+    bool releaseIfChipRemoved(MonitoredPin& pin) noexcept;
+
+  private:
+    boost::asio::io_context& io;
+    GpioChips& gpioChips;
+    GpioLines& gpioLines;
+    const std::vector<GpioPinConfig>& configs;
+    GpioStats& gpioStats;
+    std::vector<MonitoredPin>& pins;
+    PinStarter startPin;
+    /** @brief Per pin: its chip was removed since the pin was attached **/
+    std::unique_ptr<std::atomic<bool>[]> chipRemoved;
+    boost::asio::posix::stream_descriptor uevents;
+    std::vector<char> ueventBuffer;
+
+    void receiveUevents();
+    void onUevent(const char* uevent, size_t size);
+    void onChipAdded(const std::string& chipName);
+    void onChipRemoved(const std::string& chipName);
+    bool attach(MonitoredPin& pin);
+    void detach(MonitoredPin& pin);
+};
+
+} // namespace gpio_handler
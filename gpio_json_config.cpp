@@ -1,9 +1,11 @@
 #include <gpio_json_config.hpp>
-#include <gpio_utils.hpp>
 #include <phosphor-logging/log.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <set>
 #include <sstream>
+#include <variant>
 
 using namespace std;
 using json = nlohmann::json;
@@ -21,8 +23,37 @@ static constexpr int jsonSemanticError = 600;
 
 const string GpioJsonConfig::configKeyGpioChip = "gpio_chip";
 const string GpioJsonConfig::configKeyGpioPin = "gpio_pin";
+const string GpioJsonConfig::configKeyGpioPins = "gpio_pins";
+const string GpioJsonConfig::configKeyLineName = "line_name";
 const string GpioJsonConfig::configKeyInitialPinVal = "initial";
 const string GpioJsonConfig::configKeyReadPeriod = "read_period_sec";
+const string GpioJsonConfig::configKeyMode = "mode";
+const string GpioJsonConfig::configKeyWindow = "window_sec";
+const string GpioJsonConfig::configKeyPriority = "priority";
+const string GpioJsonConfig::configKeyOnRising = "on_rising";
+const string GpioJsonConfig::configKeyOnFalling = "on_falling";
+
+const array<string, 3> GpioJsonConfig::measurementPropertySuffixes = {
+    "_EdgeCount", "_FrequencyMilliHz", "_DutyCyclePpm"};
+
+/** @brief Measurement window of the entries not specifying one **/
+static constexpr double defaultWindowSec = 1.0;
+
+/** @brief Time allowed to an action of the entries not specifying one **/
+static constexpr double defaultActionTimeoutSec = 5.0;
+
+/** @brief Fault window of the entries not specifying one **/
+static constexpr double defaultFaultWindowSec = 0.01;
+
+/** @brief The action names and the numbers of the words following them,
+ * -1 standing for at least 4 **/
+static const pair<const char*, pair<PinActionType, int>> actionSyntax[] = {
+    {"start_unit", {PinActionType::startUnit, 1}},
+    {"stop_unit", {PinActionType::stopUnit, 1}},
+    {"restart_unit", {PinActionType::restartUnit, 1}},
+    {"call", {PinActionType::call, -1}},
+    {"write", {PinActionType::write, 2}},
+};
 
 const string GpioJsonConfig::expectedJsonConfigFormat =
     string("{\n") +                                                       //
@@ -37,184 +68,255 @@ const string GpioJsonConfig::expectedJsonConfigFormat =
     string("    \"") + configKeyGpioPin + string("\" : 32,\n") +          //
     string("    \"") + configKeyInitialPinVal + string("\" : false,\n") + //
     string("    \"") + configKeyReadPeriod + string("\" : 3\n") +         //
+    string("  },\n") +                                                    //
+    string("  \"BOARD_ID\" : {\n") +                                      //
+    string("    \"") + configKeyGpioChip + string("\" : 1,\n") +          //
+    string("    \"") + configKeyGpioPins + string("\" : [10, 11, 12],\n") + //
+    string("    \"") + configKeyInitialPinVal + string("\" : 0,\n") +     //
+    string("    \"") + configKeyReadPeriod + string("\" : 10\n") +        //
+    string("  },\n") +                                                    //
+    string("  \"PSU0_PRESENT\" : {\n") +                                  //
+    string("    \"") + configKeyLineName + string("\" : \"PSU0_PRSNT\",\n") + //
+    string("    \"") + configKeyInitialPinVal + string("\" : false,\n") + //
+    string("    \"") + configKeyReadPeriod + string("\" : 1\n") +         //
+    string("  },\n") +                                                    //
+    string("  \"BMC_READY\" : {\n") +                                     //
+    string("    \"") + configKeyLineName + string("\" : \"BMC_READY\",\n") + //
+    string("    \"") + configKeyMode + string("\" : \"output\",\n") +     //
+    string("    \"") + configKeyInitialPinVal + string("\" : false,\n") + //
+    string("    \"") + configKeyReadPeriod + string("\" : 1\n") +         //
     string("  }\n") +                                                     //
     string("  ...\n") +                                                   //
     string("}\n");                                                        //
 
-const nlohmann::json& GpioJsonConfig::getConfig() const
+const vector<GpioPinConfig>& GpioJsonConfig::getPins() const
 {
-    return config;
+    return pins;
 }
 
-static string jsonTypeToString(json::value_t type)
+bool GpioJsonConfig::isBusEntry(const GpioPinConfig& entry)
 {
-    switch (type)
-    {
-        case json::value_t::null:
-            return "null";
-        case json::value_t::boolean:
-            return "boolean";
-        case json::value_t::string:
-            return "string";
-        case json::value_t::number_integer:
-            return "number (integer)";
-        case json::value_t::number_unsigned:
-            return "number (unsigned integer)";
-        case json::value_t::number_float:
-            return "number (floating-point)";
-        case json::value_t::object:
-            return "object";
-        case json::value_t::array:
-            return "array";
-        case json::value_t::binary:
-            return "binary";
-        case json::value_t::discarded:
-            return "discarded";
-        default:
-            return "<unknown>";
-    }
+    return entry.gpioPins.has_value();
 }
 
-static void logErrorBadType(const string& typeName, const json& jsonValue,
-                            const string& context)
+unsigned GpioJsonConfig::getChipNumber(const GpioPinConfig& entry)
 {
-    stringstream ss;
-    ss << "Error when parsing value of the attribute '" << context
-       << "': expected value of type '" << typeName << "'. Got '"
-       << jsonValue.dump(2) << "' (type: " << jsonTypeToString(jsonValue.type())
-       << ")" << endl;
-    log<level::ERR>(ss.str().c_str());
+    // Not resolved to a number if no gpio hardware is used
+    return (unsigned)entry.gpioChip.value_or(0);
 }
 
-static bool isJsonValueObject(const json& jsonValue, const string& context)
+vector<unsigned> GpioJsonConfig::getPinNumbers(const GpioPinConfig& entry)
 {
-    bool result = jsonValue.is_object();
-    if (!result)
+    if (isBusEntry(entry))
     {
-        logErrorBadType("object", jsonValue, context);
+        return vector<unsigned>(entry.gpioPins->begin(),
+                                entry.gpioPins->end());
     }
-    return result;
+    // Not resolved to a number if no gpio hardware is used
+    return {(unsigned)entry.gpioPin.value_or(0)};
 }
 
-static bool isJsonValueBoolean(const json& jsonValue, const string& context)
+bool GpioJsonConfig::hasLineNames() const
 {
-    bool result = jsonValue.is_boolean();
-    if (!result)
-    {
-        logErrorBadType("boolean", jsonValue, context);
-    }
-    return result;
+    return any_of(pins.begin(), pins.end(),
+                  [](const auto& pin) { return pin.lineName.has_value(); });
 }
 
-static bool isJsonValueUnsignedInt(const json& jsonValue, const string& context)
+void GpioJsonConfig::resolveLineNames(const GpioLineNames& lineNames)
 {
-    bool result = jsonValue.is_number_unsigned();
-    if (!result)
+    bool resolved = true;
+    for (auto& pin : pins)
+    {
+        if (!pin.lineName.has_value())
+        {
+            continue;
+        }
+        const auto& locations = lineNames.find(*pin.lineName);
+        if (locations.size() == 1)
+        {
+            pin.gpioChip = locations.front().chipNumber;
+            pin.gpioPin = locations.front().offset;
+            continue;
+        }
+        stringstream ss;
+        ss << "The gpio line '" << *pin.lineName << "' of the entry '"
+           << pin.name << "' ";
+        if (locations.empty())
+        {
+            ss << "not found on any gpio chip";
+        }
+        else
+        {
+            ss << "is not unique, found at";
+            for (const auto& location : locations)
+            {
+                ss << " <" << location.chipName << " " << location.offset
+                   << ">";
+            }
+        }
+        log<level::ERR>(ss.str().c_str(),
+                        entry("LINE_NAME=%s", pin.lineName->c_str()),
+                        entry("GPIO_PIN_NAME=%s", pin.name.c_str()));
+        resolved = false;
+    }
+    if (!resolved)
     {
-        logErrorBadType("unsigned int", jsonValue, context);
+        throw GpioConfigError("Unresolved gpio line names");
     }
-    return result;
 }
 
-static bool isJsonValuePositiveNumber(const json& jsonValue,
-                                      const string& context)
+uint64_t GpioJsonConfig::getInitialValue(const GpioPinConfig& entry)
 {
-    bool result = jsonValue.is_number() && ((float)jsonValue) > 0;
-    if (!result)
-    {
-        logErrorBadType("positive number", jsonValue, context);
-    }
-    return result;
+    // Which alternative is used follows from the kind of the entry, as
+    // checked by 'parseGpioConfig'
+    return visit([](auto value) { return (uint64_t)value; }, entry.initial);
 }
 
-static bool hasJsonObjectAttr(const json& jsonObject, const string& attrName)
+bool GpioJsonConfig::isMeasuredEntry(const GpioPinConfig& entry)
 {
-    bool result = jsonObject.contains(attrName);
-    if (!result)
-    {
-        stringstream ss;
-        ss << "No expected '" << attrName
-           << "' attribute found in the json object '" << jsonObject.dump(2)
-           << "'" << endl;
-        log<level::ERR>(ss.str().c_str());
-    }
-    return result;
+    return entry.mode.has_value() && *entry.mode == "measure";
+}
+
+bool GpioJsonConfig::isOutputEntry(const GpioPinConfig& entry)
+{
+    return entry.mode.has_value() && *entry.mode == "output";
 }
 
-static bool isJsonPropertyGood(const json& jsonObject, const string& attrName,
-                               bool (*valueCriterion)(const json&,
-                                                      const string&))
+bool GpioJsonConfig::isPolledEntry(const GpioPinConfig& entry)
 {
-    return hasJsonObjectAttr(jsonObject, attrName) &&
-           valueCriterion(jsonObject[attrName], attrName);
+    return entry.mode.has_value() && *entry.mode == "poll";
 }
 
-static bool isPinDescriptionGood(const string& pinName, const json& jsonValue)
+uint64_t GpioJsonConfig::getWindowNs(const GpioPinConfig& entry)
 {
-    return isJsonValueObject(jsonValue, pinName) &&
-           isJsonPropertyGood(jsonValue, GpioJsonConfig::configKeyGpioChip,
-                              isJsonValueUnsignedInt) &&
-           isJsonPropertyGood(jsonValue, GpioJsonConfig::configKeyGpioPin,
-                              isJsonValueUnsignedInt) &&
-           isJsonPropertyGood(jsonValue, GpioJsonConfig::configKeyInitialPinVal,
-                              isJsonValueBoolean) &&
-           isJsonPropertyGood(jsonValue, GpioJsonConfig::configKeyReadPeriod,
-                              isJsonValuePositiveNumber);
+    return (uint64_t)(entry.windowSec.value_or(defaultWindowSec) * 1e9);
 }
 
-static bool isGpioNameGood(const string& name)
+PinPriority GpioJsonConfig::getPriority(const GpioPinConfig& entry)
 {
-    // Gpio names can containg only alphanumeric values
-    bool isSizeGood = name.size() > 0;
-    if (!isSizeGood)
+    return entry.priority.has_value() && *entry.priority == "critical"
+               ? PinPriority::critical
+               : PinPriority::normal;
+}
+
+vector<PinProperty> GpioJsonConfig::getProperties(const GpioPinConfig& entry)
+{
+    vector<PinProperty> properties;
+    if (isMeasuredEntry(entry))
     {
-        log<level::ERR>("Empty gpio pin name", pinNameEntry(""));
+        for (const auto& suffix : measurementPropertySuffixes)
+        {
+            properties.push_back(PinProperty{entry.name + suffix, true, 0});
+        }
     }
-    bool isNameGood = isSizeGood;
-    for (auto i = 0u; i < name.size() && isNameGood; ++i)
+    else
     {
-        bool isCharGood =
-            std::isalnum(name[i], std::locale::classic()) || name[i] == '_';
-        if (!isCharGood)
+        properties.push_back(
+            PinProperty{entry.name, isBusEntry(entry), getInitialValue(entry)});
+    }
+    return properties;
+}
+
+vector<PinAction> GpioJsonConfig::getActions(const GpioPinConfig& entry,
+                                             bool rising)
+{
+    const auto& texts = rising ? entry.onRising : entry.onFalling;
+    vector<PinAction> actions;
+    for (const auto& text : texts.value_or(vector<string>{}))
+    {
+        istringstream words(text);
+        string name;
+        words >> name;
+        vector<string> arguments;
+        string word;
+        while (words >> word)
+        {
+            arguments.push_back(word);
+        }
+        auto syntax =
+            find_if(begin(actionSyntax), end(actionSyntax),
+                    [&name](const auto& s) { return name == s.first; });
+        if (syntax == end(actionSyntax) ||
+            (syntax->second.second >= 0
+                 ? arguments.size() != (size_t)syntax->second.second
+                 : arguments.size() < 4))
         {
             stringstream ss;
-            ss << "Gpio name '" << name << "' contains invalid character: '"
-               << name[i] << "'" << endl;
-            ss << "Allowed characters: basic alphanumeric + '_' ";
-            log<level::ERR>(ss.str().c_str(), pinNameEntry(name));
+            ss << "Invalid action '" << text << "' in '"
+               << (rising ? configKeyOnRising : configKeyOnFalling)
+               << "' of the entry '" << entry.name << "'";
+            log<level::ERR>(ss.str().c_str());
+            throw GpioConfigError("Invalid action");
         }
-        isNameGood = isCharGood;
+        actions.push_back(
+            PinAction{syntax->second.first, std::move(arguments), text});
     }
-    return isNameGood;
+    return actions;
+}
+
+uint64_t GpioJsonConfig::getActionTimeoutNs(const GpioPinConfig& entry)
+{
+    return (uint64_t)(entry.actionTimeoutSec.value_or(defaultActionTimeoutSec) *
+                      1e9);
 }
 
-static bool isJsonObjectNonEmpty(const json& jsonObject)
+bool GpioJsonConfig::isFaultAssertedHigh(const GpioPinConfig& entry)
 {
-    bool isNonEmpty = !jsonObject.empty();
-    if (!isNonEmpty)
+    return entry.faultAsserted.value_or("high") == "high";
+}
+
+uint64_t GpioJsonConfig::getFaultWindowNs(const GpioPinConfig& entry)
+{
+    return (uint64_t)(entry.faultWindowSec.value_or(defaultFaultWindowSec) *
+                      1e9);
+}
+
+void GpioJsonConfig::checkActions() const
+{
+    for (const auto& pin : pins)
     {
-        log<level::ERR>("Empty json object");
+        // The schema restricts them to the entries with transitions, but
+        // not their syntax
+        getActions(pin, true);
+        getActions(pin, false);
     }
-    return isNonEmpty;
 }
 
-static bool isJsonConfigFormatGood(const json& jsonValue)
+void GpioJsonConfig::checkPropertyNames() const
 {
-    bool isFormatGood = isJsonValueObject(jsonValue, "<root>") &&
-                        isJsonObjectNonEmpty(jsonValue);
-    for (auto it = jsonValue.cbegin(); it != jsonValue.cend() && isFormatGood;
-         ++it)
+    // The entry names are unique, but a measured entry's property can still
+    // clash with another entry's name
+    set<string> names;
+    for (const auto& pin : pins)
     {
-        isFormatGood = isGpioNameGood(it.key()) &&
-                       isPinDescriptionGood(it.key(), it.value());
+        for (const auto& property : getProperties(pin))
+        {
+            if (!names.insert(property.name).second)
+            {
+                stringstream ss;
+                ss << "The property '" << property.name
+                   << "' of the entry '" << pin.name
+                   << "' clashes with another property of the same name";
+                log<level::ERR>(ss.str().c_str());
+                throw GpioConfigError("Duplicate property name");
+            }
+        }
     }
-    return isFormatGood;
 }
 
 GpioConfigError::GpioConfigError(const char* message) :
     json::exception(jsonSemanticError, message)
 {}
 
+GpioJsonConfig::GpioJsonConfig(span<const GpioEmbeddedPinConfig> table)
+{
+    pins.reserve(table.size());
+    for (const auto& entry : table)
+    {
+        pins.push_back(toGpioPinConfig(entry));
+    }
+}
+
 GpioJsonConfig::GpioJsonConfig(const string& fileName)
 {
 #ifdef ENABLE_GSH_LOGS
@@ -231,14 +333,18 @@ GpioJsonConfig::GpioJsonConfig(const string& fileName)
         json jsonConfig;
         jsonFile >> jsonConfig;
 
-        if (isJsonConfigFormatGood(jsonConfig))
-        {
-            config = jsonConfig;
-        }
-        else
+        GpioConfigValidationError error;
+        if (!parseGpioConfig(jsonConfig, pins, error))
         {
+            stringstream ss;
+            ss << "Error when validating the attribute '" << error.path
+               << "': " << error.message;
+            log<level::ERR>(ss.str().c_str(),
+                            entry("FILE=%s", fileName.c_str()));
             throw GpioConfigError("Malformed config file");
         }
+        checkPropertyNames();
+        checkActions();
     }
     else
     {
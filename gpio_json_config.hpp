@@ -1,17 +1,73 @@
 #pragma once
 
+#include <gpio_config_schema.hpp>
+#include <gpio_line_names.hpp>
 #include <nlohmann/json.hpp>
 
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
 namespace gpio_handler
 {
 
+/** @brief Urgency of the changes of a pin, see the "priority" config
+ * property **/
+enum class PinPriority
+{
+    normal,
+    critical,
+};
+
+/** @brief Number of the @ref PinPriority values **/
+constexpr size_t pinPriorityCount = 2;
+
+/** @brief A DBus property published for a config entry **/
+struct PinProperty
+{
+    std::string name;
+    /** @brief True for an unsigned 64-bit integer property, false for a
+     * boolean one **/
+    bool isInteger;
+    /** @brief Value of the property before anything was read, 0 or 1 for a
+     * boolean property **/
+    uint64_t initial;
+};
+
+/** @brief Kinds of the actions run on the pin transitions, see the
+ * "on_rising" config property **/
+enum class PinActionType
+{
+    startUnit,
+    stopUnit,
+    restartUnit,
+    call,
+    write,
+};
+
+/** @brief An action run on a transition of a pin **/
+struct PinAction
+{
+    PinActionType type;
+    /** @brief The words following the action name: the unit; the service,
+     * object, interface, method and the string arguments; the file and the
+     * value **/
+    std::vector<std::string> arguments;
+    /** @brief The action as written in the config, for the logs **/
+    std::string text;
+};
+
 /**
  * @brief Represents the correctly formed configuration file
  *
  * While the 'nlohmann::json' library performs the syntactic check this class
- * focuses on the semantics. Malformed file will cause the constructor to throw
- * an exception, so that receiving the object of this type can guarantees a
- * properly formed json config.
+ * focuses on the semantics. The rules are those of 'gpio-config-schema.json',
+ * turned into the @ref parseGpioConfig validator and the @ref GpioPinConfig
+ * struct at build time (see 'scripts/gen_config_validator.py'). Malformed file
+ * will cause the constructor to throw an exception, so that receiving the
+ * object of this type can guarantees a properly formed json config.
  *
  * Properly formed config file example:
  *
@@ -27,8 +83,47 @@ namespace gpio_handler
  *     "gpio_pin" : 109,
  *     "initial" : false,
  *     "read_period_sec" : 4
+ *   },
+ *   "BOARD_ID" : {
+ *     "gpio_chip" : 1,
+ *     "gpio_pins" : [10, 11, 12],
+ *     "initial" : 0,
+ *     "read_period_sec" : 10
  *   }
  * }
+ *
+ * An entry with "gpio_pins" instead of "gpio_pin" describes a multi-bit bus:
+ * an ordered group of pins on one chip published as a single unsigned integer
+ * property, the first pin being the least significant bit. Its "initial" value
+ * is then an unsigned integer too.
+ *
+ * An entry with "mode" : "measure" doesn't publish the pin state. It publishes
+ * the edge count, frequency and duty cycle of the pin over the "window_sec"
+ * windows instead, as the integer properties named after the entry with the
+ * @ref measurementPropertySuffixes. See @ref getProperties.
+ *
+ * A single pin in the "level" mode may list the actions run when its property
+ * changes to true ("on_rising") or to false ("on_falling"), each allowed
+ * "action_timeout_sec". See @ref getActions. Such a pin may also belong to a
+ * "fault_group", see @ref GpioFaultGroups.
+ *
+ * A single pin with "mode" : "output" is not monitored. Its line is requested
+ * as an output driven to the "initial" level, and then set through the @ref
+ * GpioOutputs, publishing the level last set. It may list actions, run on the
+ * transitions set, but has no edges for a fault group.
+ *
+ * A single pin with "mode" : "poll" is read by polling only, every
+ * "read_period_sec". Its line is requested as an input without edge events,
+ * together with the other polled lines of its chip, see @ref GpioLines. It
+ * may list actions too, but has no edges for a fault group.
+ *
+ * A single pin or a bus in the "level" mode may belong to a "pin_group",
+ * whose monitoring is suspended and resumed together, see @ref GpioPinGroups.
+ *
+ * Fixed platform builds can embed the config into the service instead (the
+ * 'embedded_config' meson option). It's then checked against the schema at
+ * build time and turned into a 'constexpr' table of @ref GpioEmbeddedPinConfig
+ * entries, from which the object is created without any parsing.
  */
 class GpioJsonConfig
 {
@@ -40,6 +135,14 @@ class GpioJsonConfig
     /** @brief Name of the property in a gpio pin configuration
      * entry specifying the gpio pin **/
     static const std::string configKeyGpioPin;
+    /** @brief Name of the property in a gpio bus configuration entry
+     * specifying the ordered gpio pins of the bus, alternative to
+     * @ref configKeyGpioPin **/
+    static const std::string configKeyGpioPins;
+    /** @brief Name of the property in a gpio pin configuration entry
+     * specifying the name of the gpio line, alternative to @ref
+     * configKeyGpioChip and @ref configKeyGpioPin **/
+    static const std::string configKeyLineName;
     /** @brief Name of the property in a gpio pin configuration entry specifying
      * the initial value of the corresponding DBus property before the real gpio
      * pin state could be obtained **/
@@ -47,6 +150,24 @@ class GpioJsonConfig
     /** @brief Name of the property in a gpio pin configuration entry specifying
      * the minimal DBus property refresh rate. **/
     static const std::string configKeyReadPeriod;
+    /** @brief Name of the property in a gpio pin configuration entry specifying
+     * what is published for the pin **/
+    static const std::string configKeyMode;
+    /** @brief Name of the property in a gpio pin configuration entry specifying
+     * the measurement window of the "measure" mode **/
+    static const std::string configKeyWindow;
+    /** @brief Name of the property in a gpio pin configuration entry specifying
+     * the urgency of the pin changes **/
+    static const std::string configKeyPriority;
+    /** @brief Names of the properties in a gpio pin configuration entry
+     * listing the actions run on the rising and the falling transitions **/
+    static const std::string configKeyOnRising;
+    static const std::string configKeyOnFalling;
+
+    /** @brief Suffixes of the names of the properties published for a pin in
+     * the "measure" mode: edge count, frequency [mHz] and duty cycle [ppm] in
+     * the last window **/
+    static const std::array<std::string, 3> measurementPropertySuffixes;
 
     /** @brief Examplar config file for the help message purposes **/
     static const std::string expectedJsonConfigFormat;
@@ -55,21 +176,116 @@ class GpioJsonConfig
      * @brief Create the json configureation object from the given @fileName.
      *
      * Specifically: 1. open the @fileName, 2. read into @nlohmann::json object,
-     * 3. check the configuration format, 4. save the @nlohmann::json
-     * object for future use, 5. close the file.
+     * 3. check the configuration format converting it into the
+     * @ref GpioPinConfig entries for future use, 4. close the file.
      *
      * At first 3 steps an exception can be thrown: 1. from the 'std'
      * library, 2. from the 'nlohmann::json' library, 3. an instance of
-     * @GpioConfigError.
+     * @GpioConfigError, also if the names of the properties published for the
+     * entries (see @ref getProperties) are not unique or an action is not
+     * valid (see @ref getActions).
      */
     explicit GpioJsonConfig(const std::string& fileName);
 
-    /** @brief Get the json config object read from @fileName
-     * passed to the constructor. **/
-    const nlohmann::json& getConfig() const;
+    /**
+     * @brief Create the configuration object from the @table embedded into the
+     * service at build time (see the 'embedded_config' meson option).
+     *
+     * The @table was checked against the schema, the uniqueness of the
+     * property names and the actions when it was generated, so nothing is
+     * read, parsed or validated here.
+     */
+    explicit GpioJsonConfig(std::span<const GpioEmbeddedPinConfig> table);
+
+    /** @brief Get the entries of the config passed to the constructor, in the
+     * order of their names. **/
+    const std::vector<GpioPinConfig>& getPins() const;
+
+    /** @brief True if any entry is given by the name of its gpio line rather
+     * than by the chip and pin numbers **/
+    bool hasLineNames() const;
+
+    /**
+     * @brief Set the chip and pin numbers of the entries given by the name of
+     * their gpio line to those of the line in @lineNames.
+     *
+     * Until then, the pin numbers of such entries are 0 and they have no chip
+     * number. Throw @ref GpioConfigError, once all the entries were checked,
+     * if any line name is not found or not unique.
+     */
+    void resolveLineNames(const GpioLineNames& lineNames);
+
+    /** @brief True if the config @entry describes a multi-bit bus rather than
+     * a single pin **/
+    static bool isBusEntry(const GpioPinConfig& entry);
+
+    /** @brief Get the gpio chip number of the config @entry **/
+    static unsigned getChipNumber(const GpioPinConfig& entry);
+
+    /** @brief Get the gpio pin numbers of the config @entry, a single one
+     * unless it's a bus **/
+    static std::vector<unsigned> getPinNumbers(const GpioPinConfig& entry);
+
+    /** @brief Get the initial property value of the config @entry, 0 or 1 for
+     * a single pin **/
+    static uint64_t getInitialValue(const GpioPinConfig& entry);
+
+    /** @brief True if the config @entry is in the "measure" mode **/
+    static bool isMeasuredEntry(const GpioPinConfig& entry);
+
+    /** @brief True if the config @entry is in the "output" mode **/
+    static bool isOutputEntry(const GpioPinConfig& entry);
+
+    /** @brief True if the config @entry is in the "poll" mode **/
+    static bool isPolledEntry(const GpioPinConfig& entry);
+
+    /** @brief Get the measurement window of the config @entry [nanoseconds] **/
+    static uint64_t getWindowNs(const GpioPinConfig& entry);
+
+    /** @brief Get the priority of the config @entry **/
+    static PinPriority getPriority(const GpioPinConfig& entry);
+
+    /**
+     * @brief Get the DBus properties published for the config @entry.
+     *
+     * A single property named after the entry, boolean for a pin and integer
+     * for a bus. In the "measure" mode the integer properties named after the
+     * entry with each of the @ref measurementPropertySuffixes, in that order.
+     */
+    static std::vector<PinProperty> getProperties(const GpioPinConfig& entry);
+
+    /**
+     * @brief Get the actions of the config @entry run on its @rising or
+     * falling transition, in the config order.
+     *
+     * The words of an action are separated by spaces:
+     *
+     *   start_unit <unit>, stop_unit <unit>, restart_unit <unit>
+     *   call <service> <object> <interface> <method> [<string argument>...]
+     *   write <file> <value>
+     *
+     * Throw @ref GpioConfigError if an action is not valid.
+     */
+    static std::vector<PinAction> getActions(const GpioPinConfig& entry,
+                                             bool rising);
+
+    /** @brief Get the time allowed to every action of the config @entry
+     * [nanoseconds] **/
+    static uint64_t getActionTimeoutNs(const GpioPinConfig& entry);
+
+    /** @brief True if the fault of the config @entry in a "fault_group" is
+     * the high level **/
+    static bool isFaultAssertedHigh(const GpioPinConfig& entry);
+
+    /** @brief Get the fault window of the config @entry in a "fault_group"
+     * [nanoseconds] **/
+    static uint64_t getFaultWindowNs(const GpioPinConfig& entry);
 
   private:
-    nlohmann::json config;
+    std::vector<GpioPinConfig> pins;
+
+    void checkPropertyNames() const;
+    void checkActions() const;
 };
 
 /**
@@ -0,0 +1,68 @@
+#include <gpiod.h>
+
+#include <gpio_line_names.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+GpioLineNames::GpioLineNames()
+{
+    struct gpiod_chip_iter* chips = gpiod_chip_iter_new();
+    if (chips == NULL)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to enumerate the gpio chips");
+    }
+    size_t chipCount = 0;
+    size_t lineCount = 0;
+    // The iterator closes every chip when moving to the next one
+    struct gpiod_chip* chip;
+    while ((chip = gpiod_chip_iter_next(chips)) != NULL)
+    {
+        const char* chipName = gpiod_chip_name(chip);
+        unsigned chipNumber = strtoul(chipName + strlen("gpiochip"), NULL, 10);
+        ++chipCount;
+        for (auto offset = 0u; offset < gpiod_chip_num_lines(chip); ++offset)
+        {
+            struct gpiod_line* line = gpiod_chip_get_line(chip, offset);
+            const char* lineName = line != NULL ? gpiod_line_name(line) : NULL;
+            if (lineName != NULL && *lineName != '\0')
+            {
+                lines[lineName].push_back(
+                    Location{chipName, chipNumber, offset});
+                ++lineCount;
+            }
+        }
+    }
+    gpiod_chip_iter_free(chips);
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Gpio line names indexed",
+                     entry("CHIPS=%zu", chipCount),
+                     entry("NAMED_LINES=%zu", lineCount));
+#else
+    (void)chipCount;
+    (void)lineCount;
+#endif
+}
+
+const vector<GpioLineNames::Location>&
+    GpioLineNames::find(const string& name) const
+{
+    static const vector<Location> none;
+    auto it = lines.find(name);
+    return it != lines.end() ? it->second : none;
+}
+
+} // namespace gpio_handler
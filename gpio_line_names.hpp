@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Index of the named lines of all the gpio chips, built by a single
+ * enumeration of the chips and their lines
+ *
+ * A lookup is a hash lookup rather than a scan of all the chips, as done by
+ * 'gpiod_line_find' for every name, so resolving hundreds of named pins (see
+ * @ref GpioJsonConfig::resolveLineNames) costs one enumeration. The unnamed
+ * lines are not indexed.
+ */
+class GpioLineNames
+{
+  public:
+    /** @brief Where a named line is **/
+    struct Location
+    {
+        /** @brief Name of the gpio chip, ie "gpiochip0" **/
+        std::string chipName;
+        /** @brief The number in the chip's device path **/
+        unsigned chipNumber;
+        /** @brief Line offset on the chip **/
+        unsigned offset;
+    };
+
+    /**
+     * @brief Enumerate the lines of all the gpio chips present.
+     *
+     * Throw @ref std::system_error if the chips could not be enumerated.
+     */
+    GpioLineNames();
+
+    /** @brief Get all the lines named @name, none if there is no such line,
+     * several if the name is not unique **/
+    const std::vector<Location>& find(const std::string& name) const;
+
+  private:
+    std::unordered_map<std::string, std::vector<Location>> lines;
+};
+
+} // namespace gpio_handler
@@ -3,6 +3,7 @@
 #include <gpio_utils.hpp>
 #include <phosphor-logging/log.hpp>
 
+#include <algorithm>
 #include <sstream>
 
 using phosphor::logging::entry;
@@ -15,16 +16,27 @@ using json = nlohmann::json;
 namespace gpio_handler
 {
 
+/** @brief Consumer of the lines requested together by the polled pins, shown
+ * by the `gpioinfo' CLI tool **/
+static constexpr const char* polledLinesConsumer = "gpio-status-handlerd";
+
 GpioLines::GpioLines(const GpioChips& gpioChips,
                      const GpioJsonConfig& jsonConfig)
 {
     int lastErrno = 0;
-    if (openGpioLines(gpioChips.getDbusPropMapChipObj(), jsonConfig.getConfig(),
+    // The polled lines are opened from the chip handles of their requests
+    map<string, gpiod_chip_t*> chips = gpioChips.getDbusPropMapChipObj();
+    if (openPolledChips(jsonConfig.getPins(), chips, lastErrno) &&
+        openGpioLines(chips, jsonConfig.getPins(), dbusPropMapLineObj,
                       lastErrno))
     {
-        if (!requestBothEdgesEvents(lastErrno))
+        if (!requestPolledLines(dbusPropMapLineObj, polledRequests,
+                                lastErrno) ||
+            !requestLines(dbusPropMapLineObj, jsonConfig.getPins(),
+                          polledRequests, lastErrno))
         {
-            closeGpioLines();
+            closeGpioLines(dbusPropMapLineObj);
+            closePolledChips();
             throw std::system_error(
                 std::error_code(lastErrno, std::system_category()),
                 "Failed to request names for all the gpio lines required");
@@ -32,6 +44,7 @@ GpioLines::GpioLines(const GpioChips& gpioChips,
     }
     else
     {
+        closePolledChips();
         throw std::system_error(
             std::error_code(lastErrno, std::system_category()),
             "Failed to open all the required gpio lines");
@@ -40,113 +53,223 @@ GpioLines::GpioLines(const GpioChips& gpioChips,
 
 GpioLines::~GpioLines()
 {
-    closeGpioLines();
+    closeGpioLines(dbusPropMapLineObj);
+    closePolledChips();
 }
 
-const map<string, gpiod_line_t*>& GpioLines::getDbusPropMapLineObj() const
+const map<string, vector<gpiod_line_t*>>&
+    GpioLines::getDbusPropMapLineObj() const
 {
     return dbusPropMapLineObj;
 }
 
-// If result is 'true' then 'dbusPropMapLineObj' contains all the
-// keys 'k' from 'dbusPropMapChipObj' and the corresponding
-// values 'v' were obtained by calling 'gpiod_chip_get_line'. The
-// resulting 'dbusPropMapLineObj' is bijective (102).
+vector<vector<string>> GpioLines::getPolledRequests() const
+{
+    vector<vector<string>> requests;
+    for (const auto& request : polledRequests)
+    {
+        requests.push_back(request.pinNames);
+    }
+    return requests;
+}
+
+bool GpioLines::attachPin(const GpioChips& gpioChips, const GpioPinConfig& pin,
+                          int& lastErrno) noexcept
+{
+    LineMap lineMap;
+    if (!openGpioLines(gpioChips.getDbusPropMapChipObj(), {pin}, lineMap,
+                       lastErrno))
+    {
+        return false;
+    }
+    if (!requestLines(lineMap, {pin}, {}, lastErrno))
+    {
+        closeGpioLines(lineMap);
+        return false;
+    }
+    dbusPropMapLineObj.merge(lineMap);
+    return true;
+}
+
+void GpioLines::detachPin(const string& pinName) noexcept
+{
+    auto node = dbusPropMapLineObj.extract(pinName);
+    if (!node.empty())
+    {
+        LineMap lineMap;
+        lineMap.insert(move(node));
+        closeGpioLines(lineMap);
+    }
+    for (auto it = polledRequests.begin(); it != polledRequests.end(); ++it)
+    {
+        auto nameIt = find(it->pinNames.begin(), it->pinNames.end(), pinName);
+        if (nameIt != it->pinNames.end())
+        {
+            it->pinNames.erase(nameIt);
+            // Closed once no line of the request is left
+            if (it->pinNames.empty())
+            {
+                gpiod_chip_close(it->chip);
+                polledRequests.erase(it);
+            }
+            break;
+        }
+    }
+}
+
+// Open a chip handle for every request of the polled pins of 'pins' present
+// in 'chips', each of at most GPIOD_LINE_BULK_MAX_LINES pins of a single chip,
+// and put it in place of the pins' own handles in 'chips'. On failure log the
+// error and set 'lastErrno', the requests opened so far are left to
+// 'closePolledChips'.
+
+bool GpioLines::openPolledChips(const vector<GpioPinConfig>& pins,
+                                map<string, gpiod_chip_t*>& chips,
+                                int& lastErrno) noexcept
+{
+    // gpio chip number -> position of its request being filled
+    map<unsigned, size_t> filledRequests;
+    for (const auto& pin : pins)
+    {
+        if (!GpioJsonConfig::isPolledEntry(pin) || !chips.contains(pin.name))
+        {
+            continue;
+        }
+        unsigned gpioChipNum = GpioJsonConfig::getChipNumber(pin);
+        auto it = filledRequests.find(gpioChipNum);
+        if (it == filledRequests.end() ||
+            polledRequests[it->second].pinNames.size() ==
+                GPIOD_LINE_BULK_MAX_LINES)
+        {
+            gpiod_chip_t* chip = gpiod_chip_open_by_number(gpioChipNum);
+            if (chip == NULL)
+            {
+                lastErrno = errno;
+                stringstream funcall;
+                funcall << "gpiod_chip_open_by_number(" << gpioChipNum << ")";
+                logLibgpioCallError(funcall, (int)NULL, lastErrno);
+                return false;
+            }
+            polledRequests.push_back(PolledRequest{chip, {}});
+            filledRequests[gpioChipNum] = polledRequests.size() - 1;
+        }
+        PolledRequest& request = polledRequests[filledRequests[gpioChipNum]];
+        request.pinNames.push_back(pin.name);
+        chips[pin.name] = request.chip;
+    }
+    return true;
+}
+
+void GpioLines::closePolledChips() noexcept
+{
+    for (const auto& request : polledRequests)
+    {
+        gpiod_chip_close(request.chip);
+    }
+    polledRequests.clear();
+}
+
+// If result is 'true' then 'lineMap' contains all the keys 'k' from
+// 'dbusPropMapChipObj' and the lines in the corresponding
+// values 'v' were obtained by calling 'gpiod_chip_get_line'. No line is
+// shared by two keys or present twice in one value (102).
 
 bool GpioLines::openGpioLines(
     const map<string, gpiod_chip_t*>& dbusPropMapChipObj,
-    const json& jsonConfig, int& lastErrno) noexcept
+    const vector<GpioPinConfig>& pins, LineMap& lineMap,
+    int& lastErrno) noexcept
 {
-    // assert(dbusPropMapLineObj.empty()); // (1)
+    // assert(lineMap.empty()); // (1)
 
     // (gpio chip number, pin number) -> DBus property name
     map<pair<unsigned, unsigned>, string> gpioLineIds;
 
     bool allLinesOpenable = true;
-    for (auto it = jsonConfig.cbegin();
-         it != jsonConfig.cend() && allLinesOpenable; ++it)
+    for (auto it = pins.cbegin(); it != pins.cend() && allLinesOpenable; ++it)
     {
-        string pinName = it.key();
+        string pinName = it->name;
 
         if (!dbusPropMapChipObj.contains(pinName))
         {
-            allLinesOpenable = false;
+            // The chip is missing, see 'GpioChips::getMissingPins'
+            continue;
         }
         else // ! !dbusPropMapChipObj.contains(pinName)
         {
-            // assert(dbusPropMapChipObj.contains(pinName));
-            // ^ satisfied by 'openGpioChips'
             gpiod_chip_t* chip = dbusPropMapChipObj.at(pinName);
 
-            unsigned gpioChipNum =
-                it.value()[GpioJsonConfig::configKeyGpioChip];
-            unsigned pinNum = it.value()[GpioJsonConfig::configKeyGpioPin];
+            unsigned gpioChipNum = GpioJsonConfig::getChipNumber(*it);
+            vector<unsigned> pinNums = GpioJsonConfig::getPinNumbers(*it);
 
-            pair<unsigned, unsigned> p(gpioChipNum, pinNum);
-            if (!gpioLineIds.contains(p))
+            for (auto pinIt = pinNums.cbegin();
+                 pinIt != pinNums.cend() && allLinesOpenable; ++pinIt)
             {
-                // In general 'gpiod_chip_get_line' may or may not
-                // result in the allocation of memory. For the
-                // different 'chip' object, however, the memory is
-                // always allocated (source: lib source). So together
-                // with (101) this call will always return a new
-                // object which satisfies (102).
-#ifdef ENABLE_GSH_LOGS
+                unsigned pinNum = *pinIt;
+                pair<unsigned, unsigned> p(gpioChipNum, pinNum);
+                if (!gpioLineIds.contains(p))
                 {
-                    stringstream ss;
-                    string chipName = gpiod_chip_name(chip);
-                    ss << "Opening line <" << chipName << " " << pinNum << ">"
-                       << " (by '" << pinName << "')" << endl;
-                    logPinOperation<level::INFO>(ss.str().c_str(), pinName,
-                                                 chipName, pinNum);
-                }
+                    // In general 'gpiod_chip_get_line' may or may not
+                    // result in the allocation of memory. For the
+                    // different 'chip' object, however, the memory is
+                    // always allocated (source: lib source). So together
+                    // with (101) this call will always return a new
+                    // object which satisfies (102).
+#ifdef ENABLE_GSH_LOGS
+                    {
+                        stringstream ss;
+                        string chipName = gpiod_chip_name(chip);
+                        ss << "Opening line <" << chipName << " " << pinNum
+                           << ">" << " (by '" << pinName << "')" << endl;
+                        logPinOperation<level::INFO>(ss.str().c_str(), pinName,
+                                                     chipName, pinNum);
+                    }
 #endif
-                gpiod_line_t* line = gpiod_chip_get_line(chip, pinNum);
-                if (line != NULL)
-                {
-                    // assert(!dbusPropMapLineObj.contains(pinName));
-                    // ^ Satisfied by (1) and keys uniqueness in 'jsonConfig'
-                    dbusPropMapLineObj[pinName] = line;
-                    gpioLineIds[p] = pinName;
+                    gpiod_line_t* line = gpiod_chip_get_line(chip, pinNum);
+                    if (line != NULL)
+                    {
+                        // Lines of 'pinName' only, satisfied by (1) and names
+                        // uniqueness in 'pins'
+                        lineMap[pinName].push_back(line);
+                        gpioLineIds[p] = pinName;
+                    }
+                    else // ! line
+                    {
+                        lastErrno = errno;
+                        string chipName = gpiod_chip_name(chip);
+                        stringstream ss;
+                        ss << "gpiod_chip_get_line(\"" << chipName << "\", "
+                           << pinNum << ")";
+                        logLibgpioCallError(ss, (int)NULL, lastErrno, pinName,
+                                            chipName, pinNum);
+                        allLinesOpenable = false;
+                    }
                 }
-                else // ! line
+                else // ! !gpioLineIds.contains(p)
                 {
-                    lastErrno = errno;
-                    string chipName = gpiod_chip_name(chip);
                     stringstream ss;
-                    ss << "gpiod_chip_get_line(\"" << chipName << "\", "
-                       << pinNum << ")";
-                    logLibgpioCallError(ss, (int)NULL, lastErrno, pinName,
-                                        chipName, pinNum);
+                    string chipName = gpiod_chip_name(chip);
+                    ss << "Pin number " << pinNum << " on the gpio chip '"
+                       << chipName << "' associated with the DBus property '"
+                       << pinName
+                       << "' has already been associated with the property '"
+                       << gpioLineIds[p] << "'";
+                    log<level::ERR>(ss.str().c_str(), pinNameEntry(pinName),
+                                    chipEntry(chipName), pinNumEntry(pinNum));
                     allLinesOpenable = false;
                 }
             }
-            else // ! !gpioLineIds.contains(p)
-            {
-                stringstream ss;
-                string chipName = gpiod_chip_name(chip);
-                ss << "Pin number " << pinNum << " on the gpio chip '"
-                   << chipName << "' associated with the DBus property '"
-                   << pinName
-                   << "' has already been associated with the property '"
-                   << gpioLineIds[p] << "'";
-                log<level::ERR>(ss.str().c_str(), pinNameEntry(pinName),
-                                chipEntry(chipName), pinNumEntry(pinNum));
-                allLinesOpenable = false;
-            }
         }
     }
     if (!allLinesOpenable)
     {
-        closeGpioLines();
+        closeGpioLines(lineMap);
     }
     return allLinesOpenable;
 }
 
-void GpioLines::closeGpioLines() noexcept
+void GpioLines::closeGpioLines(LineMap& lineMap) noexcept
 {
-    for (auto it = dbusPropMapLineObj.cbegin(); it != dbusPropMapLineObj.cend();
-         ++it)
+    for (auto it = lineMap.cbegin(); it != lineMap.cend(); ++it)
     {
 #ifdef ENABLE_GSH_LOGS
         {
@@ -155,48 +278,108 @@ void GpioLines::closeGpioLines() noexcept
             logPinOperation<level::INFO>(ss.str().c_str(), it->first);
         }
 #endif
-        gpiod_line_release(it->second);
+        for (gpiod_line_t* line : it->second)
+        {
+            gpiod_line_release(line);
+        }
     }
-    dbusPropMapLineObj.clear();
+    lineMap.clear();
 }
 
-// If result is 'false' then at least one line among the values of
-// 'dbusPropMapLineObj' could not be requested because it was requested by
-// another process.
-// If result is 'true' then for every value 'v' in 'dbusPropMapLineObj' the
-// 'gpiod_line_is_requested(v)' is also true, and 'v' can be used in
-// 'gpiod_line_*' methods in this process.
+// If result is 'false' then at least one line among the values of 'lineMap'
+// could not be requested because it was requested by another process.
+// If result is 'true' then for every line 'l' in the values of 'lineMap' the
+// 'gpiod_line_is_requested(l)' is also true, and 'l' can be used in
+// 'gpiod_line_*' methods in this process. The lines of a value can be used in
+// 'gpiod_line_*_bulk' methods together. The lines of the "output" entries of
+// 'pins' are requested as outputs, those of the "poll" entries not in any of
+// the 'polledRequests' as inputs, all the other ones for both edges events
+// except the ones in the 'polledRequests'.
 
-bool GpioLines::requestBothEdgesEvents(int& lastErrno) noexcept
+bool GpioLines::requestLines(const LineMap& lineMap,
+                             const vector<GpioPinConfig>& pins,
+                             const vector<PolledRequest>& polledRequests,
+                             int& lastErrno) noexcept
 {
-    // assert(dbusPropMapLineObj is bijective) - satisfied by (102)
+    // assert(lineMap is bijective) - satisfied by (102)
     bool allLinesRequestable = true;
-    for (auto it = dbusPropMapLineObj.cbegin();
-         it != dbusPropMapLineObj.cend() && allLinesRequestable; ++it)
+    for (auto pinIt = pins.cbegin();
+         pinIt != pins.cend() && allLinesRequestable; ++pinIt)
     {
+        auto it = lineMap.find(pinIt->name);
+        if (it == lineMap.end())
+        {
+            // The chip is missing, see 'GpioChips::getMissingPins'
+            continue;
+        }
         string pinName = it->first;
-        gpiod_line_t* line = it->second;
+        if (any_of(polledRequests.begin(), polledRequests.end(),
+                   [&pinName](const auto& request) {
+                       return find(request.pinNames.begin(),
+                                   request.pinNames.end(),
+                                   pinName) != request.pinNames.end();
+                   }))
+        {
+            // Requested by 'requestPolledLines'
+            continue;
+        }
+        const vector<gpiod_line_t*>& lines = it->second;
+        // The first line of a bus stands for the whole bus in the logs
+        gpiod_line_t* line = lines.front();
 #ifdef ENABLE_GSH_LOGS
         {
             stringstream ss;
             int pinNum = gpiod_line_offset(line);
             string chipName = gpiod_chip_name(gpiod_line_get_chip(line));
-            ss << "Requesting line <" << chipName << " " << pinNum
-               << "> using name '" << pinName << "'";
+            ss << "Requesting " << lines.size() << " line(s) <" << chipName
+               << " " << pinNum << "...> using name '" << pinName << "'";
             logPinOperation<level::INFO>(ss.str().c_str(), pinName, chipName,
                                          pinNum);
         }
 #endif
-        int requestResult =
-            gpiod_line_request_both_edges_events(line, pinName.c_str());
+        int requestResult;
+        const char* funcName;
+        if (GpioJsonConfig::isOutputEntry(*pinIt))
+        {
+            // Always a single pin, driven to its initial level
+            funcName = "gpiod_line_request_output";
+            requestResult = gpiod_line_request_output(
+                line, pinName.c_str(),
+                GpioJsonConfig::getInitialValue(*pinIt) != 0);
+        }
+        else if (GpioJsonConfig::isPolledEntry(*pinIt))
+        {
+            // A polled pin attached late, the requests of its chip are not
+            // shared with it
+            funcName = "gpiod_line_request_input";
+            requestResult = gpiod_line_request_input(line, pinName.c_str());
+        }
+        else if (lines.size() == 1)
+        {
+            funcName = "gpiod_line_request_both_edges_events";
+            requestResult =
+                gpiod_line_request_both_edges_events(line, pinName.c_str());
+        }
+        else
+        {
+            funcName = "gpiod_line_request_bulk_both_edges_events";
+            struct gpiod_line_bulk bulk;
+            gpiod_line_bulk_init(&bulk);
+            for (gpiod_line_t* busLine : lines)
+            {
+                gpiod_line_bulk_add(&bulk, busLine);
+            }
+            requestResult = gpiod_line_request_bulk_both_edges_events(
+                &bulk, pinName.c_str());
+        }
         if (requestResult != 0)
         {
             lastErrno = errno;
             stringstream ss;
             int pinNum = gpiod_line_offset(line);
             string chipName = gpiod_chip_name(gpiod_line_get_chip(line));
-            ss << "gpiod_line_request_both_edges_events(<" << chipName << " "
-               << pinNum << ">, \"" << pinName << "\")";
+            ss << funcName << "(<" << chipName << " " << pinNum << ">, \""
+               << pinName << "\")";
             logLibgpioCallError(ss, requestResult, lastErrno, pinName, chipName,
                                 pinNum);
             allLinesRequestable = false;
@@ -205,4 +388,53 @@ bool GpioLines::requestBothEdgesEvents(int& lastErrno) noexcept
     return allLinesRequestable;
 }
 
+// If result is 'true' then the lines of every request of 'polledRequests' are
+// requested together as inputs, so they can be read by a single
+// 'gpiod_line_get_value_bulk' call in the request order.
+
+bool GpioLines::requestPolledLines(const LineMap& lineMap,
+                                   const vector<PolledRequest>& polledRequests,
+                                   int& lastErrno) noexcept
+{
+    for (const auto& request : polledRequests)
+    {
+        struct gpiod_line_bulk bulk;
+        gpiod_line_bulk_init(&bulk);
+        for (const auto& pinName : request.pinNames)
+        {
+            gpiod_line_bulk_add(&bulk, lineMap.at(pinName).front());
+        }
+        // The first line stands for the whole request in the logs
+        const string& pinName = request.pinNames.front();
+        gpiod_line_t* line = lineMap.at(pinName).front();
+#ifdef ENABLE_GSH_LOGS
+        {
+            stringstream ss;
+            int pinNum = gpiod_line_offset(line);
+            string chipName = gpiod_chip_name(gpiod_line_get_chip(line));
+            ss << "Requesting " << request.pinNames.size()
+               << " polled line(s) <" << chipName << " " << pinNum
+               << "...> together";
+            logPinOperation<level::INFO>(ss.str().c_str(), pinName, chipName,
+                                         pinNum);
+        }
+#endif
+        int requestResult =
+            gpiod_line_request_bulk_input(&bulk, polledLinesConsumer);
+        if (requestResult != 0)
+        {
+            lastErrno = errno;
+            stringstream ss;
+            int pinNum = gpiod_line_offset(line);
+            string chipName = gpiod_chip_name(gpiod_line_get_chip(line));
+            ss << "gpiod_line_request_bulk_input(<" << chipName << " "
+               << pinNum << "...>, \"" << polledLinesConsumer << "\")";
+            logLibgpioCallError(ss, requestResult, lastErrno, pinName,
+                                chipName, pinNum);
+            return false;
+        }
+    }
+    return true;
+}
+
 } // namespace gpio_handler
@@ -8,6 +8,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 namespace gpio_handler
 {
@@ -18,15 +19,26 @@ class GpioLines
   public:
     /**
      * @brief Open all the gpio lines listed under @ref
-     * GpioJsonConfig::configKeyGpioPin property ("gpio_pin") in the @jsonConfig
-     * configuration.
+     * GpioJsonConfig::configKeyGpioPin property ("gpio_pin") or @ref
+     * GpioJsonConfig::configKeyGpioPins property ("gpio_pins") in the
+     * @jsonConfig configuration.
      *
      * By 'opened' it's meant that both @gpiod_chip_get_line and
      * @gpiod_line_request_both_edges_events function calls from gpiod library
      * succeeded. The pin name needed for @gpiod_line_request_both_edges_events
      * is taken from the top-level attribute name of the @jsonConfig object. The
      * same name is used to obtain the corresponding gpio device handler from
-     * @gpioChips.
+     * @gpioChips. The lines of a bus are requested together by a single
+     * @gpiod_line_request_bulk_both_edges_events call. The lines of the
+     * "output" entries are requested by @gpiod_line_request_output instead,
+     * driven to their initial level (see @ref GpioJsonConfig::isOutputEntry).
+     * The lines of the "poll" entries of a chip are requested together as
+     * inputs by a single @gpiod_line_request_bulk_input call on a chip handle
+     * of their own, so that a single bulk read reads them all, see @ref
+     * getPolledRequests. The pins whose chip is missing from @gpioChips (see
+     * @ref
+     * GpioChips::getMissingPins) are left out, to be attached later by @ref
+     * attachPin.
      *
      * Throw @ref std::system_error if not all lines requested in @jsonConfig
      * could be opened. Strong exception guarantee (the state of the program is
@@ -41,18 +53,68 @@ class GpioLines
     /**
      * @brief Get the mapping from pin names (root attributes in the @jsonConfig
      * passed to the constructor) to the opened gpio lines handlers represented
-     * by @gpiod_line_t structs from the gpiod library.
+     * by @gpiod_line_t structs from the gpiod library. A single pin maps to one
+     * line, a bus to its lines in the config order.
      */
-    const std::map<std::string, gpiod_line_t*>& getDbusPropMapLineObj() const;
+    const std::map<std::string, std::vector<gpiod_line_t*>>&
+        getDbusPropMapLineObj() const;
+
+    /**
+     * @brief Get the names of the polled pins sharing a line request, per
+     * request, in the request order. A request holds the polled pins of a
+     * single chip, at most @GPIOD_LINE_BULK_MAX_LINES of them.
+     */
+    std::vector<std::vector<std::string>> getPolledRequests() const;
+
+    /**
+     * @brief Open and request the lines of the @pin whose chip was just
+     * attached by @ref GpioChips::attachPin.
+     *
+     * A polled @pin gets a line request of its own, as input.
+     *
+     * @return True if done. False with @lastErrno set otherwise, nothing
+     * changed then.
+     */
+    bool attachPin(const GpioChips& gpioChips, const GpioPinConfig& pin,
+                   int& lastErrno) noexcept;
+
+    /** @brief Release the lines of the pin @pinName, before its chip is
+     * detached by @ref GpioChips::detachPin **/
+    void detachPin(const std::string& pinName) noexcept;
 
   private:
-    std::map<std::string, gpiod_line_t*> dbusPropMapLineObj;
+    using LineMap = std::map<std::string, std::vector<gpiod_line_t*>>;
+
+    /** @brief A line request shared by the polled pins of a chip **/
+    struct PolledRequest
+    {
+        /** @brief Opened for the request only, the lines of a bulk request
+         * must be of the same chip handle **/
+        gpiod_chip_t* chip;
+        /** @brief The pins not detached yet, in the request order **/
+        std::vector<std::string> pinNames;
+    };
+
+    LineMap dbusPropMapLineObj;
+    std::vector<PolledRequest> polledRequests;
 
-    bool openGpioLines(
+    static bool openGpioLines(
         const std::map<std::string, gpiod_chip_t*>& dbusPropMapChipObj,
-        const nlohmann::json& jsonConfig, int& lastErrno) noexcept;
-    void closeGpioLines() noexcept;
-    bool requestBothEdgesEvents(int& lastErrno) noexcept;
+        const std::vector<GpioPinConfig>& pins, LineMap& lineMap,
+        int& lastErrno) noexcept;
+    static void closeGpioLines(LineMap& lineMap) noexcept;
+    static bool requestLines(const LineMap& lineMap,
+                             const std::vector<GpioPinConfig>& pins,
+                             const std::vector<PolledRequest>& polledRequests,
+                             int& lastErrno) noexcept;
+    bool openPolledChips(const std::vector<GpioPinConfig>& pins,
+                         std::map<std::string, gpiod_chip_t*>& chips,
+                         int& lastErrno) noexcept;
+    static bool requestPolledLines(
+        const LineMap& lineMap,
+        const std::vector<PolledRequest>& polledRequests,
+        int& lastErrno) noexcept;
+    void closePolledChips() noexcept;
 };
 
 } // namespace gpio_handler
@@ -0,0 +1,135 @@
+#include <systemd/sd-daemon.h>
+
+#include <gpio_loop_monitor.hpp>
+#include <gpio_measurement.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <chrono>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Period of the probe timer [nanoseconds] **/
+static constexpr uint64_t probePeriodNs = 100000000;
+
+LoopHeartbeat::LoopHeartbeat(string name, LagStats& lagStats) :
+    name(std::move(name)), lagStats(lagStats)
+{}
+
+void LoopHeartbeat::waiting(uint64_t timeoutNs) noexcept
+{
+    dueNs.store(timeoutNs == noTimeout ? noTimeout
+                                       : EdgeMeter::nowNs() + timeoutNs,
+                memory_order_relaxed);
+}
+
+void LoopHeartbeat::woke() noexcept
+{
+    uint64_t nowNs = EdgeMeter::nowNs();
+    uint64_t due = dueNs.load(memory_order_relaxed);
+    // Only a wait which timed out tells how late the loop was scheduled
+    if (due != noTimeout && nowNs >= due)
+    {
+        lagStats.add(nowNs - due);
+    }
+    dueNs.store(nowNs, memory_order_relaxed);
+}
+
+void LoopHeartbeat::stopped() noexcept
+{
+    dueNs.store(0, memory_order_relaxed);
+}
+
+GpioLoopMonitor::GpioLoopMonitor(boost::asio::io_context& io,
+                                 GlobalStats& globalStats,
+                                 uint64_t stallThresholdNs) :
+    globalStats(globalStats),
+    stallThresholdNs(stallThresholdNs), probeTimer(io)
+{}
+
+LoopHeartbeat& GpioLoopMonitor::addLoop(const string& name)
+{
+    return heartbeats.emplace_back(name, globalStats.monitorLoopLag);
+}
+
+void GpioLoopMonitor::start()
+{
+    uint64_t watchdogUs = 0;
+    if (sd_watchdog_enabled(0, &watchdogUs) > 0)
+    {
+        // Twice per period, as recommended by sd_watchdog_enabled(3)
+        watchdogPingNs = watchdogUs * 1000 / 2;
+        log<level::INFO>("Pinging the systemd watchdog",
+                         entry("WATCHDOG_USEC=%llu",
+                               (unsigned long long)watchdogUs));
+        sd_notify(0, "WATCHDOG=1");
+        lastPingNs = EdgeMeter::nowNs();
+    }
+    scheduleProbe();
+}
+
+void GpioLoopMonitor::scheduleProbe()
+{
+    probeDueNs = EdgeMeter::nowNs() + probePeriodNs;
+    probeTimer.expires_after(chrono::nanoseconds(probePeriodNs));
+    probeTimer.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec)
+        {
+            probe();
+            scheduleProbe();
+        }
+    });
+}
+
+// Runs on the DBus server thread
+void GpioLoopMonitor::probe() noexcept
+{
+    uint64_t nowNs = EdgeMeter::nowNs();
+    uint64_t lagNs = nowNs > probeDueNs ? nowNs - probeDueNs : 0;
+    globalStats.dbusLoopLag.add(lagNs);
+    if (lagNs > stallThresholdNs)
+    {
+        globalStats.loopStalls.inc();
+        log<level::WARNING>("DBus server loop stalled",
+                            entry("STALL_MS=%llu",
+                                  (unsigned long long)(lagNs / 1000000)));
+    }
+
+    bool healthy = true;
+    for (auto& heartbeat : heartbeats)
+    {
+        uint64_t dueNs = heartbeat.dueNs.load(memory_order_relaxed);
+        bool stalled = dueNs != 0 && dueNs != LoopHeartbeat::noTimeout &&
+                       nowNs > dueNs && nowNs - dueNs > stallThresholdNs;
+        if (stalled && !heartbeat.stalled)
+        {
+            globalStats.loopStalls.inc();
+            log<level::WARNING>("Gpio monitoring loop stalled",
+                                entry("LOOP=%s", heartbeat.name.c_str()),
+                                entry("STALL_MS=%llu",
+                                      (unsigned long long)((nowNs - dueNs) /
+                                                           1000000)));
+        }
+        else if (!stalled && heartbeat.stalled)
+        {
+            log<level::INFO>("Gpio monitoring loop recovered",
+                             entry("LOOP=%s", heartbeat.name.c_str()));
+        }
+        heartbeat.stalled = stalled;
+        healthy = healthy && !stalled;
+    }
+
+    if (watchdogPingNs != 0 && healthy && nowNs - lastPingNs >= watchdogPingNs)
+    {
+        sd_notify(0, "WATCHDOG=1");
+        lastPingNs = nowNs;
+    }
+}
+
+} // namespace gpio_handler
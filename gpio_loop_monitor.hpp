@@ -0,0 +1,116 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <gpio_stats.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Liveness and lateness of a loop waiting with a timeout, updated by
+ * the thread running the loop and watched by the @ref GpioLoopMonitor
+ *
+ * The loop is expected back from its wait by the timeout, and back in the
+ * wait within the stall threshold after returning. The lateness of the waits
+ * which timed out is counted in the @ref LagStats passed to the constructor.
+ */
+class LoopHeartbeat
+{
+  public:
+    /** @brief Timeout of a wait without one **/
+    static constexpr uint64_t noTimeout = UINT64_MAX;
+
+    LoopHeartbeat(std::string name, LagStats& lagStats);
+
+    LoopHeartbeat(const LoopHeartbeat&) = delete;
+    LoopHeartbeat& operator=(const LoopHeartbeat&) = delete;
+
+    /** @brief The loop is about to wait for up to @timeoutNs **/
+    void waiting(uint64_t timeoutNs) noexcept;
+
+    /** @brief The loop returned from its wait **/
+    void woke() noexcept;
+
+    /** @brief The loop ended, it's not watched until it waits again **/
+    void stopped() noexcept;
+
+  private:
+    friend class GpioLoopMonitor;
+
+    std::string name;
+    LagStats& lagStats;
+    /** @brief When the loop is due back from its wait or in it, on the clock
+     * of @ref EdgeMeter::nowNs, @ref noTimeout if waiting without a timeout,
+     * 0 if not running **/
+    std::atomic<uint64_t> dueNs{0};
+    /** @brief True if the stall was reported, used by the DBus server thread
+     * only **/
+    bool stalled = false;
+};
+
+/**
+ * @brief Measures the scheduling lag of the DBus server loop and of the gpio
+ * monitoring loops, and reports their stalls
+ *
+ * A probe timer fires periodically on the DBus server thread (the one running
+ * the @io context), and how late it fired is counted in @ref
+ * GlobalStats::dbusLoopLag. The monitoring loops report their waits through
+ * their @ref LoopHeartbeat, and the lateness of their timed out waits is
+ * counted in @ref GlobalStats::monitorLoopLag. The probe checks the
+ * heartbeats as well: a loop not back by the stall threshold, stuck in a
+ * slow DBus call or behind a blocked mutex, is logged once as stalled and
+ * counted in @ref GlobalStats::loopStalls.
+ *
+ * When the service runs under the systemd watchdog (see 'WatchdogSec' in
+ * systemd.service), the probe pings it as long as no monitoring loop is
+ * stalled. A wedged DBus server loop doesn't probe at all. Either way systemd
+ * restarts the service rather than letting it serve stale values.
+ */
+class GpioLoopMonitor
+{
+  public:
+    /**
+     * @brief Prepare the probe of the @io context, counting in @globalStats,
+     * and reporting the stalls longer than @stallThresholdNs.
+     */
+    GpioLoopMonitor(boost::asio::io_context& io, GlobalStats& globalStats,
+                    uint64_t stallThresholdNs);
+
+    GpioLoopMonitor(const GpioLoopMonitor&) = delete;
+    GpioLoopMonitor& operator=(const GpioLoopMonitor&) = delete;
+
+    /**
+     * @brief Add the heartbeat of the monitoring loop @name, watched as soon
+     * as the loop waits. It lives as long as this object.
+     *
+     * To be called on the DBus server thread or before it runs.
+     */
+    LoopHeartbeat& addLoop(const std::string& name);
+
+    /** @brief Start probing, and pinging the systemd watchdog if enabled **/
+    void start();
+
+  private:
+    GlobalStats& globalStats;
+    uint64_t stallThresholdNs;
+    /** @brief Never reallocated, the loops keep references **/
+    std::deque<LoopHeartbeat> heartbeats;
+    boost::asio::steady_timer probeTimer;
+    /** @brief When the probe timer is due to fire [nanoseconds] **/
+    uint64_t probeDueNs = 0;
+    /** @brief Period of the watchdog pings, 0 if the watchdog is not enabled
+     * [nanoseconds] **/
+    uint64_t watchdogPingNs = 0;
+    uint64_t lastPingNs = 0;
+
+    void scheduleProbe();
+    void probe() noexcept;
+};
+
+} // namespace gpio_handler
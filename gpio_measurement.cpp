@@ -0,0 +1,102 @@
+#include <gpio_measurement.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+EdgeMeter::EdgeMeter(uint64_t windowNs) : windowNs(max((uint64_t)1, windowNs))
+{}
+
+uint64_t EdgeMeter::nowNs() noexcept
+{
+    // CLOCK_MONOTONIC on Linux
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void EdgeMeter::start(uint64_t timeNs, bool level) noexcept
+{
+    this->level = level;
+    startWindow(timeNs);
+}
+
+void EdgeMeter::onEdge(uint64_t timeNs, bool rising) noexcept
+{
+    if (windowEndNs == 0)
+    {
+        start(timeNs, !rising);
+    }
+    timeNs = max(timeNs, windowStartNs);
+    if (level)
+    {
+        highNs += timeNs - levelSinceNs;
+    }
+    level = rising;
+    levelSinceNs = timeNs;
+    ++edgeCount;
+    if (rising)
+    {
+        if (risingCount == 0)
+        {
+            firstRisingNs = timeNs;
+        }
+        lastRisingNs = timeNs;
+        ++risingCount;
+    }
+}
+
+bool EdgeMeter::closeWindow(uint64_t timeNs, PinMeasurement& closed) noexcept
+{
+    if (windowEndNs == 0 || timeNs < windowEndNs)
+    {
+        return false;
+    }
+    if (level)
+    {
+        highNs += windowEndNs - levelSinceNs;
+    }
+    closed.edgeCount = edgeCount;
+    if (risingCount >= 2 && lastRisingNs > firstRisingNs)
+    {
+        closed.frequencyMilliHz =
+            (risingCount - 1) * 1e12 / (lastRisingNs - firstRisingNs);
+    }
+    else
+    {
+        closed.frequencyMilliHz = risingCount * 1e12 / windowNs;
+    }
+    closed.dutyCyclePpm = highNs * 1e6 / windowNs;
+
+    // The windows between the closed one and @timeNs had no edges. Those
+    // following a window with edges are closed by the next call, those
+    // following one without have its result and are skipped.
+    uint64_t emptyWindows = 0;
+    if (edgeCount == 0)
+    {
+        emptyWindows = (timeNs - windowEndNs) / windowNs;
+    }
+    startWindow(windowEndNs + emptyWindows * windowNs);
+    return true;
+}
+
+uint64_t EdgeMeter::getWindowEndNs() const noexcept
+{
+    return windowEndNs;
+}
+
+void EdgeMeter::startWindow(uint64_t startNs) noexcept
+{
+    windowStartNs = startNs;
+    windowEndNs = startNs + windowNs;
+    levelSinceNs = startNs;
+    highNs = 0;
+    edgeCount = 0;
+    risingCount = 0;
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gpio_handler
+{
+
+/** @brief Aggregates of the edges of a pin over one measurement window **/
+struct PinMeasurement
+{
+    /** @brief Number of edges, rising and falling **/
+    uint64_t edgeCount = 0;
+    /** @brief Frequency of the rising edges [millihertz] **/
+    uint64_t frequencyMilliHz = 0;
+    /** @brief Fraction of the window the pin was high [parts per million] **/
+    uint64_t dutyCyclePpm = 0;
+
+    bool operator==(const PinMeasurement&) const = default;
+};
+
+/**
+ * @brief Measurement of the edge count, frequency and duty cycle of a pin over
+ * consecutive, non-overlapping windows of fixed length
+ *
+ * The edges are accounted with their kernel timestamps, so the results don't
+ * depend on when the monitoring thread got to read them. The kernel stamps the
+ * line events with CLOCK_MONOTONIC (since Linux 5.7), the clock of @ref nowNs.
+ *
+ * The frequency is measured between the first and the last rising edge of the
+ * window, or estimated from the window length if it has fewer than two. The
+ * duty cycle is the time spent high, including the parts before the first and
+ * after the last edge, over the window length.
+ *
+ * Accounting an edge is O(1) and allocates nothing. A window is closed by the
+ * @ref closeWindow call at or after its end, one window per call, so that the
+ * result of every window is reported. The windows without edges following a
+ * closed one are identical, so they are closed and reported at once. The
+ * class is not thread-safe.
+ */
+class EdgeMeter
+{
+  public:
+    /** @brief Measure over the windows of @windowNs nanoseconds **/
+    explicit EdgeMeter(uint64_t windowNs);
+
+    /** @brief The current time on the clock of the line event timestamps
+     * [nanoseconds] **/
+    static uint64_t nowNs() noexcept;
+
+    /** @brief Start the first window at @timeNs with the pin at @level **/
+    void start(uint64_t timeNs, bool level) noexcept;
+
+    /**
+     * @brief Account the edge at @timeNs, @rising or falling.
+     *
+     * The windows ended by @timeNs must have been closed by @ref closeWindow
+     * first. If the meter was not started, the first window starts at the
+     * edge. An edge older than the current window (read after the window was
+     * closed) is accounted at the window start.
+     */
+    void onEdge(uint64_t timeNs, bool rising) noexcept;
+
+    /**
+     * @brief Close the oldest window ended by @timeNs, if any. A window
+     * without edges is closed together with all the following ones ended by
+     * @timeNs, which had no edges either.
+     *
+     * Called until it returns false, it closes all the windows ended by
+     * @timeNs: at most one with edges and then the run of those without.
+     *
+     * @return True if a window was closed, with its result in @closed.
+     */
+    bool closeWindow(uint64_t timeNs, PinMeasurement& closed) noexcept;
+
+    /** @brief End of the current window, 0 if not started [nanoseconds] **/
+    uint64_t getWindowEndNs() const noexcept;
+
+  private:
+    uint64_t windowNs;
+    uint64_t windowStartNs = 0;
+    uint64_t windowEndNs = 0;
+    bool level = false;
+    /** @brief Time of the last edge, or the window start if later **/
+    uint64_t levelSinceNs = 0;
+    uint64_t highNs = 0;
+    uint64_t edgeCount = 0;
+    uint64_t risingCount = 0;
+    uint64_t firstRisingNs = 0;
+    uint64_t lastRisingNs = 0;
+
+    void startWindow(uint64_t startNs) noexcept;
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,162 @@
+#include <gpio_measurement.hpp>
+#include <gpio_outputs.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/exception.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+GpioOutputs::GpioOutputs(const GpioJsonConfig& gpioConfig)
+{
+    uint16_t pinIndex = 0;
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        if (GpioJsonConfig::isOutputEntry(pin))
+        {
+            outputIndices[pin.name] = pinIndex;
+        }
+        initialValues.push_back(GpioJsonConfig::getInitialValue(pin));
+        ++pinIndex;
+    }
+}
+
+bool GpioOutputs::hasOutputs(const GpioJsonConfig& gpioConfig)
+{
+    return any_of(gpioConfig.getPins().begin(), gpioConfig.getPins().end(),
+                  [](const auto& pin) {
+                      return GpioJsonConfig::isOutputEntry(pin);
+                  });
+}
+
+void GpioOutputs::serve(GpioPublisher& publisher, vector<MonitoredPin>& pins)
+{
+    this->publisher = &publisher;
+    this->pins = &pins;
+}
+
+void GpioOutputs::onAttached(MonitoredPin& pin) noexcept
+{
+    // Requested again by 'GpioLines::attachPin' at the initial level
+    if (publisher != nullptr)
+    {
+        publisher->publish(pin, initialValues[pin.pinIndex],
+                           EdgeMeter::nowNs());
+    }
+}
+
+// Runs on the DBus server thread
+void GpioOutputs::setPins(const map<string, bool>& levels)
+{
+    // Everything is checked before anything is written
+    if (levels.size() > GPIOD_LINE_BULK_MAX_LINES)
+    {
+        log<level::WARNING>("Refused to set more output pins at once than a "
+                            "bulk write takes",
+                            entry("PINS=%zu", levels.size()));
+        throw sdbusplus::exception::SdBusError(EINVAL,
+                                               "Too many output pins");
+    }
+    vector<MonitoredPin*> outputs;
+    for (const auto& [pinName, high] : levels)
+    {
+        auto it = outputIndices.find(pinName);
+        if (it == outputIndices.end() || pins == nullptr)
+        {
+            logPinOperation<level::WARNING>(
+                "Refused to set a pin which is not an output of the service",
+                pinName);
+            throw sdbusplus::exception::SdBusError(
+                EINVAL, "Not an output pin of the service");
+        }
+        MonitoredPin& pin = (*pins)[it->second];
+        if (pin.lines.empty())
+        {
+            logPinOperation<level::WARNING>(
+                "Refused to set an output pin whose gpio chip is missing",
+                pin.pinName, pin.chipName, pin.pinNum);
+            throw sdbusplus::exception::SdBusError(ENODEV,
+                                                   "Output pin unavailable");
+        }
+        if (!outputs.empty() && pin.chipName != outputs.front()->chipName)
+        {
+            logPinOperation<level::WARNING>(
+                "Refused to set the output pins of different gpio chips "
+                "together",
+                pin.pinName, pin.chipName, pin.pinNum);
+            throw sdbusplus::exception::SdBusError(
+                EINVAL, "Output pins on different gpio chips");
+        }
+        outputs.push_back(&pin);
+    }
+    if (outputs.empty())
+    {
+        return;
+    }
+
+    struct gpiod_line_bulk bulk;
+    gpiod_line_bulk_init(&bulk);
+    int values[GPIOD_LINE_BULK_MAX_LINES];
+    unsigned count = 0;
+    for (const auto& [pinName, high] : levels)
+    {
+        gpiod_line_bulk_add(&bulk, outputs[count]->lines.front());
+        values[count++] = high ? 1 : 0;
+    }
+    // The lines of a chip, all requested by this process, are written by a
+    // single ioctl
+    int result = gpiod_line_set_value_bulk(&bulk, values);
+    uint64_t writtenNs = EdgeMeter::nowNs();
+    if (result != 0)
+    {
+        int lastErrno = errno;
+        const MonitoredPin& first = *outputs.front();
+        for (MonitoredPin* pin : outputs)
+        {
+            pin->stats->errors.inc();
+        }
+        stringstream funcall;
+        funcall << "gpiod_line_set_value_bulk(<" << first.chipName << " "
+                << first.pinNum << "...>, " << outputs.size() << " lines)";
+        logLibgpioCallError(funcall, result, lastErrno, first.pinName,
+                            first.chipName, first.pinNum);
+        throw sdbusplus::exception::SdBusError(lastErrno,
+                                               "Failed to set the output pins");
+    }
+#ifdef ENABLE_GSH_LOGS
+    {
+        stringstream ss;
+        ss << "Set " << outputs.size() << " output pin(s)";
+        log<level::INFO>(ss.str().c_str(),
+                         chipEntry(outputs.front()->chipName));
+    }
+#endif
+    for (auto i = 0u; i < outputs.size(); ++i)
+    {
+        publisher->publish(*outputs[i], values[i], writtenNs);
+    }
+}
+
+void GpioOutputs::createDbusInterface(sdbusplus::asio::object_server& server,
+                                      const string& objectPath,
+                                      const string& interfaceName)
+{
+    dbusInterface = server.add_interface(objectPath, interfaceName);
+    dbusInterface->register_method("SetPins",
+                                   [this](const map<string, bool>& levels) {
+                                       setPins(levels);
+                                   });
+    dbusInterface->initialize();
+}
+
+} // namespace gpio_handler
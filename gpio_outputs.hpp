@@ -0,0 +1,88 @@
+#pragma once
+
+#include <gpio_json_config.hpp>
+#include <gpio_publisher.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Drives the output pins of the config (see @ref
+ * GpioJsonConfig::isOutputEntry) on behalf of the DBus clients
+ *
+ * The services driving the reset, enable or mux lines set them through the
+ * 'SetPins' method rather than requesting the lines themselves. The levels of
+ * all the pins of one call are written by a single @gpiod_line_set_value_bulk
+ * call, so the related lines change together, and the call returns once they
+ * were written. Only the output pins of the service can be set, all on the
+ * same gpio chip, otherwise nothing is written.
+ *
+ * The level set is published as the pin property, like a monitored pin value
+ * (see @ref GpioPublisher::publish), running the actions of the transition.
+ * The output pins are owned by the DBus server thread (the one running the
+ * 'SetPins' method), no monitoring thread ever touches them.
+ */
+class GpioOutputs
+{
+  public:
+    /** @brief Prepare the output pins of @gpioConfig **/
+    explicit GpioOutputs(const GpioJsonConfig& gpioConfig);
+
+    GpioOutputs(const GpioOutputs&) = delete;
+    GpioOutputs& operator=(const GpioOutputs&) = delete;
+
+    /** @brief True if any pin of @gpioConfig is an output **/
+    static bool hasOutputs(const GpioJsonConfig& gpioConfig);
+
+    /**
+     * @brief Set the output pins among @pins, publishing their levels through
+     * the @publisher, both outliving this object.
+     *
+     * To be called before the DBus server thread runs. Until then no pin can
+     * be set.
+     */
+    void serve(GpioPublisher& publisher, std::vector<MonitoredPin>& pins);
+
+    /**
+     * @brief Publish the initial level the output @pin is driven to again,
+     * once its gpio chip reappeared (see @ref GpioHotplug).
+     *
+     * To be called on the DBus server thread.
+     */
+    void onAttached(MonitoredPin& pin) noexcept;
+
+    /**
+     * @brief Add the @interfaceName interface to the @objectPath object in
+     * @server with the 'SetPins' (a{sb}) method setting the output pins named
+     * by the keys to the levels of the values.
+     *
+     * The method fails with 'org.freedesktop.DBus.Error.InvalidArgs' if a pin
+     * is not an output of the service, the pins are on different gpio chips
+     * or there are more of them than a bulk write takes, with the error of
+     * ENODEV if the chip is missing and with the error of the errno of the
+     * failed write otherwise.
+     */
+    void createDbusInterface(sdbusplus::asio::object_server& server,
+                             const std::string& objectPath,
+                             const std::string& interfaceName);
+
+  private:
+    /** @brief Position of the output pins in the config, by their names **/
+    std::map<std::string, uint16_t> outputIndices;
+    /** @brief Indexed by the pin position in the config **/
+    std::vector<uint64_t> initialValues;
+    GpioPublisher* publisher = nullptr;
+    std::vector<MonitoredPin>* pins = nullptr;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+
+    void setPins(const std::map<std::string, bool>& levels);
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,179 @@
+#include <gpio_pin_groups.hpp>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <algorithm>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+GpioPinGroups::GpioPinGroups(const GpioJsonConfig& gpioConfig,
+                             GpioStats& gpioStats) :
+    gpioStats(gpioStats)
+{
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        Group* group = nullptr;
+        if (pin.pinGroup.has_value())
+        {
+            group = &groups[*pin.pinGroup];
+            group->pinNames.push_back(pin.name);
+        }
+        pinGroups.push_back(group);
+    }
+}
+
+bool GpioPinGroups::hasPinGroups(const GpioJsonConfig& gpioConfig)
+{
+    return any_of(gpioConfig.getPins().begin(), gpioConfig.getPins().end(),
+                  [](const auto& pin) { return pin.pinGroup.has_value(); });
+}
+
+void GpioPinGroups::gate(vector<MonitoredPin>& pins)
+{
+    for (auto& pin : pins)
+    {
+        Group* group = pinGroups[pin.pinIndex];
+        if (group != nullptr)
+        {
+            pin.group = &group->gate;
+            group->pins.push_back(&pin);
+        }
+    }
+}
+
+void GpioPinGroups::stop() noexcept
+{
+    for (auto& [name, group] : groups)
+    {
+        group.gate.close();
+    }
+}
+
+// Runs on the DBus server thread
+bool GpioPinGroups::setSuspended(const string& groupName, bool suspend)
+{
+    auto it = groups.find(groupName);
+    if (it == groups.end())
+    {
+        return false;
+    }
+    Group& group = it->second;
+    if (group.gate.isSuspended() == suspend)
+    {
+        return true;
+    }
+    // Listed as not monitored before the first pin stops, and as monitored
+    // once resumed, their fresh values follow
+    for (const auto& pinName : group.pinNames)
+    {
+        gpioStats.setPinSuspended(pinName, suspend);
+    }
+    if (!suspend)
+    {
+        readGroup(group);
+    }
+    group.gate.setSuspended(suspend);
+    log<level::INFO>(suspend ? "Pin group suspended" : "Pin group resumed",
+                     entry("PIN_GROUP=%s", groupName.c_str()));
+    if (dbusInterface)
+    {
+        dbusInterface->signal_property(groupName);
+    }
+    return true;
+}
+
+// Runs on the DBus server thread, like the hotplug changing the lines
+void GpioPinGroups::readGroup(Group& group) noexcept
+{
+    vector<bool> taken(group.pins.size(), false);
+    for (size_t first = 0; first < group.pins.size(); ++first)
+    {
+        if (taken[first])
+        {
+            continue;
+        }
+        // The pins of the chip of the first one not taken yet, as many as a
+        // bulk holds, the rest go to the next bulk
+        const string& chipName = group.pins[first]->chipName;
+        struct gpiod_line_bulk bulk;
+        gpiod_line_bulk_init(&bulk);
+        vector<MonitoredPin*> bulkPins;
+        for (size_t i = first; i < group.pins.size(); ++i)
+        {
+            MonitoredPin& pin = *group.pins[i];
+            if (taken[i] || pin.chipName != chipName)
+            {
+                continue;
+            }
+            if (pin.lines.empty())
+            {
+                // Removed by the hotplug, nothing to read
+                taken[i] = true;
+                group.gate.putReading(pin, 0, 0);
+                continue;
+            }
+            if (gpiod_line_bulk_num_lines(&bulk) + pin.lines.size() >
+                GPIOD_LINE_BULK_MAX_LINES)
+            {
+                continue;
+            }
+            for (gpiod_line_t* line : pin.lines)
+            {
+                gpiod_line_bulk_add(&bulk, line);
+            }
+            bulkPins.push_back(&pin);
+            taken[i] = true;
+        }
+        if (bulkPins.empty())
+        {
+            continue;
+        }
+        int values[GPIOD_LINE_BULK_MAX_LINES];
+        uint64_t readNs = EdgeMeter::nowNs();
+        // On a failure every pin is read by itself, which logs the error
+        bool readOk = gpiod_line_get_value_bulk(&bulk, values) == 0;
+        unsigned line = 0;
+        for (MonitoredPin* pin : bulkPins)
+        {
+            uint64_t value = 0;
+            for (auto bit = 0u; bit < pin->lines.size(); ++bit, ++line)
+            {
+                if (readOk && values[line] != 0)
+                {
+                    value |= 1ull << bit;
+                }
+            }
+            group.gate.putReading(*pin, value, readOk ? readNs : 0);
+        }
+    }
+}
+
+void GpioPinGroups::createDbusInterface(sdbusplus::asio::object_server& server,
+                                        const string& objectPath,
+                                        const string& interfaceName)
+{
+    dbusInterface = server.add_interface(objectPath, interfaceName);
+    for (const auto& [name, group] : groups)
+    {
+        const PinGroupGate* gate = &group.gate;
+        dbusInterface->register_property_r(
+            name, bool{}, sdbusplus::vtable::property_::emits_change,
+            [gate](const bool&) { return !gate->isSuspended(); });
+    }
+    dbusInterface->register_method("Suspend", [this](const string& groupName) {
+        return setSuspended(groupName, true);
+    });
+    dbusInterface->register_method("Resume", [this](const string& groupName) {
+        return setSuspended(groupName, false);
+    });
+    dbusInterface->initialize();
+}
+
+} // namespace gpio_handler
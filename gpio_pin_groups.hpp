@@ -0,0 +1,99 @@
+#pragma once
+
+#include <gpio_json_config.hpp>
+#include <gpio_publisher.hpp>
+#include <gpio_stats.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Suspends and resumes the monitoring of the pin groups (see the
+ * "pin_group" config key) on behalf of the DBus clients
+ *
+ * Many alert lines are meaningless while the host is off or a slot is empty.
+ * The monitoring of all the pins of a group is suspended by the 'Suspend'
+ * method, until the 'Resume' one. A group gated by a pin, like the host
+ * power good, is suspended and resumed by the 'call' actions of that pin's
+ * transitions (see @ref GpioActions).
+ *
+ * The lines of a suspended pin stay requested, but no thread waits for them:
+ * the pin causes no wakeup, neither for its edges nor for its polls. The
+ * suspension takes effect at the next wakeup of the pin, and the pin is
+ * listed in the 'SuspendedPins' statistics property (see @ref
+ * GpioStats::setPinSuspended) as not monitored. Its property keeps the value
+ * last published, valid only while the group's property is true. When the
+ * group is resumed, the pins of the group are read afresh by a single bulk
+ * read per chip, then the edges queued by the kernel meanwhile are dropped
+ * and every pin is published before it's monitored again. A pin is read by
+ * itself only if that read failed or an edge came after it.
+ *
+ * The gates are owned by this object, the groups are changed by the DBus
+ * server thread (the one running the methods) only.
+ */
+class GpioPinGroups
+{
+  public:
+    /** @brief Prepare the pin groups of @gpioConfig, all resumed, marking
+     * their suspended pins in @gpioStats **/
+    GpioPinGroups(const GpioJsonConfig& gpioConfig, GpioStats& gpioStats);
+
+    GpioPinGroups(const GpioPinGroups&) = delete;
+    GpioPinGroups& operator=(const GpioPinGroups&) = delete;
+
+    /** @brief True if any pin of @gpioConfig belongs to a pin group **/
+    static bool hasPinGroups(const GpioJsonConfig& gpioConfig);
+
+    /**
+     * @brief Set the @ref MonitoredPin::group of every pin of a group among
+     * @pins created from the config passed to the constructor.
+     *
+     * To be called before any of the @pins is monitored.
+     */
+    void gate(std::vector<MonitoredPin>& pins);
+
+    /** @brief Let the monitoring threads waiting for a suspended group finish,
+     * once the service is stopping **/
+    void stop() noexcept;
+
+    /**
+     * @brief Add the @interfaceName interface to the @objectPath object in
+     * @server with a read-only property per group, named after it, true while
+     * the group is monitored, and the 'Suspend' (s) -> (b) and 'Resume' (s) ->
+     * (b) methods, returning false if the group doesn't exist.
+     */
+    void createDbusInterface(sdbusplus::asio::object_server& server,
+                             const std::string& objectPath,
+                             const std::string& interfaceName);
+
+  private:
+    struct Group
+    {
+        std::vector<std::string> pinNames;
+        PinGroupGate gate;
+        /** @brief Set by @ref gate **/
+        std::vector<MonitoredPin*> pins;
+    };
+
+    GpioStats& gpioStats;
+    /** @brief By the group names **/
+    std::map<std::string, Group> groups;
+    /** @brief Indexed by the pin position in the config, NULL if the pin is
+     * in no group **/
+    std::vector<Group*> pinGroups;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+
+    bool setSuspended(const std::string& groupName, bool suspend);
+
+    /** @brief Read the lines of the pins of @group with a bulk read per chip
+     * and keep the values in its gate, see @ref PinGroupGate::putReading **/
+    static void readGroup(Group& group) noexcept;
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,541 @@
+#include <gpio_alloc_count.hpp>
+#include <gpio_hotplug.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_pin_groups.hpp>
+#include <gpio_pin_threads.hpp>
+#include <gpio_status_handler.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Maximal number of edge events read from a measured line at once **/
+static constexpr unsigned maxMeasuredLineEvents = 16;
+
+volatile bool runThreads = false;
+/** @brief Set while the pins are served from the gpio hardware **/
+static GpioHotplug* hotplug = nullptr;
+
+void setPinThreadsHotplug(GpioHotplug* pinHotplug) noexcept
+{
+    hotplug = pinHotplug;
+}
+
+/**
+ * @brief Hand the @pin whose thread is about to finish back to the @hotplug if
+ * its gpio chip was removed.
+ *
+ * @return True if handed back, the thread must not stop the service then.
+ */
+static bool releaseIfChipRemoved(MonitoredPin& pin)
+{
+    return hotplug != nullptr && hotplug->releaseIfChipRemoved(pin);
+}
+
+/**
+ * @brief Entry function for the gpio monitoring threads
+ *
+ * The dbus property update scheme is a mix of polling and event detection. So
+ * basically the change of the pin should result in an immediate change of the
+ * dbus property, but there is also periodic polling "just in case", specified
+ * per gpio line by the "read_period_sec", setting the lower bound for gpio
+ * refresh rate.
+ *
+ * To understand it better consider the following graph:
+ *
+ *
+ * Timeline
+ * GPIO line:
+ *                                  state change
+ * 1                                      --------------------------------------
+ *                                       /
+ * 0 ------------------------------------
+ *
+ * Loop iteratons                              timeout period
+ * (no longer than timeout):                      <----->
+ *   |-------|-------|-------|------|----|-------|-------|-------|------|-------
+ *
+ * Readings:
+ *   ^------------------------------^----^------------------------------^-------
+ *   0                              0    1                              1
+ *    <---------------------------->      <---------------------------->
+ *          polling period                        polling period
+ *
+ * DBus property:                   event detected
+ * t                                      --------------------------------------
+ *                                       /
+ * f ------------------------------------
+ *
+ *
+ * The correspondence to the parameters is as follows:
+ * "GPIO line" : @pin.lines, all the lines of a bus are waited for at once
+ * "state change" : detected in 'gpiod_line_event_wait_bulk' call inside this
+ * function.
+ * "timeout period" = @lineEventWaitTimeoutNs
+ * "polling period" = @pin.readPeriodNs, rounded to the "timeout period"
+ * "DBus property" : the @pin.pinName property published by @publisher
+ *
+ * Every edge read and every value obtained is passed to @publisher, which
+ * doesn't publish the readings equal to the value the property already has.
+ *
+ * While the pin's group is suspended (see @ref GpioPinGroups) the thread
+ * blocks without any wakeup. Once resumed, it drops the edges queued
+ * meanwhile and starts a new polling period with the group's fresh bulk
+ * reading of the pin, or its own if none is newer than those edges.
+ *
+ * The function can stop execution at discrete points spaced by "timeot period"
+ * or gpio pin state change (and only then) in case: 1. global @runThreads was
+ * set to false by different thread, 2. error occured when calling any of the
+ * functions 'gpiod_line_event_wait_bulk' or 'gpiod_line_get_value[_bulk]' from
+ * the gpiod library, 3. the @publisher failed to set the DBus property.
+ * Otherwise the
+ * function continue to run. No exceptions are ever thrown. An error caused by
+ * the removal of the gpio chip doesn't stop the service, the pin is handed
+ * back to the @ref GpioHotplug instead.
+ *
+ * @param[in,out] publisher
+ * @param[in,out] pin The monitored pin, owned by this thread.
+ */
+void syncAlertGpioPin(GpioPublisher& publisher, MonitoredPin& pin)
+{
+    struct timespec timeout
+    {
+        lineEventWaitTimeoutNs / 1000000000, lineEventWaitTimeoutNs % 1000000000
+    };
+
+    struct gpiod_line_event event;
+
+    struct gpiod_line_bulk lines;
+    gpiod_line_bulk_init(&lines);
+    for (gpiod_line_t* line : pin.lines)
+    {
+        gpiod_line_bulk_add(&lines, line);
+    }
+    struct gpiod_line_bulk eventLines;
+    const string& chipName = pin.chipName;
+    const string& pinName = pin.pinName;
+    unsigned pinNum = pin.pinNum;
+    PinStats& pinStats = *pin.stats;
+    GlobalStats& globalStats = publisher.getGlobalStats();
+    LoopHeartbeat& heartbeat = *pin.heartbeat;
+    // [nanoseconds / lineEventWaitTimeoutNs]
+    uint64_t readPeriodTicks =
+        max((uint64_t)1, pin.readPeriodNs / lineEventWaitTimeoutNs);
+
+    uint64_t ticks = 0;
+    bool setDBusPropOk = true;
+    bool lineGetOk = true;
+    uint64_t lineValue = 0;
+    // Set on resumption if the group's reading of the pin is the value
+    bool hasResumeValue = false;
+    bool hasLastLineValue = false;
+    uint64_t lastLineValue = 0;
+    // Kernel timestamp of the first edge of the last wait, 0 if none
+    uint64_t firstEdgeNs = 0;
+    int waitResult = 0;
+    // waitResult:
+    // -1: error
+    //  0: timeout
+    //  1: event
+    // From here on serving the pin must not allocate
+    SteadyStateScope steadyState;
+    while (runThreads && lineGetOk && setDBusPropOk && waitResult >= 0)
+    {
+        bool resumed = false;
+        if (pin.group != nullptr && pin.group->isSuspended())
+        {
+            // No wakeup until the group is resumed, the edges meanwhile are
+            // dropped and the pin is read afresh
+            heartbeat.waiting(LoopHeartbeat::noTimeout);
+            bool running = pin.group->waitResumed();
+            heartbeat.woke();
+            if (!running)
+            {
+                break;
+            }
+            uint64_t lastEdgeNs;
+            lineGetOk = dropLineEvents(pin, lastEdgeNs);
+            // The bulk read of the group stands for the pin's, unless stale
+            hasResumeValue =
+                lineGetOk && pin.group->takeReading(pin, lastEdgeNs, lineValue);
+            resumed = true;
+            firstEdgeNs = 0;
+        }
+        // in case of an event, full period round or resumption
+        if (lineGetOk && (waitResult > 0 || ticks == 0 || resumed))
+        {
+            // Start a new period, no matter if triggered by the
+            // last one or an event
+            ticks = 0;
+            bool isPoll = waitResult == 0 && !resumed;
+            // Errors logged by 'readPinValue'
+            uint64_t detectedNs =
+                firstEdgeNs != 0 ? firstEdgeNs : EdgeMeter::nowNs();
+            if (!hasResumeValue)
+            {
+                lineGetOk = readPinValue(pin, lineValue);
+            }
+            hasResumeValue = false;
+            if (lineGetOk)
+            {
+                if (isPoll)
+                {
+                    pinStats.polls.inc();
+                    if (hasLastLineValue && lineValue != lastLineValue)
+                    {
+                        pinStats.pollChanges.inc();
+                    }
+                }
+                hasLastLineValue = true;
+                lastLineValue = lineValue;
+                setDBusPropOk = publisher.publish(pin, lineValue, detectedNs);
+            }
+        }
+        if (lineGetOk && setDBusPropOk)
+        {
+            firstEdgeNs = 0;
+            heartbeat.waiting(lineEventWaitTimeoutNs);
+            waitResult =
+                gpiod_line_event_wait_bulk(&lines, &timeout, &eventLines);
+            heartbeat.woke();
+            globalStats.wakeups.inc();
+            if (waitResult > 0)
+            {
+                // Use it only to clear the event flags, the
+                // actual values of the pins will be obtained by
+                // 'readPinValue'
+                for (auto i = 0u; i < gpiod_line_bulk_num_lines(&eventLines);
+                     ++i)
+                {
+                    gpiod_line_t* line =
+                        gpiod_line_bulk_get_line(&eventLines, i);
+                    if (gpiod_line_event_read(line, &event) == 0)
+                    {
+                        auto bit = find(pin.lines.begin(), pin.lines.end(),
+                                        line) -
+                                   pin.lines.begin();
+                        publisher.onEdge(pin, bit, event);
+                        if (firstEdgeNs == 0)
+                        {
+                            firstEdgeNs = getEventTimeNs(event);
+                        }
+                    }
+                }
+            }
+            else if (waitResult < 0)
+            {
+                pinStats.errors.inc();
+                int lastErrno = errno;
+                stringstream funcall;
+                funcall << "gpiod_line_event_wait_bulk(<" << chipName << " "
+                        << pinNum << ">, " << lineEventWaitTimeoutNs << " ns)";
+                logLibgpioCallError(funcall, waitResult, lastErrno, pinName,
+                                    chipName, pinNum);
+            }
+            // otherwise timeout
+        }
+        // if condition not met the loop will end in next iteration
+        ticks = (ticks + 1) % readPeriodTicks;
+    }
+    heartbeat.stopped();
+    // If the loop exited for any other reason than globally stopped threads
+    // or a removed gpio chip then globally stop the threads.
+    if (runThreads && !releaseIfChipRemoved(pin))
+    {
+        stopService(1);
+    }
+}
+
+/**
+ * @brief Entry function for the threads monitoring the pins in the "measure"
+ * mode
+ *
+ * Feed the edges of the @pin line to its @ref MonitoredPin::meter and publish
+ * the measurement of every closed window through @publisher. The thread wakes
+ * up for the edges, at the window ends and at least every
+ * @lineEventWaitTimeoutNs to check @runThreads. The line value is read only
+ * once, to start the first window, the levels after that follow from the
+ * edge types.
+ *
+ * The function stops execution in the same cases as @ref syncAlertGpioPin.
+ * No exceptions are ever thrown.
+ *
+ * @param[in,out] publisher
+ * @param[in,out] pin The monitored pin, owned by this thread.
+ */
+void measureGpioPin(GpioPublisher& publisher, MonitoredPin& pin)
+{
+    gpiod_line_t* line = pin.lines.front();
+    EdgeMeter& meter = *pin.meter;
+    GlobalStats& globalStats = publisher.getGlobalStats();
+    struct gpiod_line_event events[maxMeasuredLineEvents];
+    PinMeasurement measurement;
+
+    uint64_t lineValue = 0;
+    // Errors logged by 'readPinValue'
+    bool ok = readPinValue(pin, lineValue);
+    if (ok)
+    {
+        meter.start(EdgeMeter::nowNs(), lineValue != 0);
+    }
+    SteadyStateScope steadyState;
+    while (runThreads && ok)
+    {
+        uint64_t nowNs = EdgeMeter::nowNs();
+        uint64_t waitNs = min(lineEventWaitTimeoutNs,
+                              meter.getWindowEndNs() > nowNs
+                                  ? meter.getWindowEndNs() - nowNs
+                                  : 0);
+        struct timespec timeout
+        {
+            (time_t)(waitNs / 1000000000), (long)(waitNs % 1000000000)
+        };
+        pin.heartbeat->waiting(waitNs);
+        int waitResult = gpiod_line_event_wait(line, &timeout);
+        pin.heartbeat->woke();
+        globalStats.wakeups.inc();
+        if (waitResult > 0)
+        {
+            int eventsRead = gpiod_line_event_read_multiple(
+                line, events, maxMeasuredLineEvents);
+            if (eventsRead < 0)
+            {
+                pin.stats->errors.inc();
+                int lastErrno = errno;
+                stringstream funcall;
+                funcall << "gpiod_line_event_read_multiple(<" << pin.chipName
+                        << " " << pin.pinNum << ">)";
+                logLibgpioCallError(funcall, eventsRead, lastErrno,
+                                    pin.pinName, pin.chipName, pin.pinNum);
+                ok = false;
+            }
+            for (int i = 0; i < eventsRead && ok; ++i)
+            {
+                publisher.onEdge(pin, 0, events[i]);
+                uint64_t edgeNs = getEventTimeNs(events[i]);
+                while (ok && meter.closeWindow(edgeNs, measurement))
+                {
+                    ok = publisher.publishMeasurement(pin, measurement,
+                                                      EdgeMeter::nowNs());
+                }
+                meter.onEdge(edgeNs, events[i].event_type ==
+                                         GPIOD_LINE_EVENT_RISING_EDGE);
+            }
+        }
+        else if (waitResult < 0)
+        {
+            pin.stats->errors.inc();
+            int lastErrno = errno;
+            stringstream funcall;
+            funcall << "gpiod_line_event_wait(<" << pin.chipName << " "
+                    << pin.pinNum << ">, " << waitNs << " ns)";
+            logLibgpioCallError(funcall, waitResult, lastErrno, pin.pinName,
+                                pin.chipName, pin.pinNum);
+            ok = false;
+        }
+        uint64_t closedNs = EdgeMeter::nowNs();
+        while (ok && meter.closeWindow(closedNs, measurement))
+        {
+            ok = publisher.publishMeasurement(pin, measurement, closedNs);
+        }
+    }
+    pin.heartbeat->stopped();
+    if (runThreads && !releaseIfChipRemoved(pin))
+    {
+        stopService(1);
+    }
+}
+
+/**
+ * @brief Entry function for the threads reading the pins in the "poll" mode
+ *
+ * Read the lines of all the pins of @polled, sharing a line request, by a
+ * single bulk read every @ref PolledLines::readPeriodNs, and publish every pin
+ * through @publisher. There are no edges to wait for, the thread sleeps until
+ * the next read, at most @lineEventWaitTimeoutNs to check @runThreads.
+ *
+ * The function stops execution in the same cases as @ref syncAlertGpioPin, an
+ * error caused by the removal of the gpio chip hands all the pins back to the
+ * @ref GpioHotplug. No exceptions are ever thrown.
+ *
+ * @param[in,out] publisher
+ * @param[in,out] polled The polled pins, owned by this thread.
+ */
+void pollGpioLines(GpioPublisher& publisher, PolledLines& polled)
+{
+    GlobalStats& globalStats = publisher.getGlobalStats();
+    uint64_t values[GPIOD_LINE_BULK_MAX_LINES];
+    bool hasLastValues = false;
+    uint64_t nextReadNs = 0;
+    bool ok = true;
+    SteadyStateScope steadyState;
+    while (runThreads && ok)
+    {
+        uint64_t nowNs = EdgeMeter::nowNs();
+        if (nowNs >= nextReadNs)
+        {
+            nextReadNs = nowNs + polled.readPeriodNs;
+            // Errors logged by 'readPolledLines'
+            ok = readPolledLines(polled, values);
+            for (auto i = 0u; i < polled.pins.size() && ok; ++i)
+            {
+                MonitoredPin& pin = *polled.pins[i];
+                pin.stats->polls.inc();
+                if (hasLastValues && values[i] != pin.publishedValue)
+                {
+                    pin.stats->pollChanges.inc();
+                }
+                ok = publisher.publish(pin, values[i], nowNs);
+            }
+            hasLastValues = true;
+            continue;
+        }
+        uint64_t waitNs = min(lineEventWaitTimeoutNs, nextReadNs - nowNs);
+        polled.heartbeat->waiting(waitNs);
+        this_thread::sleep_for(chrono::nanoseconds(waitNs));
+        polled.heartbeat->woke();
+        globalStats.wakeups.inc();
+    }
+    polled.heartbeat->stopped();
+    if (!runThreads)
+    {
+        return;
+    }
+    // All the pins are on the same chip, none is read any more
+    bool released = true;
+    for (MonitoredPin* pin : polled.pins)
+    {
+        released = releaseIfChipRemoved(*pin) && released;
+    }
+    if (!released)
+    {
+        stopService(1);
+    }
+}
+
+/**
+ * @brief Entry function for the threads reading a pin in the "poll" mode with
+ * a line request of its own, attached by the @ref GpioHotplug
+ *
+ * @param[in,out] publisher
+ * @param[in,out] pin The polled pin, owned by this thread.
+ */
+void pollGpioPin(GpioPublisher& publisher, MonitoredPin& pin)
+{
+    PolledLines polled{pin.chipName, {&pin}, pin.readPeriodNs, pin.heartbeat};
+    pollGpioLines(publisher, polled);
+}
+
+/**
+ * @brief Block until all the all threads in @threads finished execution
+ *
+ * After the function returns all threads in @threads are no longer joinable.
+ *
+ * @param[in,out] threads
+ */
+void finishThreads(vector<thread>& threads)
+{
+    for (auto i = 0u; i < threads.size(); ++i)
+    {
+#ifdef ENABLE_GSH_LOGS
+        {
+            stringstream ss;
+            ss << "Waiting for thread #" << i << endl;
+            log<level::INFO>(ss.str().c_str());
+        }
+#endif
+        threads[i].join();
+    }
+}
+
+/**
+ * Start a thread monitoring the gpio lines of the @pin. Append the @thread
+ * object at the end of the @threads.
+ *
+ * @param[out] threads
+ * @param[in,out] publisher
+ * @param[in,out] pin
+ */
+void startPinThread(vector<thread>& threads, GpioPublisher& publisher,
+                    MonitoredPin& pin)
+{
+#ifdef ENABLE_GSH_LOGS
+    {
+        stringstream ss;
+        ss << "Setting up thread for:" << endl;
+        ss << "  pin_name = " << pin.pinName << endl;
+        ss << "  " << GpioJsonConfig::configKeyGpioPin << " = " << pin.pinNum
+           << endl;
+        ss << "  " << GpioJsonConfig::configKeyGpioChip << " = "
+           << pin.chipName << endl;
+        ss << "  readPeriodNs = " << pin.readPeriodNs;
+        logPinOperation<level::INFO>(ss.str().c_str(), pin.pinName,
+                                     pin.chipName, pin.pinNum);
+    }
+#endif
+    threads.push_back(thread(pin.isPolled ? pollGpioPin
+                             : pin.meter  ? measureGpioPin
+                                          : syncAlertGpioPin,
+                             ref(publisher), ref(pin)));
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Thread started");
+#endif
+}
+
+/**
+ * Start a thread for each pin in @pins monitoring the associated gpio line,
+ * but a single one for all the polled pins sharing a line request (see @ref
+ * pollGpioLines). Append the @thread object at the end of the @threads. All
+ * threads in @threads are joinable. The pins without lines, whose gpio chip is
+ * missing, are left to the @ref GpioHotplug. The output pins are not
+ * monitored.
+ *
+ * @param[out] threads
+ * @param[in,out] publisher
+ * @param[in,out] pins
+ */
+void startThreads(vector<thread>& threads, GpioPublisher& publisher,
+                  vector<MonitoredPin>& pins)
+{
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Starting gpio pins monitoring threads");
+#endif
+    runThreads = true;
+    if (!pins.empty())
+    {
+        for (auto& pin : pins)
+        {
+            if (pin.lines.empty() || pin.isOutput)
+            {
+                continue;
+            }
+            if (pin.polledLines == nullptr)
+            {
+                startPinThread(threads, publisher, pin);
+            }
+            else if (pin.polledLines->pins.front() == &pin)
+            {
+                threads.push_back(thread(pollGpioLines, ref(publisher),
+                                         ref(*pin.polledLines)));
+            }
+        }
+    }
+    else // ! !pins.empty()
+    {
+        log<level::WARNING>("No gpio pins monitored");
+    }
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <gpio_publisher.hpp>
+
+#include <thread>
+#include <vector>
+
+namespace gpio_handler
+{
+
+class GpioHotplug;
+
+
+/**
+ * @brief Second argument to @gpiod_line_event_wait function
+ *
+ * Specifies also the maximal resolution of the
+ * @GpioJsonConfig::configKeyReadPeriod parameter given in the config file.
+ */
+constexpr uint64_t lineEventWaitTimeoutNs = 1e8l; // [nanoseconds]
+
+/** @brief Cleared to make the pin threads finish, see @ref startThreads **/
+extern volatile bool runThreads;
+
+/**
+ * @brief Let the pin threads whose gpio chip was removed hand their pins back
+ * to @hotplug, nullptr while the pins are not served from the gpio hardware.
+ */
+void setPinThreadsHotplug(GpioHotplug* hotplug) noexcept;
+
+/** @brief Thread per pin: serve the edges and the polls of @pin until
+ * @ref runThreads is cleared **/
+void syncAlertGpioPin(GpioPublisher& publisher, MonitoredPin& pin);
+
+/** @brief Thread per pin: measure the edges of @pin in the "measure" mode **/
+void measureGpioPin(GpioPublisher& publisher, MonitoredPin& pin);
+
+/** @brief Thread per line request: read the pins of @polled in the "poll"
+ * mode by bulk reads **/
+void pollGpioLines(GpioPublisher& publisher, PolledLines& polled);
+
+/** @brief Thread per pin: read @pin in the "poll" mode on its own **/
+void pollGpioPin(GpioPublisher& publisher, MonitoredPin& pin);
+
+/** @brief Join all the @threads **/
+void finishThreads(std::vector<std::thread>& threads);
+
+/** @brief Start the thread serving @pin, appended to the @threads **/
+void startPinThread(std::vector<std::thread>& threads,
+                    GpioPublisher& publisher, MonitoredPin& pin);
+
+/** @brief Set @ref runThreads and start the threads serving the @pins,
+ * appended to the @threads **/
+void startThreads(std::vector<std::thread>& threads, GpioPublisher& publisher,
+                  std::vector<MonitoredPin>& pins);
+
+} // namespace gpio_handler
@@ -0,0 +1,513 @@
+#include <unistd.h>
+
+#include <gpio_publisher.hpp>
+#include <gpio_status_dbus.hpp>
+#include <gpio_utils.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+using json = nlohmann::json;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+vector<MonitoredPin> createMonitoredPins(
+    const GpioJsonConfig& gpioConfig, GpioStats& gpioStats,
+    const map<string, vector<gpiod_line_t*>>& dbusPropMapLineObj)
+{
+    vector<MonitoredPin> pins;
+    uint16_t pinIndex = 0;
+    uint16_t propertyIndex = 0;
+    for (auto it = gpioConfig.getPins().cbegin();
+         it != gpioConfig.getPins().cend(); ++it, ++pinIndex)
+    {
+        auto lineIt = dbusPropMapLineObj.find(it->name);
+        vector<gpiod_line_t*> lines;
+        if (lineIt != dbusPropMapLineObj.end())
+        {
+            lines = lineIt->second;
+        }
+        auto properties = GpioJsonConfig::getProperties(*it);
+        uint16_t firstPropertyIndex = propertyIndex;
+        propertyIndex += properties.size();
+        pins.push_back(MonitoredPin{
+            it->name,
+            !lines.empty() ? gpiod_chip_name(gpiod_line_get_chip(lines[0]))
+                           : "gpiochip" +
+                                 to_string(GpioJsonConfig::getChipNumber(*it)),
+            GpioJsonConfig::getPinNumbers(*it).front(), pinIndex,
+            std::move(properties), firstPropertyIndex,
+            GpioJsonConfig::isBusEntry(*it),
+            GpioJsonConfig::isOutputEntry(*it),
+            GpioJsonConfig::isPolledEntry(*it),
+            GpioJsonConfig::getPriority(*it), lines,
+            max((uint64_t)1, (uint64_t)(it->readPeriodSec * 1e9)),
+            &gpioStats.getPinStats(it->name),
+            GpioJsonConfig::getInitialValue(*it), nullopt, PinMeasurement{},
+            nullptr});
+        if (GpioJsonConfig::isMeasuredEntry(*it))
+        {
+            pins.back().meter.emplace(GpioJsonConfig::getWindowNs(*it));
+        }
+    }
+    return pins;
+}
+
+vector<PolledLines>
+    createPolledLines(vector<MonitoredPin>& pins,
+                      const vector<vector<string>>& polledRequests)
+{
+    map<string, MonitoredPin*> pinsByName;
+    for (auto& pin : pins)
+    {
+        pinsByName[pin.pinName] = &pin;
+    }
+    vector<PolledLines> polledLines;
+    for (const auto& pinNames : polledRequests)
+    {
+        PolledLines polled{pinsByName.at(pinNames.front())->chipName, {},
+                           UINT64_MAX};
+        for (const auto& pinName : pinNames)
+        {
+            MonitoredPin* pin = pinsByName.at(pinName);
+            polled.pins.push_back(pin);
+            polled.readPeriodNs = min(polled.readPeriodNs, pin->readPeriodNs);
+        }
+        polledLines.push_back(move(polled));
+    }
+    // Once none of them moves any more
+    for (auto& polled : polledLines)
+    {
+        for (MonitoredPin* pin : polled.pins)
+        {
+            pin->polledLines = &polled;
+        }
+    }
+    return polledLines;
+}
+
+uint64_t getEventTimeNs(const struct gpiod_line_event& event) noexcept
+{
+    return event.ts.tv_sec * 1000000000ull + event.ts.tv_nsec;
+}
+
+bool readPinValue(const MonitoredPin& pin, uint64_t& value) noexcept
+{
+    int result;
+    const char* funcName;
+    if (!pin.isBus)
+    {
+        funcName = "gpiod_line_get_value";
+        result = gpiod_line_get_value(pin.lines.front());
+        value = result > 0 ? 1 : 0;
+    }
+    else
+    {
+        funcName = "gpiod_line_get_value_bulk";
+        struct gpiod_line_bulk bulk;
+        gpiod_line_bulk_init(&bulk);
+        for (gpiod_line_t* line : pin.lines)
+        {
+            gpiod_line_bulk_add(&bulk, line);
+        }
+        int values[GPIOD_LINE_BULK_MAX_LINES];
+        result = gpiod_line_get_value_bulk(&bulk, values);
+        value = 0;
+        for (auto bit = 0u; bit < pin.lines.size() && result == 0; ++bit)
+        {
+            value |= (uint64_t)(values[bit] != 0) << bit;
+        }
+    }
+    if (result < 0)
+    {
+        int lastErrno = errno;
+        pin.stats->errors.inc();
+        stringstream funcall;
+        funcall << funcName << "(<" << pin.chipName << " " << pin.pinNum
+                << ">)";
+        logLibgpioCallError(funcall, result, lastErrno, pin.pinName,
+                            pin.chipName, pin.pinNum);
+        return false;
+    }
+    return true;
+}
+
+bool readPolledLines(const PolledLines& polled, uint64_t* values) noexcept
+{
+    struct gpiod_line_bulk bulk;
+    gpiod_line_bulk_init(&bulk);
+    for (const MonitoredPin* pin : polled.pins)
+    {
+        gpiod_line_bulk_add(&bulk, pin->lines.front());
+    }
+    int lineValues[GPIOD_LINE_BULK_MAX_LINES];
+    int result = gpiod_line_get_value_bulk(&bulk, lineValues);
+    if (result < 0)
+    {
+        int lastErrno = errno;
+        for (const MonitoredPin* pin : polled.pins)
+        {
+            pin->stats->errors.inc();
+        }
+        // The first pin stands for all of them in the logs
+        const MonitoredPin& pin = *polled.pins.front();
+        stringstream funcall;
+        funcall << "gpiod_line_get_value_bulk(<" << pin.chipName << " "
+                << pin.pinNum << "...>)";
+        logLibgpioCallError(funcall, result, lastErrno, pin.pinName,
+                            pin.chipName, pin.pinNum);
+        return false;
+    }
+    for (auto i = 0u; i < polled.pins.size(); ++i)
+    {
+        values[i] = lineValues[i] != 0 ? 1 : 0;
+    }
+    return true;
+}
+
+bool dropLineEvents(const MonitoredPin& pin, uint64_t& lastEdgeNs) noexcept
+{
+    lastEdgeNs = 0;
+    struct gpiod_line_bulk lines;
+    gpiod_line_bulk_init(&lines);
+    for (gpiod_line_t* line : pin.lines)
+    {
+        gpiod_line_bulk_add(&lines, line);
+    }
+    struct timespec noWait
+    {
+        0, 0
+    };
+    struct gpiod_line_bulk eventLines;
+    struct gpiod_line_event event;
+    const char* funcName = "gpiod_line_event_wait_bulk";
+    int result;
+    while ((result = gpiod_line_event_wait_bulk(&lines, &noWait,
+                                                &eventLines)) > 0)
+    {
+        for (auto i = 0u;
+             i < gpiod_line_bulk_num_lines(&eventLines) && result > 0; ++i)
+        {
+            if (gpiod_line_event_read(gpiod_line_bulk_get_line(&eventLines, i),
+                                      &event) != 0)
+            {
+                funcName = "gpiod_line_event_read";
+                result = -1;
+            }
+            else
+            {
+                lastEdgeNs = max(lastEdgeNs, getEventTimeNs(event));
+            }
+        }
+    }
+    if (result < 0)
+    {
+        int lastErrno = errno;
+        pin.stats->errors.inc();
+        stringstream funcall;
+        funcall << funcName << "(<" << pin.chipName << " " << pin.pinNum
+                << ">)";
+        logLibgpioCallError(funcall, result, lastErrno, pin.pinName,
+                            pin.chipName, pin.pinNum);
+        return false;
+    }
+    return true;
+}
+
+bool PinGroupGate::waitResumed() noexcept
+{
+    unique_lock<std::mutex> lock(gateMutex);
+    resumed.wait(lock, [this] {
+        return closed || !suspended.load(memory_order_relaxed);
+    });
+    return !closed;
+}
+
+void PinGroupGate::addResumeFd(int fd)
+{
+    resumeFds.push_back(fd);
+}
+
+void PinGroupGate::setSuspended(bool suspend) noexcept
+{
+    {
+        // Under the lock, so that a thread about to wait can't miss the
+        // notification below
+        lock_guard<std::mutex> lock(gateMutex);
+        suspended.store(suspend, memory_order_release);
+    }
+    if (suspend)
+    {
+        return;
+    }
+    resumed.notify_all();
+    uint64_t one = 1;
+    for (int fd : resumeFds)
+    {
+        if (write(fd, &one, sizeof(one)) != sizeof(one))
+        {
+            log<level::ERR>("Failed to signal the resumed pin group to a "
+                            "gpio worker");
+        }
+    }
+}
+
+void PinGroupGate::putReading(MonitoredPin& pin, uint64_t value,
+                              uint64_t readNs) noexcept
+{
+    lock_guard<std::mutex> lock(gateMutex);
+    pin.resumeValue = value;
+    pin.resumeReadNs = readNs;
+}
+
+bool PinGroupGate::takeReading(MonitoredPin& pin, uint64_t lastEdgeNs,
+                               uint64_t& value) noexcept
+{
+    lock_guard<std::mutex> lock(gateMutex);
+    uint64_t readNs = pin.resumeReadNs;
+    pin.resumeReadNs = 0;
+    value = pin.resumeValue;
+    // An edge dropped after the read changed the line since
+    return readNs != 0 && lastEdgeNs < readNs;
+}
+
+void PinGroupGate::close() noexcept
+{
+    {
+        lock_guard<std::mutex> lock(gateMutex);
+        closed = true;
+    }
+    resumed.notify_all();
+}
+
+void PriorityMutex::lock(PinPriority priority)
+{
+    unique_lock<std::mutex> lock(mutex);
+    if (priority == PinPriority::critical)
+    {
+        ++criticalWaiting;
+        released.wait(lock, [this]() { return !locked; });
+        --criticalWaiting;
+    }
+    else
+    {
+        released.wait(lock,
+                      [this]() { return !locked && criticalWaiting == 0; });
+    }
+    locked = true;
+}
+
+void PriorityMutex::unlock()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        locked = false;
+    }
+    // Both the critical and the normal waiters have to check their condition
+    released.notify_all();
+}
+
+GpioPublisher::GpioPublisher(
+    shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface,
+    GlobalStats& globalStats, GpioChangeLog& changeLog) :
+    dbusInterface(dbusInterface),
+    globalStats(globalStats), changeLog(changeLog)
+{}
+
+void GpioPublisher::onEdge(MonitoredPin& pin, unsigned bit,
+                           const struct gpiod_line_event& event) noexcept
+{
+    pin.stats->edges.inc();
+    FlightRecorder* flight = flightRecorder.load(memory_order_relaxed);
+    GpioEventStream* stream = eventStream.load(memory_order_relaxed);
+    GpioFaultGroups* groups = faultGroups.load(memory_order_relaxed);
+    if (flight != nullptr || stream != nullptr || groups != nullptr)
+    {
+        uint64_t timeNs = getEventTimeNs(event);
+        bool rising = event.event_type == GPIOD_LINE_EVENT_RISING_EDGE;
+        if (flight != nullptr)
+        {
+            flight->recordEdge(pin.pinIndex, bit, timeNs, rising);
+        }
+        if (stream != nullptr)
+        {
+            stream->push(pin.pinIndex, bit, timeNs, rising);
+        }
+        if (groups != nullptr && !pin.isBus)
+        {
+            groups->onEdge(pin.pinIndex, rising, timeNs);
+        }
+    }
+#ifdef SANDBOX_MODE
+    TraceRecorder* recorder = traceRecorder.load(memory_order_relaxed);
+    if (recorder != nullptr)
+    {
+        recorder->record(pin.pinIndex, bit, event.ts,
+                         event.event_type == GPIOD_LINE_EVENT_RISING_EDGE);
+    }
+#endif
+}
+
+bool GpioPublisher::publish(MonitoredPin& pin, uint64_t pinValue,
+                            uint64_t detectedNs) noexcept
+{
+    bool success = true;
+    if (pinValue != pin.publishedValue)
+    {
+        // Ahead of the property update, the actions don't wait for it
+        GpioActions* actions = pinActions.load(memory_order_relaxed);
+        if (actions != nullptr && !pin.isBus)
+        {
+            actions->trigger(pin.pinIndex, pinValue != 0, detectedNs);
+        }
+        success = setDBusProperty(pin, 0, pinValue, detectedNs);
+        pin.publishedValue = pinValue;
+    }
+    else
+    {
+        pin.stats->writesSuppressed.inc();
+    }
+    return success;
+}
+
+bool GpioPublisher::publishMeasurement(MonitoredPin& pin,
+                                       const PinMeasurement& measurement,
+                                       uint64_t detectedNs) noexcept
+{
+    // In the order of 'GpioJsonConfig::measurementPropertySuffixes'
+    const uint64_t values[] = {measurement.edgeCount,
+                               measurement.frequencyMilliHz,
+                               measurement.dutyCyclePpm};
+    uint64_t* published[] = {&pin.publishedMeasurement.edgeCount,
+                             &pin.publishedMeasurement.frequencyMilliHz,
+                             &pin.publishedMeasurement.dutyCyclePpm};
+    bool success = true;
+    for (auto i = 0u; i < size(values) && success; ++i)
+    {
+        if (values[i] != *published[i])
+        {
+            success = setDBusProperty(pin, i, values[i], detectedNs);
+            *published[i] = values[i];
+        }
+        else
+        {
+            pin.stats->writesSuppressed.inc();
+        }
+    }
+    return success;
+}
+
+GlobalStats& GpioPublisher::getGlobalStats()
+{
+    return globalStats;
+}
+
+exception_ptr GpioPublisher::getLastException() const
+{
+    return lastException;
+}
+
+void GpioPublisher::setFlightRecorder(FlightRecorder* recorder)
+{
+    flightRecorder.store(recorder, memory_order_relaxed);
+}
+
+void GpioPublisher::setEventStream(GpioEventStream* stream)
+{
+    eventStream.store(stream, memory_order_relaxed);
+}
+
+void GpioPublisher::setActions(GpioActions* actions)
+{
+    pinActions.store(actions, memory_order_relaxed);
+}
+
+void GpioPublisher::setFaultGroups(GpioFaultGroups* groups)
+{
+    faultGroups.store(groups, memory_order_relaxed);
+}
+
+#ifdef SANDBOX_MODE
+void GpioPublisher::setTraceRecorder(TraceRecorder* recorder)
+{
+    traceRecorder.store(recorder, memory_order_relaxed);
+}
+#endif
+
+bool GpioPublisher::setDBusProperty(const MonitoredPin& pin, unsigned property,
+                                    uint64_t value,
+                                    uint64_t detectedNs) noexcept
+{
+    const PinProperty& pinProperty = pin.properties[property];
+    bool success = false;
+    {
+        auto lockRequested = chrono::steady_clock::now();
+        PriorityMutex::Guard lock(setDBusPropMutex, pin.priority);
+        globalStats.propMutexWaitNs.inc(
+            chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - lockRequested)
+                .count());
+#ifdef ENABLE_GSH_LOGS
+        {
+            // Formatted on the stack, see the steady state in the class doc.
+            // A notice, left to the journal's level filter (MaxLevelStore).
+            char message[256];
+            snprintf(message, sizeof(message), "Setting '%s.%s' <- %" PRIu64,
+                     dbusInterfaceName, pinProperty.name.c_str(), value);
+            logPinOperation<level::NOTICE>(message, pin.pinName, pin.chipName,
+                                           pin.pinNum);
+        }
+#endif
+        try
+        {
+            // The property getter reads the value from the change log, so
+            // emitting the signal is all there is left to do
+            changeLog.append(pin.propertyIndex + property, value);
+            success = dbusInterface->signal_property(pinProperty.name);
+            // Under the lock, so the records are in the order of the changes
+            FlightRecorder* flight =
+                flightRecorder.load(memory_order_relaxed);
+            if (success && flight != nullptr)
+            {
+                flight->recordPublished(pin.propertyIndex + property, value,
+                                        EdgeMeter::nowNs());
+            }
+        }
+        catch (...) // Catch most possible number of exceptions
+        {
+            lastException = std::current_exception();
+            success = false;
+        }
+    }
+    if (success)
+    {
+        pin.stats->propertyWrites.inc();
+        uint64_t nowNs = EdgeMeter::nowNs();
+        uint64_t latencyNs = nowNs > detectedNs ? nowNs - detectedNs : 0;
+        pin.stats->publishLatency.add(latencyNs);
+        globalStats.publishLatency[(size_t)pin.priority].add(latencyNs);
+    }
+    else
+    {
+        pin.stats->errors.inc();
+        globalStats.dbusSendFailures.inc();
+        stringstream ss;
+        ss << "Unable to set the property '" << dbusInterfaceName << "."
+           << pinProperty.name << "' to " << value;
+        logPinOperation<level::ERR>(ss.str().c_str(), pin.pinName,
+                                    pin.chipName, pin.pinNum);
+    }
+    return success;
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <gpiod.h>
+
+#include <gpio_actions.hpp>
+#include <gpio_change_log.hpp>
+#include <gpio_event_stream.hpp>
+#include <gpio_fault_groups.hpp>
+#include <gpio_flight_recorder.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_measurement.hpp>
+#include <gpio_stats.hpp>
+#include <gpio_status_handler.hpp>
+#ifdef SANDBOX_MODE
+#include <gpio_trace.hpp>
+#endif
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+struct MonitoredPin;
+struct PolledLines;
+
+/**
+ * @brief The suspension of a pin group (see @ref GpioPinGroups), checked by
+ * the threads monitoring its pins before waiting for their lines
+ */
+class PinGroupGate
+{
+  public:
+    /** @brief True while the group is suspended. Can be called from any
+     * thread. **/
+    bool isSuspended() const noexcept
+    {
+        return suspended.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Block the calling thread, without any wakeup, until the group is
+     * resumed or the gate is closed. Allocates no memory.
+     *
+     * @return False if the gate was closed, the thread must finish then.
+     */
+    bool waitResumed() noexcept;
+
+    /**
+     * @brief Signal every resumption of the group to the event descriptor @fd
+     * too, for the threads waiting on it rather than in @ref waitResumed.
+     *
+     * To be called before the group can be resumed. The @fd must stay open
+     * while the group can be resumed.
+     */
+    void addResumeFd(int fd);
+
+    /** @brief Suspend or resume the group, waking up its waiting threads
+     * when resumed **/
+    void setSuspended(bool suspend) noexcept;
+
+    /** @brief Wake up the threads waiting in @ref waitResumed for good **/
+    void close() noexcept;
+
+    /**
+     * @brief Keep the @value of @pin read at @readNs [nanoseconds, on the
+     * clock of @ref EdgeMeter::nowNs] by the bulk read of the group, before
+     * the group is resumed. A zero @readNs marks a failed read.
+     */
+    void putReading(MonitoredPin& pin, uint64_t value,
+                    uint64_t readNs) noexcept;
+
+    /**
+     * @brief Take the reading of @pin kept by @ref putReading for the last
+     * resumption into @value, by the thread monitoring the pin once it has
+     * dropped the edges queued meanwhile, the latest of which came at
+     * @lastEdgeNs [nanoseconds], 0 if none.
+     *
+     * @return False if there's no reading, or if it's older than that edge,
+     * the pin must be read by itself then.
+     */
+    bool takeReading(MonitoredPin& pin, uint64_t lastEdgeNs,
+                     uint64_t& value) noexcept;
+
+  private:
+    std::atomic<bool> suspended = false;
+    std::mutex gateMutex;
+    std::condition_variable resumed;
+    /** @brief Guarded by @ref gateMutex **/
+    bool closed = false;
+    std::vector<int> resumeFds;
+};
+
+/**
+ * @brief Runtime description of a single monitored gpio pin or a multi-bit
+ * bus, common to all the ways the pin can be monitored (thread per pin, worker
+ * pool, trace replay)
+ *
+ * A bus is monitored and published as a unit: an edge on any of its lines
+ * triggers the reading of all of them and the value is a single integer, the
+ * first line being the least significant bit.
+ *
+ * A pin in the "measure" mode has a @ref meter and publishes its
+ * @ref PinMeasurement once per window rather than its value. A pin in the
+ * "output" mode is not monitored at all, see @ref GpioOutputs.
+ */
+struct MonitoredPin
+{
+    /** @brief Name of the DBus property, the key of the config entry **/
+    std::string pinName;
+    /** @brief Name of the gpio chip, ie "gpiochip0" **/
+    std::string chipName;
+    /** @brief Line offset on the chip, of the first line for a bus **/
+    unsigned pinNum;
+    /** @brief Position of the pin in the config **/
+    uint16_t pinIndex;
+    /** @brief The DBus properties of the pin, see @ref
+     * GpioJsonConfig::getProperties **/
+    std::vector<PinProperty> properties;
+    /** @brief Position of the first of the @ref properties among the
+     * properties of all the pins, in the config order **/
+    uint16_t propertyIndex;
+    /** @brief True if the entry is a bus, published as an unsigned integer
+     * property rather than a boolean one **/
+    bool isBus;
+    /** @brief True if the line is an output set by the @ref GpioOutputs, owned
+     * by the DBus server thread rather than by a monitoring thread **/
+    bool isOutput;
+    /** @brief True if the line is an input read by polling only, without
+     * edge events (the "poll" mode) **/
+    bool isPolled;
+    /** @brief The critical pins take the fast path, see @ref GpioPublisher **/
+    PinPriority priority;
+    /** @brief The requested gpio lines, one per bit, empty if no gpio
+     * hardware is used **/
+    std::vector<gpiod_line_t*> lines;
+    /** @brief Period of the polling "just in case" [nanoseconds] **/
+    uint64_t readPeriodNs;
+    /** @brief Counters of this pin **/
+    PinStats* stats;
+    /** @brief The value of the DBus property, 0 or 1 for a single pin. Owned
+     * by the thread publishing the pin. **/
+    uint64_t publishedValue;
+    /** @brief Measurement of the edges in the "measure" mode, owned by the
+     * thread monitoring the pin **/
+    std::optional<EdgeMeter> meter;
+    /** @brief The values of the measurement properties, owned by the thread
+     * publishing the pin **/
+    PinMeasurement publishedMeasurement;
+    /** @brief Liveness of the thread of its own monitoring the pin, if any **/
+    LoopHeartbeat* heartbeat = nullptr;
+    /** @brief The gate of the pin's group, NULL if the pin is in no group **/
+    PinGroupGate* group = nullptr;
+    /** @brief The value read by the bulk read of the group on its last
+     * resumption, and when [nanoseconds], 0 if none. Guarded by the gate of
+     * the @ref group. **/
+    uint64_t resumeValue = 0;
+    uint64_t resumeReadNs = 0;
+    /** @brief The line request shared with the other polled pins of the chip,
+     * NULL if the pin is not polled or has a request of its own **/
+    PolledLines* polledLines = nullptr;
+};
+
+/**
+ * @brief The polled pins of a gpio chip sharing a line request (see @ref
+ * GpioLines::getPolledRequests), read together by a single bulk read, a single
+ * ioctl, at the shortest read period among them
+ */
+struct PolledLines
+{
+    /** @brief Name of the gpio chip, ie "gpiochip0" **/
+    std::string chipName;
+    /** @brief The pins, of a single line each, in the request order **/
+    std::vector<MonitoredPin*> pins;
+    /** @brief Period of the reads, the shortest one of the @ref pins
+     * [nanoseconds] **/
+    uint64_t readPeriodNs;
+    /** @brief Liveness of the thread of its own reading the lines, if any **/
+    LoopHeartbeat* heartbeat = nullptr;
+};
+
+/**
+ * @brief Create the @ref MonitoredPin for every entry of @gpioConfig, in the
+ * config order.
+ *
+ * The lines are taken from @dbusPropMapLineObj (see @ref
+ * GpioLines::getDbusPropMapLineObj). Pins missing in it get no lines.
+ */
+std::vector<MonitoredPin> createMonitoredPins(
+    const GpioJsonConfig& gpioConfig, GpioStats& gpioStats,
+    const std::map<std::string, std::vector<gpiod_line_t*>>&
+        dbusPropMapLineObj);
+
+/**
+ * @brief Create the @ref PolledLines of every request of the @polledRequests
+ * (see @ref GpioLines::getPolledRequests) and link the @pins to them.
+ *
+ * The @pins must not be moved while the result is used.
+ */
+std::vector<PolledLines> createPolledLines(
+    std::vector<MonitoredPin>& pins,
+    const std::vector<std::vector<std::string>>& polledRequests);
+
+/** @brief Kernel timestamp of the line @event, on the clock of @ref
+ * EdgeMeter::nowNs [nanoseconds] **/
+uint64_t getEventTimeNs(const struct gpiod_line_event& event) noexcept;
+
+/**
+ * @brief Read the current value of all the lines of @pin into @value.
+ *
+ * A bus is read by a single @gpiod_line_get_value_bulk call. Errors are
+ * logged and counted in the pin's statistics.
+ *
+ * @return False if the lines could not be read, true otherwise.
+ */
+bool readPinValue(const MonitoredPin& pin, uint64_t& value) noexcept;
+
+/**
+ * @brief Read the lines of all the pins of @polled into @values, one per pin,
+ * by a single @gpiod_line_get_value_bulk call. Errors are logged and counted
+ * in the statistics of every pin.
+ *
+ * @return False if the lines could not be read, true otherwise.
+ */
+bool readPolledLines(const PolledLines& polled, uint64_t* values) noexcept;
+
+/**
+ * @brief Drop the edge events queued by the kernel for the lines of @pin,
+ * without waiting for any, setting @lastEdgeNs to the kernel timestamp of the
+ * latest of them, 0 if none. Errors are logged and counted in the pin's
+ * statistics.
+ *
+ * @return False if the events could not be read, true otherwise.
+ */
+bool dropLineEvents(const MonitoredPin& pin, uint64_t& lastEdgeNs) noexcept;
+
+/**
+ * @brief Mutex which is handed over to the threads waiting with the critical
+ * priority before those waiting with the normal one
+ *
+ * Among the threads of the same priority the order is unspecified.
+ */
+class PriorityMutex
+{
+  public:
+    /** @brief Holds the mutex locked with a priority for its lifetime **/
+    class Guard
+    {
+      public:
+        Guard(PriorityMutex& mutex, PinPriority priority) : mutex(mutex)
+        {
+            mutex.lock(priority);
+        }
+
+        ~Guard()
+        {
+            mutex.unlock();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+      private:
+        PriorityMutex& mutex;
+    };
+
+    void lock(PinPriority priority);
+    void unlock();
+
+  private:
+    std::mutex mutex;
+    std::condition_variable released;
+    bool locked = false;
+    unsigned criticalWaiting = 0;
+};
+
+/**
+ * @brief The common end of the event path of all the monitored pins
+ *
+ * Every edge read from a gpio line and every pin value obtained, no matter by
+ * which thread, is passed to this object, which accounts it in the statistics
+ * and publishes it on the DBus interface. Both the edges and the published
+ * changes go to the @ref FlightRecorder, if any, and the edges to the
+ * subscribers of the @ref GpioEventStream, if any. The published transitions
+ * of the single pins trigger their @ref GpioActions, if any, before the
+ * property update, and their edges go to the @ref GpioFaultGroups, if any.
+ * The methods are thread-safe.
+ *
+ * The property updates are serialized by a @ref PriorityMutex, so when the
+ * updates pile up the ones of the critical pins are done first. The monitoring
+ * modes publish the critical pins straight from the thread reading them,
+ * without coalescing or queueing them. The latency from the detection of a
+ * change until its property update is counted per pin priority.
+ *
+ * Publishing makes no heap allocation of its own, so the monitoring threads
+ * don't allocate in their steady state (see @ref SteadyStateScope). The pin
+ * properties are read from the @ref GpioChangeLog, which keeps the values by
+ * the property position, and an update only appends the value there and emits
+ * the 'PropertiesChanged' signal for the property name prepared at startup.
+ * The signal message itself is still allocated by sd-bus, with malloc, which
+ * the steady state allocation count doesn't see.
+ */
+class GpioPublisher
+{
+  public:
+    /**
+     * @brief Publish the pin values on the @dbusInterface, log every published
+     * change in @changeLog and count the service-wide operations in
+     * @globalStats.
+     *
+     * The properties of the @dbusInterface must be read from the @changeLog
+     * values, see @ref GpioChangeLog::getValue.
+     */
+    GpioPublisher(
+        std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface,
+        GlobalStats& globalStats, GpioChangeLog& changeLog);
+
+    /**
+     * @brief Account the @event read from the line @bit of @pin (0 for a
+     * single pin).
+     */
+    void onEdge(MonitoredPin& pin, unsigned bit,
+                const struct gpiod_line_event& event) noexcept;
+
+    /**
+     * @brief Publish @pinValue on the @pin property unless it's equal to the
+     * @ref MonitoredPin::publishedValue.
+     *
+     * The @detectedNs is the time the value was obtained, or the kernel
+     * timestamp of the edge which caused it, on the clock of @ref
+     * EdgeMeter::nowNs.
+     *
+     * @return False if the DBus property could not be set, true otherwise.
+     */
+    bool publish(MonitoredPin& pin, uint64_t pinValue,
+                 uint64_t detectedNs) noexcept;
+
+    /**
+     * @brief Publish those values of the @measurement of the @pin in the
+     * "measure" mode which differ from the @ref
+     * MonitoredPin::publishedMeasurement.
+     *
+     * The @detectedNs is the time the measurement window was closed, see
+     * @ref publish.
+     *
+     * @return False if any DBus property could not be set, true otherwise.
+     */
+    bool publishMeasurement(MonitoredPin& pin,
+                            const PinMeasurement& measurement,
+                            uint64_t detectedNs) noexcept;
+
+    /** @brief Get the global service counters **/
+    GlobalStats& getGlobalStats();
+
+    /** @brief The exception which caused the last failure of @ref publish,
+     * if any **/
+    std::exception_ptr getLastException() const;
+
+    /**
+     * @brief Append all the subsequent edges passed to @ref onEdge and the
+     * published changes to @recorder. NULL stops the recording. The
+     * @recorder must outlive the recording.
+     */
+    void setFlightRecorder(FlightRecorder* recorder);
+
+    /**
+     * @brief Stream all the subsequent edges passed to @ref onEdge to the
+     * subscribers of @stream. NULL stops the streaming. The @stream must
+     * outlive the streaming.
+     */
+    void setEventStream(GpioEventStream* stream);
+
+    /**
+     * @brief Trigger the @actions of all the subsequent transitions of the
+     * single pins published by @ref publish. NULL stops the triggering. The
+     * @actions must outlive the triggering.
+     */
+    void setActions(GpioActions* actions);
+
+    /**
+     * @brief Pass all the subsequent edges of the single pins passed to @ref
+     * onEdge to the fault @groups. NULL stops the passing. The @groups must
+     * outlive the passing.
+     */
+    void setFaultGroups(GpioFaultGroups* groups);
+
+#ifdef SANDBOX_MODE
+    /**
+     * @brief Record all the subsequent edges passed to @ref onEdge in
+     * @recorder. NULL stops the recording. The @recorder must outlive the
+     * recording.
+     */
+    void setTraceRecorder(TraceRecorder* recorder);
+#endif
+
+  private:
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+    GlobalStats& globalStats;
+    GpioChangeLog& changeLog;
+    /** @brief Serializes the property updates, so that the change log order
+     * is the order of the 'PropertiesChanged' signals **/
+    PriorityMutex setDBusPropMutex;
+    std::exception_ptr lastException;
+    std::atomic<FlightRecorder*> flightRecorder = nullptr;
+    std::atomic<GpioEventStream*> eventStream = nullptr;
+    std::atomic<GpioActions*> pinActions = nullptr;
+    std::atomic<GpioFaultGroups*> faultGroups = nullptr;
+#ifdef SANDBOX_MODE
+    std::atomic<TraceRecorder*> traceRecorder = nullptr;
+#endif
+
+    bool setDBusProperty(const MonitoredPin& pin, unsigned property,
+                         uint64_t value, uint64_t detectedNs) noexcept;
+};
+
+} // namespace gpio_handler
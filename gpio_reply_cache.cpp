@@ -0,0 +1,193 @@
+#include <gpio_reply_cache.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <cstring>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+static constexpr auto propertiesInterfaceName =
+    "org.freedesktop.DBus.Properties";
+static constexpr auto introspectableInterfaceName =
+    "org.freedesktop.DBus.Introspectable";
+
+GpioReplyCache::GpioReplyCache(
+    shared_ptr<sdbusplus::asio::connection> conn, const string& serviceName,
+    const string& objectPath, const string& interfaceName,
+    const GpioJsonConfig& gpioConfig, const GpioChangeLog& changeLog) :
+    conn(conn),
+    objectPath(objectPath), interfaceName(interfaceName), changeLog(changeLog)
+{
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        for (const auto& property : GpioJsonConfig::getProperties(pin))
+        {
+            propertyNames.push_back(property.name);
+            isInteger.push_back(property.isInteger);
+        }
+    }
+    int result = sd_bus_add_filter(conn->get(), &filterSlot, filter, this);
+    if (result < 0)
+    {
+        throw system_error(error_code(-result, system_category()),
+                           "Failed to add the DBus reply cache filter");
+    }
+    // Answered by sd-bus, through the filter letting it pass, once the DBus
+    // server thread runs
+    conn->async_method_call(
+        [this](const boost::system::error_code& ec, const string& xml) {
+            if (!ec)
+            {
+                introspectXml = xml;
+            }
+        },
+        serviceName, objectPath, introspectableInterfaceName, "Introspect");
+}
+
+GpioReplyCache::~GpioReplyCache()
+{
+    sd_bus_slot_unref(filterSlot);
+    sd_bus_message_unref(getAllBody);
+}
+
+int GpioReplyCache::filter(sd_bus_message* m, void* userdata,
+                           sd_bus_error* /*error*/)
+{
+    auto cache = static_cast<GpioReplyCache*>(userdata);
+    const char* path = sd_bus_message_get_path(m);
+    if (cache->disabled || path == NULL || cache->objectPath != path)
+    {
+        return 0;
+    }
+    if (sd_bus_message_is_method_call(m, propertiesInterfaceName, "GetAll") >
+        0)
+    {
+        return cache->replyGetAll(m);
+    }
+    if (sd_bus_message_is_method_call(m, introspectableInterfaceName,
+                                      "Introspect") > 0)
+    {
+        return cache->replyIntrospect(m);
+    }
+    return 0;
+}
+
+// A positive result stops sd-bus from processing the call any further
+int GpioReplyCache::replyGetAll(sd_bus_message* call)
+{
+    const char* callInterface = NULL;
+    bool ours = sd_bus_message_read_basic(call, 's', &callInterface) > 0 &&
+                interfaceName == callInterface;
+    // Left for sd-bus to read again otherwise
+    sd_bus_message_rewind(call, 1);
+    if (!ours)
+    {
+        return 0;
+    }
+    int result = 0;
+    if (getAllBody == NULL || changeLog.getGeneration() != generation)
+    {
+        result = buildGetAllBody();
+        if (result < 0)
+        {
+            disable("Failed to build the cached GetAll reply", result);
+            return 0;
+        }
+    }
+    sd_bus_message* reply = NULL;
+    result = sd_bus_message_new_method_return(call, &reply);
+    if (result >= 0)
+    {
+        result = sd_bus_message_rewind(getAllBody, 1);
+    }
+    if (result >= 0)
+    {
+        result = sd_bus_message_copy(reply, getAllBody, 1);
+    }
+    if (result >= 0)
+    {
+        result = sd_bus_send(NULL, reply, NULL);
+    }
+    sd_bus_message_unref(reply);
+    if (result < 0)
+    {
+        disable("Failed to send the cached GetAll reply", result);
+        return 0;
+    }
+    return 1;
+}
+
+int GpioReplyCache::replyIntrospect(sd_bus_message* call)
+{
+    if (introspectXml.empty())
+    {
+        return 0;
+    }
+    int result = sd_bus_reply_method_return(call, "s", introspectXml.c_str());
+    if (result < 0)
+    {
+        disable("Failed to send the cached Introspect reply", result);
+        return 0;
+    }
+    return 1;
+}
+
+int GpioReplyCache::buildGetAllBody()
+{
+    generation = changeLog.getValues(values);
+    sd_bus_message_unref(getAllBody);
+    getAllBody = NULL;
+    // Any message type holds the body, it's never sent
+    sd_bus_message* body = NULL;
+    int result = sd_bus_message_new_method_call(
+        conn->get(), &body, NULL, objectPath.c_str(),
+        propertiesInterfaceName, "GetAll");
+    if (result >= 0)
+    {
+        result = sd_bus_message_open_container(body, 'a', "{sv}");
+    }
+    for (auto i = 0u; i < values.size() && result >= 0; ++i)
+    {
+        result = isInteger[i]
+                     ? sd_bus_message_append(body, "{sv}",
+                                             propertyNames[i].c_str(), "t",
+                                             values[i])
+                     : sd_bus_message_append(body, "{sv}",
+                                             propertyNames[i].c_str(), "b",
+                                             (int)(values[i] != 0));
+    }
+    if (result >= 0)
+    {
+        result = sd_bus_message_close_container(body);
+    }
+    if (result >= 0)
+    {
+        // Only a sealed message can be read from
+        result = sd_bus_message_seal(body, 1, 0);
+    }
+    if (result >= 0)
+    {
+        getAllBody = body;
+    }
+    else
+    {
+        sd_bus_message_unref(body);
+    }
+    return result;
+}
+
+void GpioReplyCache::disable(const char* what, int result)
+{
+    disabled = true;
+    log<level::WARNING>(what, entry("ERRNO=%d", -result),
+                        entry("ERRNO_STR=%s", strerror(-result)));
+}
+
+} // namespace gpio_handler
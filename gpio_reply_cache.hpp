@@ -0,0 +1,93 @@
+#pragma once
+
+#include <systemd/sd-bus.h>
+
+#include <gpio_change_log.hpp>
+#include <gpio_json_config.hpp>
+#include <sdbusplus/asio/connection.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Answers the 'GetAll' calls of the pin properties interface and the
+ * 'Introspect' calls of the service object from the replies built once
+ *
+ * sd-bus builds the reply of every 'GetAll' call property by property,
+ * calling the getter of each and wrapping its value in a variant, on the DBus
+ * server thread which also publishes the pin changes. Here the 'GetAll' reply
+ * body is serialized once into a sealed message and every call is answered by
+ * copying it, without a getter call. The body is serialized again, from a
+ * single snapshot of the @ref GpioChangeLog, by the first call after the
+ * change log generation moved, so the repeated reads of an unchanged state
+ * cost a copy of the message.
+ *
+ * The introspection data of the object doesn't change once all its
+ * interfaces are registered, it's taken from the first 'Introspect' reply of
+ * sd-bus to a call of the service to itself and served as is from then on.
+ *
+ * The calls are taken by an sd-bus filter ahead of the object dispatch. Any
+ * other call passes through, as well as all the calls until the replies are
+ * ready, or if they could not be built. Used by the DBus server thread only.
+ */
+class GpioReplyCache
+{
+  public:
+    /**
+     * @brief Take the 'GetAll' calls of the @interfaceName interface and the
+     * 'Introspect' calls of the @objectPath object of the service
+     * @serviceName on the @conn connection, with the properties of the pins
+     * of @gpioConfig whose values are kept by @changeLog.
+     *
+     * To be created once all the interfaces of @objectPath were initialized.
+     * Throw @ref std::system_error if the filter could not be added.
+     */
+    GpioReplyCache(std::shared_ptr<sdbusplus::asio::connection> conn,
+                   const std::string& serviceName,
+                   const std::string& objectPath,
+                   const std::string& interfaceName,
+                   const GpioJsonConfig& gpioConfig,
+                   const GpioChangeLog& changeLog);
+
+    ~GpioReplyCache();
+
+    GpioReplyCache(const GpioReplyCache&) = delete;
+    GpioReplyCache& operator=(const GpioReplyCache&) = delete;
+
+  private:
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::string objectPath;
+    std::string interfaceName;
+    const GpioChangeLog& changeLog;
+    /** @brief Indexed by the property position, see @ref
+     * MonitoredPin::propertyIndex **/
+    std::vector<std::string> propertyNames;
+    std::vector<bool> isInteger;
+    /** @brief Snapshot of the values the @ref getAllBody was built from **/
+    std::vector<uint64_t> values;
+    /** @brief The change log generation of the @ref values **/
+    uint64_t generation = 0;
+    /** @brief Sealed message holding the 'a{sv}' body of the 'GetAll' reply,
+     * NULL until built **/
+    sd_bus_message* getAllBody = nullptr;
+    /** @brief The introspection data, empty until known **/
+    std::string introspectXml;
+    /** @brief Set once building or sending a reply failed, the calls are
+     * left to sd-bus then **/
+    bool disabled = false;
+    sd_bus_slot* filterSlot = nullptr;
+
+    static int filter(sd_bus_message* m, void* userdata,
+                      sd_bus_error* error);
+    int replyGetAll(sd_bus_message* call);
+    int replyIntrospect(sd_bus_message* call);
+    int buildGetAllBody();
+    void disable(const char* what, int result);
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,201 @@
+#include <gpio_alloc_count.hpp>
+#include <gpio_stats.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <chrono>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace gpio_handler
+{
+
+/** @brief Period of the wakeups rate computation **/
+static constexpr auto rateUpdatePeriod = chrono::seconds(1);
+
+/** @brief DBus representation of @ref LatencyStats, signature '(ttt)' **/
+using LatencyStatsTuple = tuple<uint64_t, uint64_t, uint64_t>;
+
+/** @brief DBus representation of @ref PinStats, signature '(tttttt)' **/
+using PinStatsTuple =
+    tuple<uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t>;
+
+GpioStats::GpioStats(boost::asio::io_context& io,
+                     const GpioJsonConfig& jsonConfig) :
+    rateTimer(io)
+{
+    for (const auto& pin : jsonConfig.getPins())
+    {
+        // 'PinStats' is neither copyable nor movable, construct in place
+        pinStats.try_emplace(pin.name);
+    }
+}
+
+PinStats& GpioStats::getPinStats(const string& pinName)
+{
+    return pinStats.at(pinName);
+}
+
+GlobalStats& GpioStats::getGlobalStats()
+{
+    return globalStats;
+}
+
+void GpioStats::setPinAvailable(const string& pinName, bool available)
+{
+    bool changed = available ? unavailablePins.erase(pinName) > 0
+                             : unavailablePins.insert(pinName).second;
+    if (changed && dbusInterface)
+    {
+        dbusInterface->signal_property("UnavailablePins");
+    }
+}
+
+void GpioStats::setPinSuspended(const string& pinName, bool suspended)
+{
+    bool changed = suspended ? suspendedPins.insert(pinName).second
+                             : suspendedPins.erase(pinName) > 0;
+    if (changed && dbusInterface)
+    {
+        dbusInterface->signal_property("SuspendedPins");
+    }
+}
+
+void GpioStats::createDbusInterface(sdbusplus::asio::object_server& server,
+                                    const string& objectPath,
+                                    const string& interfaceName)
+{
+    dbusInterface = server.add_interface(objectPath, interfaceName);
+    for (auto& [pinName, stats] : pinStats)
+    {
+        PinStats* s = &stats;
+        dbusInterface->register_property_r(
+            pinName, PinStatsTuple{}, sdbusplus::vtable::property_::none,
+            [s](const PinStatsTuple&) {
+                return PinStatsTuple{s->edges.get(),
+                                     s->polls.get(),
+                                     s->pollChanges.get(),
+                                     s->propertyWrites.get(),
+                                     s->writesSuppressed.get(),
+                                     s->errors.get()};
+            });
+    }
+    dbusInterface->register_property_r(
+        "PinPublishLatency", map<string, LatencyStatsTuple>{},
+        sdbusplus::vtable::property_::none,
+        [this](const map<string, LatencyStatsTuple>&) {
+            map<string, LatencyStatsTuple> latencies;
+            for (const auto& [pinName, stats] : pinStats)
+            {
+                const LatencyStats& s = stats.publishLatency;
+                latencies[pinName] = LatencyStatsTuple{
+                    s.count.get(), s.totalNs.get(),
+                    s.maxNs.load(memory_order_relaxed)};
+            }
+            return latencies;
+        });
+    dbusInterface->register_property_r(
+        "Wakeups", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.wakeups.get(); });
+    dbusInterface->register_property_r(
+        "WakeupsPerSecond", double{}, sdbusplus::vtable::property_::none,
+        [this](const double&) { return wakeupsPerSec; });
+    dbusInterface->register_property_r(
+        "DBusSendFailures", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.dbusSendFailures.get(); });
+    dbusInterface->register_property_r(
+        "PropertyMutexWaitNs", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.propMutexWaitNs.get(); });
+    const pair<LatencyStats*, const char*> latencyProperties[] = {
+        {&globalStats.publishLatency[(size_t)PinPriority::normal],
+         "PublishLatencyNormal"},
+        {&globalStats.publishLatency[(size_t)PinPriority::critical],
+         "PublishLatencyCritical"},
+        {&globalStats.actionLatency, "ActionLatency"},
+        {&globalStats.dbusLoopLag.lag, "DBusLoopLag"},
+        {&globalStats.monitorLoopLag.lag, "MonitorLoopLag"}};
+    for (const auto& [latency, propertyName] : latencyProperties)
+    {
+        LatencyStats* s = latency;
+        dbusInterface->register_property_r(
+            propertyName, LatencyStatsTuple{},
+            sdbusplus::vtable::property_::none,
+            [s](const LatencyStatsTuple&) {
+                return LatencyStatsTuple{s->count.get(), s->totalNs.get(),
+                                         s->maxNs.load(memory_order_relaxed)};
+            });
+    }
+    dbusInterface->register_property_r(
+        "ActionFailures", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.actionFailures.get(); });
+    dbusInterface->register_property_r(
+        "ActionsDropped", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.actionsDropped.get(); });
+    const pair<LagStats*, const char*> histogramProperties[] = {
+        {&globalStats.dbusLoopLag, "DBusLoopLagHistogram"},
+        {&globalStats.monitorLoopLag, "MonitorLoopLagHistogram"}};
+    for (const auto& [lagStats, propertyName] : histogramProperties)
+    {
+        LagStats* s = lagStats;
+        dbusInterface->register_property_r(
+            propertyName, vector<uint64_t>{},
+            sdbusplus::vtable::property_::none,
+            [s](const vector<uint64_t>&) {
+                vector<uint64_t> histogram;
+                for (const auto& bucket : s->histogram)
+                {
+                    histogram.push_back(bucket.get());
+                }
+                return histogram;
+            });
+    }
+    dbusInterface->register_property_r(
+        "LoopStalls", uint64_t{}, sdbusplus::vtable::property_::none,
+        [this](const uint64_t&) { return globalStats.loopStalls.get(); });
+    dbusInterface->register_property_r(
+        "UnavailablePins", vector<string>{},
+        sdbusplus::vtable::property_::emits_change,
+        [this](const vector<string>&) {
+            return vector<string>(unavailablePins.begin(),
+                                  unavailablePins.end());
+        });
+    dbusInterface->register_property_r(
+        "SuspendedPins", vector<string>{},
+        sdbusplus::vtable::property_::emits_change,
+        [this](const vector<string>&) {
+            return vector<string>(suspendedPins.begin(), suspendedPins.end());
+        });
+#ifdef SANDBOX_MODE
+    dbusInterface->register_property_r(
+        "SteadyStateAllocations", uint64_t{},
+        sdbusplus::vtable::property_::none,
+        [](const uint64_t&) { return getSteadyStateAllocations(); });
+#endif
+    dbusInterface->initialize();
+
+    lastWakeups = globalStats.wakeups.get();
+    scheduleRateUpdate();
+}
+
+// Both the timer handler and the property getters run on the DBus server
+// thread, so 'wakeupsPerSec' needs no synchronization.
+void GpioStats::scheduleRateUpdate()
+{
+    rateTimer.expires_after(rateUpdatePeriod);
+    rateTimer.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec)
+        {
+            uint64_t wakeups = globalStats.wakeups.get();
+            wakeupsPerSec =
+                (double)(wakeups - lastWakeups) /
+                chrono::duration<double>(rateUpdatePeriod).count();
+            lastWakeups = wakeups;
+            scheduleRateUpdate();
+        }
+    });
+}
+
+} // namespace gpio_handler
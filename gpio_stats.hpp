@@ -0,0 +1,241 @@
+#pragma once
+
+#include <boost/asio/steady_timer.hpp>
+#include <gpio_json_config.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Monotonic operational counter which can be updated from any thread
+ * without locking
+ *
+ * The relaxed memory order is sufficient since the counters are never used to
+ * synchronize access to any other data, they are only scraped as statistics.
+ */
+class Counter
+{
+  public:
+    void inc(uint64_t n = 1) noexcept
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const noexcept
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> value{0};
+};
+
+/** @brief Distribution of the latencies of an operation, which can be
+ * updated from any thread without locking **/
+struct LatencyStats
+{
+    /** @brief Number of the operations **/
+    Counter count;
+    /** @brief Sum of the latencies [nanoseconds] **/
+    Counter totalNs;
+    /** @brief The highest latency [nanoseconds] **/
+    std::atomic<uint64_t> maxNs{0};
+
+    void add(uint64_t latencyNs) noexcept
+    {
+        count.inc();
+        totalNs.inc(latencyNs);
+        uint64_t max = maxNs.load(std::memory_order_relaxed);
+        while (latencyNs > max &&
+               !maxNs.compare_exchange_weak(max, latencyNs,
+                                            std::memory_order_relaxed))
+        {}
+    }
+};
+
+/** @brief Number of the buckets of @ref LagStats::histogram **/
+constexpr size_t lagHistogramBuckets = 6;
+
+/** @brief Distribution of how late the timed wakeups of a loop were, which
+ * can be updated from any thread without locking **/
+struct LagStats
+{
+    /** @brief The count, total and maximal lateness [nanoseconds] **/
+    LatencyStats lag;
+    /** @brief The wakeups late by less than 100 us, 1 ms, 10 ms, 100 ms, 1 s
+     * and the later ones **/
+    std::array<Counter, lagHistogramBuckets> histogram;
+
+    void add(uint64_t lagNs) noexcept
+    {
+        lag.add(lagNs);
+        size_t bucket = 0;
+        for (uint64_t boundNs = 100000;
+             bucket + 1 < lagHistogramBuckets && lagNs >= boundNs;
+             boundNs *= 10)
+        {
+            ++bucket;
+        }
+        histogram[bucket].inc();
+    }
+};
+
+/** @brief Operational counters of a single monitored gpio pin **/
+struct PinStats
+{
+    /** @brief Edge events read from the gpio line **/
+    Counter edges;
+    /** @brief Readings of the gpio line caused by the polling period expiry **/
+    Counter polls;
+    /** @brief Polls which found the pin value different than the last
+     * reading, i.e. changes which were not signalled by an edge event **/
+    Counter pollChanges;
+    /** @brief Successful updates of the DBus property **/
+    Counter propertyWrites;
+    /** @brief Readings not published because the DBus property already had
+     * the same value **/
+    Counter writesSuppressed;
+    /** @brief Failed libgpiod calls and DBus property updates, and
+     * measurement windows dropped unpublished **/
+    Counter errors;
+    /** @brief Time from the detection of a change until its DBus property
+     * was updated **/
+    LatencyStats publishLatency;
+};
+
+/** @brief Operational counters of the service as a whole **/
+struct GlobalStats
+{
+    /** @brief Returns from the blocking waits of the gpio monitoring loops,
+     * both on events and on timeouts **/
+    Counter wakeups;
+    /** @brief Failed DBus property updates **/
+    Counter dbusSendFailures;
+    /** @brief Total time spent waiting for the DBus property update lock
+     * [nanoseconds] **/
+    Counter propMutexWaitNs;
+    /** @brief Time from the detection of a pin change until its DBus property
+     * was updated, indexed by the @ref PinPriority of the pin **/
+    std::array<LatencyStats, pinPriorityCount> publishLatency;
+    /** @brief Time from the detection of a pin transition until its actions
+     * started, see @ref GpioActions **/
+    LatencyStats actionLatency;
+    /** @brief Actions which failed or timed out **/
+    Counter actionFailures;
+    /** @brief Transitions whose actions were dropped, because the actions of
+     * too many were waiting for a worker **/
+    Counter actionsDropped;
+    /** @brief Lateness of the probe timer of the DBus server loop, see @ref
+     * GpioLoopMonitor **/
+    LagStats dbusLoopLag;
+    /** @brief Lateness of the timed out waits of the gpio monitoring loops **/
+    LagStats monitorLoopLag;
+    /** @brief Stalls of any loop longer than the stall threshold **/
+    Counter loopStalls;
+};
+
+/**
+ * @brief Owner of all the operational counters of the service and the DBus
+ * interface exposing them
+ *
+ * The set of pins is fixed at construction time, so the counters can be
+ * referenced and updated by the monitoring threads without any further
+ * synchronization. The DBus properties are computed on request only, so
+ * keeping the statistics always enabled costs no more than a relaxed atomic
+ * increment per counted operation.
+ */
+class GpioStats
+{
+  public:
+    /**
+     * @brief Create a zeroed set of @ref PinStats for every pin in
+     * @jsonConfig.
+     *
+     * The @io context is used to periodically compute the wakeups rate. It's
+     * assumed to outlive this object.
+     */
+    GpioStats(boost::asio::io_context& io, const GpioJsonConfig& jsonConfig);
+
+    /**
+     * @brief Get the counters of the pin @pinName.
+     *
+     * Throw @ref std::out_of_range if @pinName was not present in the config
+     * passed to the constructor.
+     */
+    PinStats& getPinStats(const std::string& pinName);
+
+    /** @brief Get the service-wide counters **/
+    GlobalStats& getGlobalStats();
+
+    /**
+     * @brief Mark the pin @pinName as (un)available, i.e. (not) monitored
+     * because its gpio chip is (not) present. All the pins are available
+     * initially.
+     *
+     * To be called on the DBus server thread only.
+     */
+    void setPinAvailable(const std::string& pinName, bool available);
+
+    /**
+     * @brief Mark the pin @pinName as (not) suspended, i.e. not monitored
+     * because its pin group is suspended (see @ref GpioPinGroups), so that
+     * the clients know its property is stale. No pin is suspended initially.
+     *
+     * To be called on the DBus server thread only.
+     */
+    void setPinSuspended(const std::string& pinName, bool suspended);
+
+    /**
+     * @brief Add the @interfaceName interface to the @objectPath object
+     * in @server exposing all the counters as read-only properties.
+     *
+     * Every pin gets a property named after it of the DBus type '(tttttt)'
+     * holding, in order: edges, polls, pollChanges, propertyWrites,
+     * writesSuppressed and errors (see @ref PinStats). Additionally the
+     * service-wide properties are: 'Wakeups' (t), 'WakeupsPerSecond' (d),
+     * 'DBusSendFailures' (t), 'PropertyMutexWaitNs' (t) and, for each pin
+     * priority, 'PublishLatencyNormal' and 'PublishLatencyCritical' '(ttt)':
+     * the published changes, their total and their maximal latency in
+     * nanoseconds (see @ref GlobalStats::publishLatency). The same per pin
+     * is in 'PinPublishLatency' 'a{s(ttt)}', keyed by the pin name. The names
+     * of the pins not monitored at the moment are in 'UnavailablePins' (as),
+     * which emits the 'PropertiesChanged' signal (see @ref setPinAvailable),
+     * the names of the pins of the suspended groups in 'SuspendedPins' (as),
+     * emitting it too (see @ref setPinSuspended).
+     * The actions run on the pin transitions are in 'ActionLatency' '(ttt)',
+     * 'ActionFailures' and 'ActionsDropped' 't'. The lateness of the loops is
+     * in 'DBusLoopLag' and 'MonitorLoopLag' '(ttt)', their histograms (see
+     * @ref LagStats::histogram) in 'DBusLoopLagHistogram' and
+     * 'MonitorLoopLagHistogram' 'at', and the stalls in 'LoopStalls' 't'.
+     */
+    void createDbusInterface(sdbusplus::asio::object_server& server,
+                             const std::string& objectPath,
+                             const std::string& interfaceName);
+
+  private:
+    std::map<std::string, PinStats> pinStats;
+    GlobalStats globalStats;
+
+    /** @brief See @ref setPinAvailable **/
+    std::set<std::string> unavailablePins;
+    /** @brief See @ref setPinSuspended **/
+    std::set<std::string> suspendedPins;
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface;
+    boost::asio::steady_timer rateTimer;
+    uint64_t lastWakeups = 0;
+    double wakeupsPerSec = 0.0;
+
+    void scheduleRateUpdate();
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,118 @@
+#include <gpio_status_client.hpp>
+
+#include <utility>
+#include <variant>
+
+using namespace std;
+
+namespace gpio_handler
+{
+
+/** @brief Property value types of the @ref dbusInterfaceName interface **/
+using PropertyValue = variant<bool, uint64_t>;
+
+static uint64_t toPinValue(const PropertyValue& value)
+{
+    return visit([](auto v) { return (uint64_t)v; }, value);
+}
+
+GpioStatusClient::GpioStatusClient(
+    shared_ptr<sdbusplus::asio::connection> conn,
+    const vector<string>& pinNames, Callback callback) :
+    conn(conn),
+    requestedPins(pinNames.begin(), pinNames.end()),
+    callback(std::move(callback)), alive(make_shared<bool>(true))
+{
+    namespace rules = sdbusplus::bus::match::rules;
+    propertiesChangedMatch = make_unique<sdbusplus::bus::match::match>(
+        *conn,
+        rules::sender(dbusServiceName) +
+            rules::propertiesChanged(dbusObjectPath, dbusInterfaceName),
+        [this](sdbusplus::message::message& msg) {
+            string interfaceName;
+            map<string, PropertyValue> changed;
+            msg.read(interfaceName, changed);
+            for (const auto& [pinName, value] : changed)
+            {
+                update(pinName, toPinValue(value));
+            }
+        });
+    nameOwnerChangedMatch = make_unique<sdbusplus::bus::match::match>(
+        *conn, rules::nameOwnerChanged(dbusServiceName),
+        [this](sdbusplus::message::message& msg) {
+            string name;
+            string oldOwner;
+            string newOwner;
+            msg.read(name, oldOwner, newOwner);
+            if (!newOwner.empty())
+            {
+                resynchronize();
+            }
+        });
+    resynchronize();
+}
+
+optional<uint64_t> GpioStatusClient::getValue(const string& pinName) const
+{
+    auto it = values.find(pinName);
+    if (it == values.end())
+    {
+        return nullopt;
+    }
+    return it->second;
+}
+
+const map<string, uint64_t>& GpioStatusClient::getValues() const
+{
+    return values;
+}
+
+bool GpioStatusClient::isSynchronized() const
+{
+    return synchronized;
+}
+
+void GpioStatusClient::resynchronize()
+{
+    weak_ptr<bool> weakAlive = alive;
+    conn->async_method_call(
+        [this, weakAlive](const boost::system::error_code& ec,
+                          [[maybe_unused]] bool fullResync,
+                          uint64_t currentGeneration,
+                          const map<string, PropertyValue>& props) {
+            // The service not being on the bus yet is not an error, the
+            // 'NameOwnerChanged' signal will trigger the synchronization
+            if (weakAlive.expired() || ec)
+            {
+                return;
+            }
+            // Either way 'props' brings the cache up to 'currentGeneration'
+            for (const auto& [pinName, value] : props)
+            {
+                update(pinName, toPinValue(value));
+            }
+            generation = currentGeneration;
+            synchronized = true;
+        },
+        dbusServiceName, dbusObjectPath, dbusChangeLogInterfaceName,
+        "GetChangesSince", generation);
+}
+
+void GpioStatusClient::update(const string& pinName, uint64_t value)
+{
+    if (!requestedPins.empty() && !requestedPins.contains(pinName))
+    {
+        return;
+    }
+    auto it = values.find(pinName);
+    if (it == values.end() || it->second != value)
+    {
+        values[pinName] = value;
+        if (callback)
+        {
+            callback(pinName, value);
+        }
+    }
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <gpio_status_dbus.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/bus/match.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Client side cache of the pin states published by the service on the
+ * @ref dbusInterfaceName interface
+ *
+ * Instead of polling the properties with 'Get' the client fetches all of them
+ * once with a single 'GetChangesSince' call (see @ref
+ * dbusChangeLogInterfaceName) and then follows the 'PropertiesChanged'
+ * signals of the service. The match rule is restricted to the service's
+ * sender, object path and the @ref dbusInterfaceName interface, so the client
+ * doesn't wake up on the changes of any other interface. The property names
+ * can't be expressed in a match rule, so the changes of the pins the client
+ * didn't ask for are dropped on arrival.
+ *
+ * When the service (re)appears on the bus, or @ref resynchronize is called, the
+ * cache is synchronized again with 'GetChangesSince', passing the generation
+ * of the last synchronization. Only the pins changed since then are
+ * transferred, unless the service doesn't have all those changes logged
+ * anymore (or was restarted), in which case it sends all of them.
+ *
+ * The signals and the 'GetChangesSince' reply are processed in the order of
+ * their arrival, which is the order the service sent them in, so the cache
+ * never goes back to an older state.
+ *
+ * The values are cached as unsigned integers: 0 or 1 for the boolean pin
+ * properties, the whole bus value for the multi-bit bus properties and the
+ * measured values of the pins in the "measure" mode.
+ *
+ * All the work is done, and the callback is called, on the thread running the
+ * io context of the connection. The class is not thread-safe.
+ *
+ * Example:
+ *
+ *   auto conn = std::make_shared<sdbusplus::asio::connection>(io);
+ *   gpio_handler::GpioStatusClient client(
+ *       conn, {"I2C3_ALERT", "I2C4_ALERT"},
+ *       [](const std::string& pinName, bool value) {
+ *           std::cout << pinName << " = " << value << std::endl;
+ *       });
+ *   io.run();
+ */
+class GpioStatusClient
+{
+  public:
+    /** @brief Called when the cached value of a pin changed **/
+    using Callback =
+        std::function<void(const std::string& pinName, uint64_t value)>;
+
+    /**
+     * @brief Subscribe to the changes of the @pinNames and request their
+     * current values.
+     *
+     * An empty @pinNames means all the pins the service publishes. The
+     * @callback is called for every pin whose value became known or changed,
+     * including the values obtained by the initial synchronization.
+     */
+    GpioStatusClient(std::shared_ptr<sdbusplus::asio::connection> conn,
+                     const std::vector<std::string>& pinNames,
+                     Callback callback);
+
+    /**
+     * @brief Get the cached value of @pinName. Empty if not known yet or if
+     * the pin was not requested in the constructor.
+     */
+    std::optional<uint64_t> getValue(const std::string& pinName) const;
+
+    /** @brief Get all the cached pin values **/
+    const std::map<std::string, uint64_t>& getValues() const;
+
+    /** @brief True if the cache was synchronized with the service at least
+     * once **/
+    bool isSynchronized() const;
+
+    /** @brief Request the values of the pins changed since the last
+     * synchronization **/
+    void resynchronize();
+
+  private:
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::set<std::string> requestedPins;
+    Callback callback;
+    std::map<std::string, uint64_t> values;
+    bool synchronized = false;
+    /** @brief Generation of the service's change log at the last
+     * synchronization, 0 if none **/
+    uint64_t generation = 0;
+    std::unique_ptr<sdbusplus::bus::match::match> propertiesChangedMatch;
+    std::unique_ptr<sdbusplus::bus::match::match> nameOwnerChangedMatch;
+    /** @brief Lets the pending 'GetChangesSince' callbacks know if the object
+     * is still alive **/
+    std::shared_ptr<bool> alive;
+
+    void update(const std::string& pinName, uint64_t value);
+};
+
+} // namespace gpio_handler
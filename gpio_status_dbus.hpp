@@ -0,0 +1,41 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * The DBus names under which the service is available, shared by the service
+ * and its clients (see gpio_status_client.hpp).
+ */
+
+namespace gpio_handler
+{
+
+/** @brief The well-known name requested by the service **/
+constexpr auto dbusServiceName = "xyz.openbmc_project.GpioStatusHandler";
+
+/** @brief The only object provided by the service **/
+constexpr auto dbusObjectPath = "/xyz/openbmc_project/GpioStatusHandler";
+
+/** @brief Interface with a property per monitored pin reflecting its state **/
+constexpr auto dbusInterfaceName = "xyz.openbmc_project.GpioStatus";
+
+/** @brief Interface with the operational counters of the service **/
+constexpr auto dbusStatsInterfaceName = "xyz.openbmc_project.GpioStatus.Stats";
+
+/** @brief Interface with the generation numbered log of the pin changes **/
+constexpr auto dbusChangeLogInterfaceName =
+    "xyz.openbmc_project.GpioStatus.ChangeLog";
+
+/** @brief Interface with the first faults latched per fault group **/
+constexpr auto dbusFaultGroupsInterfaceName =
+    "xyz.openbmc_project.GpioStatus.FaultGroups";
+
+/** @brief Interface setting the output pins **/
+constexpr auto dbusOutputsInterfaceName =
+    "xyz.openbmc_project.GpioStatus.Outputs";
+
+/** @brief Interface suspending and resuming the pin groups **/
+constexpr auto dbusPinGroupsInterfaceName =
+    "xyz.openbmc_project.GpioStatus.PinGroups";
+
+} // namespace gpio_handler
@@ -1,15 +1,44 @@
 
+#include <boost/asio/steady_timer.hpp>
+#include <gpio_actions.hpp>
+#include <gpio_alloc_count.hpp>
+#include <gpio_change_log.hpp>
 #include <gpio_chips.hpp>
+#include <gpio_event_stream.hpp>
+#include <gpio_fault_groups.hpp>
+#include <gpio_flight_recorder.hpp>
+#include <gpio_hotplug.hpp>
+#ifdef EMBEDDED_GPIO_CONFIG
+#include <gpio_embedded_config.hpp>
+#endif
 #include <gpio_json_config.hpp>
+#include <gpio_line_names.hpp>
 #include <gpio_lines.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_outputs.hpp>
+#include <gpio_pin_groups.hpp>
+#include <gpio_pin_threads.hpp>
+#include <gpio_publisher.hpp>
+#include <gpio_reply_cache.hpp>
+#include <gpio_stats.hpp>
+#include <gpio_status_dbus.hpp>
 #include <gpio_status_handler.hpp>
+#ifdef SANDBOX_MODE
+#include <gpio_trace.hpp>
+#endif
 #include <gpio_utils.hpp>
+#include <gpio_workers.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <sdbusplus/server.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <unistd.h>
 
+#include <chrono>
 #include <fstream>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <thread>
 
@@ -21,22 +50,28 @@ using phosphor::logging::entry;
 using phosphor::logging::level;
 using phosphor::logging::log;
 
-constexpr auto dbusObjectPath = "/xyz/openbmc_project/GpioStatusHandler";
-constexpr auto dbusServiceName = "xyz.openbmc_project.GpioStatusHandler";
-constexpr auto dbusInterfaceName = "xyz.openbmc_project.GpioStatus";
+/** @brief Number of the last published changes kept for 'GetChangesSince' **/
+constexpr size_t changeLogCapacity = 1024;
 
-/**
- * @brief Second argument to @gpiod_line_event_wait function
- *
- * Specifies also the maximal resolution of the
- * @GpioJsonConfig::configKeyReadPeriod parameter given in the config file.
- */
-constexpr uint64_t lineEventWaitTimeoutNs = 1e8l; // [nanoseconds]
+/** @brief Capacity of the flight recorder, 2 MiB of records **/
+constexpr uint32_t flightRecorderRecords = 65536;
+
+/** @brief Default number of the threads running the actions of the pin
+ * transitions **/
+constexpr unsigned defaultActionWorkers = 2;
+
+/** @brief Default duration of a loop stall worth reporting [seconds] **/
+constexpr double defaultStallThresholdSec = 1.0;
+
+/** @brief Default line reads per second allowed per gpio chip behind a bus,
+ * see @ref BusReadPolicy **/
+constexpr double defaultBusTransactionsPerSec = 100;
+
+/** @brief The polls of the pins on a chip behind a bus due within this window
+ * are merged into one chip read [nanoseconds] **/
+constexpr uint64_t busReadMergeWindowNs = lineEventWaitTimeoutNs;
 
 static boost::asio::io_context io;
-static volatile bool runThreads;
-static std::mutex setDBusPropMutex;
-static exception_ptr lastThreadException;
 static int threadsExitCode;
 
 void stopService(int exitCode)
@@ -49,290 +84,229 @@ void stopService(int exitCode)
     io.stop();
 }
 
-bool setDBusProperty(shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface,
-                     const string& pinName, const string& chipName, int pinNum,
-                     bool pinValue) noexcept
+#ifdef SANDBOX_MODE
+/**
+ * @brief Entry function for the trace replay thread
+ *
+ * Feed the edges recorded in @traceReader through the same event path the gpio
+ * monitoring threads use (@publisher), without any gpio hardware. The trace
+ * pins are matched by name against the @pins. Records of the pins missing in
+ * the config are skipped.
+ *
+ * The events are paced according to their recorded timestamps, @speed times
+ * faster than recorded. Zero @speed replays the trace as fast as possible.
+ *
+ * The publish latency of an event is measured from the moment it was due (or
+ * picked up, when replaying at the maximal speed) until its DBus property was
+ * updated. When the trace ends the throughput and latency figures are logged
+ * and the service is stopped with exit code 0.
+ *
+ * Replaying a trace runs the whole steady state publishing path, so any heap
+ * allocation in it is reported at the exit, see @ref
+ * logSteadyStateAllocations.
+ *
+ * @param[in,out] publisher
+ * @param[in,out] pins
+ * @param[in,out] traceReader
+ * @param[in] speed
+ */
+void replayTrace(GpioPublisher& publisher, vector<MonitoredPin>& pins,
+                 TraceReader& traceReader, double speed)
 {
-    bool success = false;
+    map<string, MonitoredPin*> pinsByName;
+    for (auto& pin : pins)
     {
-        lock_guard<mutex> lock(setDBusPropMutex);
-#ifdef ENABLE_GSH_LOGS
-        /* TODO: this log message is notice only - it should not be called
-           always, but only if verbosity level is set to level notice at least.
-            Additionally, it should be called only if the pin value is changed.
-         */
-        {
-            stringstream ss;
-            ss << "Setting '" << dbusInterfaceName << "." << pinName << "' <- "
-               << pinValue;
-            logPinOperation<level::INFO>(ss.str().c_str(), pinName, chipName,
-                                         pinNum);
-        }
-#endif
-        try
+        pinsByName[pin.pinName] = &pin;
+    }
+    // Indexed by 'TraceRecord::pinIndex'
+    vector<MonitoredPin*> tracePins;
+    for (const auto& pinName : traceReader.getPinNames())
+    {
+        auto it = pinsByName.find(pinName);
+        if (it != pinsByName.end())
         {
-            dbusInterface->set_property(pinName, pinValue);
-            success = true;
+            tracePins.push_back(it->second);
         }
-        catch (...) // Catch most possible number of exceptions
+        else
         {
-            lastThreadException = std::current_exception();
-            success = false;
+            logPinOperation<level::WARNING>(
+                "Traced pin not present in the config, its events are skipped",
+                pinName);
+            tracePins.push_back(nullptr);
         }
     }
-    if (!success)
-    {
-        stringstream ss;
-        ss << "Unable to set the property '" << dbusInterface << "." << pinName
-           << "' to " << pinValue;
-        logPinOperation<level::ERR>(ss.str().c_str(), pinName, chipName,
-                                    pinNum);
-    }
-    return success;
-}
 
-/**
- * @brief Entry function for the gpio monitoring threads
- *
- * The dbus property update scheme is a mix of polling and event detection. So
- * basically the change of the pin should result in an immediate change of the
- * dbus property, but there is also periodic polling "just in case", specified
- * per gpio line by the "read_period_sec", setting the lower bound for gpio
- * refresh rate.
- *
- * To understand it better consider the following graph:
- *
- *
- * Timeline
- * GPIO line:
- *                                  state change
- * 1                                      --------------------------------------
- *                                       /
- * 0 ------------------------------------
- *
- * Loop iteratons                              timeout period
- * (no longer than timeout):                      <----->
- *   |-------|-------|-------|------|----|-------|-------|-------|------|-------
- *
- * Readings:
- *   ^------------------------------^----^------------------------------^-------
- *   0                              0    1                              1
- *    <---------------------------->      <---------------------------->
- *          polling period                        polling period
- *
- * DBus property:                   event detected
- * t                                      --------------------------------------
- *                                       /
- * f ------------------------------------
- *
- *
- * The correspondence to the parameters is as follows:
- * "GPIO line" : specified by parameters @chip and @line.
- * "state change" : detected in 'gpiod_line_event_wait' call inside this
- * function.
- * "timeout period" = @lineEventWaitTimeoutNs
- * "polling period" = @readPeriodTicks
- * "DBus property" : the @pinName property on the DBus interface @dbusInterface
- *
- * The function can stop execution at discrete points spaced by "timeot period"
- * or gpio pin state change (and only then) in case: 1. global @runThreads was
- * set to false by different thread, 2. error occured when calling any of the
- * functions 'gpiod_line_event_wait' or 'gpiod_line_get_value' from the gpiod
- * library, 3. an error occured when calling 'set_property' function on the
- * @dbusInterface object. Otherwise the function continue to run. No exceptions
- * are ever thrown.
- *
- * @param[in] dbusInterface The DBus interface for which the @pinName boolean
- * property is expected to exist and will be updated according to the state of
- * the monitored gpio pin.
- * @param[in] line
- * @param[in] chipName
- * @param[in] pinName
- * @param[in] pinNum
- * @param[in] readPeriodTicks
- */
-void syncAlertGpioPin(
-    shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface,
-    gpiod_line_t* line, const string& chipName, const string& pinName,
-    unsigned pinNum,
-    uint64_t readPeriodTicks // [nanoseconds / lineEventWaitTimeoutNs]
-)
-{
-    struct timespec timeout
-    {
-        lineEventWaitTimeoutNs / 1000000000, lineEventWaitTimeoutNs % 1000000000
-    };
-
-    struct gpiod_line_event event;
-
-    uint64_t ticks = 0;
-    bool setDBusPropOk = true;
-    int lineGetResult = 0;
-    // -1: error
-    //  0: pin low
-    //  1: pin high
-    int waitResult = 0;
-    // waitResult:
-    // -1: error
-    //  0: timeout
-    //  1: event
-    while (runThreads && lineGetResult >= 0 && setDBusPropOk && waitResult >= 0)
+    GlobalStats& globalStats = publisher.getGlobalStats();
+    TraceRecord record;
+    uint64_t firstTimestampNs = 0;
+    uint64_t events = 0;
+    uint64_t skipped = 0;
+    chrono::nanoseconds totalLatency(0);
+    chrono::nanoseconds maxLatency(0);
+    auto start = chrono::steady_clock::now();
+    bool replayOk = true;
+    try
     {
-        // in case of an event or full period round
-        if (waitResult > 0 || ticks == 0)
+        SteadyStateScope steadyState;
+        while (runThreads && replayOk && traceReader.next(record))
         {
-            // Start a new period, no matter if triggered by the
-            // last one or an event
-            ticks = 0;
-            lineGetResult = gpiod_line_get_value(line);
-            if (lineGetResult >= 0)
+            if (events + skipped == 0)
             {
-                setDBusPropOk =
-                    setDBusProperty(dbusInterface, pinName, chipName, pinNum,
-                                    lineGetResult != 0);
+                firstTimestampNs = record.timestampNs;
+                start = chrono::steady_clock::now();
             }
-            else
+            auto due = chrono::steady_clock::now();
+            if (speed > 0)
             {
-                int lastErrno = errno;
-                stringstream funcall;
-                funcall << "gpiod_line_get_value(<" << chipName << " " << pinNum
-                        << ">)";
-                logLibgpioCallError(funcall, lineGetResult, lastErrno, pinName,
-                                    chipName, pinNum);
+                // Records of different pins may be slightly out of order
+                uint64_t sinceFirstNs =
+                    record.timestampNs > firstTimestampNs
+                        ? record.timestampNs - firstTimestampNs
+                        : 0;
+                due = start + chrono::nanoseconds((uint64_t)(sinceFirstNs /
+                                                             speed));
+                this_thread::sleep_until(due);
+                globalStats.wakeups.inc();
             }
-        }
-        if (lineGetResult >= 0 && setDBusPropOk)
-        {
-            waitResult = gpiod_line_event_wait(line, &timeout);
-            if (waitResult > 0)
+            if (record.pinIndex < tracePins.size() &&
+                tracePins[record.pinIndex] != nullptr)
             {
-                // Use it only to clear the event flags, the
-                // actual values of the pins will be obtained by
-                // 'gpiod_line_get_value'
-                gpiod_line_event_read(line, &event);
+                MonitoredPin& pin = *tracePins[record.pinIndex];
+                struct gpiod_line_event event;
+                event.ts.tv_sec = record.timestampNs / 1000000000;
+                event.ts.tv_nsec = record.timestampNs % 1000000000;
+                event.event_type = record.level != 0
+                                       ? GPIOD_LINE_EVENT_RISING_EDGE
+                                       : GPIOD_LINE_EVENT_FALLING_EDGE;
+                publisher.onEdge(pin, record.bit, event);
+                if (pin.meter)
+                {
+                    // Measured on the recorded timeline, the windows are
+                    // closed by the edges only
+                    PinMeasurement measurement;
+                    while (replayOk && pin.meter->closeWindow(
+                                           record.timestampNs, measurement))
+                    {
+                        replayOk = publisher.publishMeasurement(
+                            pin, measurement, EdgeMeter::nowNs());
+                    }
+                    pin.meter->onEdge(record.timestampNs, record.level != 0);
+                }
+                else
+                {
+                    // A bus edge changes a single bit of the published value
+                    uint64_t mask = 1ull << (record.bit % 64);
+                    uint64_t value = record.level != 0
+                                         ? pin.publishedValue | mask
+                                         : pin.publishedValue & ~mask;
+                    replayOk =
+                        publisher.publish(pin, value, EdgeMeter::nowNs());
+                }
+                auto latency = chrono::steady_clock::now() - due;
+                totalLatency += latency;
+                maxLatency = max(maxLatency, latency);
+                ++events;
             }
-            else if (waitResult < 0)
+            else
             {
-                int lastErrno = errno;
-                stringstream funcall;
-                funcall << "gpiod_line_event_wait(<" << chipName << " "
-                        << pinNum << ">, " << lineEventWaitTimeoutNs << " ns)";
-                logLibgpioCallError(funcall, waitResult, lastErrno, pinName,
-                                    chipName, pinNum);
+                ++skipped;
             }
-            // otherwise timeout
         }
-        // if condition not met the loop will end in next iteration
-        ticks = (ticks + 1) % readPeriodTicks;
     }
-    // If the loop exited for any other reason than globally stopped threads
-    // then globally stop the threads.
+    catch (const std::exception& e)
+    {
+        log<level::ERR>("Exception caught while replaying the trace",
+                        entry("EXCEPTION=%s", e.what()));
+        replayOk = false;
+    }
+
+    double elapsedSec =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stringstream ss;
+    ss << "Trace replay finished: " << events << " events published ("
+       << skipped << " skipped) in " << elapsedSec << " s, "
+       << (elapsedSec > 0 ? events / elapsedSec : 0) << " events/s, "
+       << "publish latency avg "
+       << (events > 0 ? totalLatency.count() / events : 0) << " ns, max "
+       << maxLatency.count() << " ns";
+    log<level::INFO>(ss.str().c_str());
     if (runThreads)
     {
-        stopService(1);
+        stopService(replayOk ? 0 : 1);
     }
 }
 
 /**
- * @brief Block until all the all threads in @threads finished execution
+ * @brief Start the thread replaying the @traceReader trace and append it at the
+ * end of the @threads.
  *
- * After the function returns all threads in @threads are no longer joinable.
- *
- * @param[in,out] threads
+ * @param[out] threads
+ * @param[in,out] publisher
+ * @param[in,out] pins
+ * @param[in,out] traceReader
+ * @param[in] speed
  */
-void finishThreads(vector<thread>& threads)
+void startReplayThread(vector<thread>& threads, GpioPublisher& publisher,
+                       vector<MonitoredPin>& pins, TraceReader& traceReader,
+                       double speed)
 {
-    for (auto i = 0u; i < threads.size(); ++i)
-    {
 #ifdef ENABLE_GSH_LOGS
-        {
-            stringstream ss;
-            ss << "Waiting for thread #" << i << endl;
-            log<level::INFO>(ss.str().c_str());
-        }
+    log<level::INFO>("Starting trace replay thread");
 #endif
-        threads[i].join();
-    }
+    runThreads = true;
+    threads.push_back(thread(replayTrace, ref(publisher), ref(pins),
+                             ref(traceReader), speed));
 }
 
 /**
- * Start a thread for each key in @dbusPropMapLineObj monitoring the associated
- * gpio pin. Append the @thread object at the end of the @threads. All threads
- * in @threads are joinable.
- *
- * @param[out] threads
- * @param[in] dbusInterface
- * @param[in] dbusPropMapLineObj
- * @param[in] gpioConfig
+ * @brief Log an error if the monitoring threads made any heap allocation in
+ * their steady state, see @ref SteadyStateScope.
  */
-void startThreads(vector<thread>& threads,
-                  shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface,
-                  const map<string, gpiod_line_t*>& dbusPropMapLineObj,
-                  const GpioJsonConfig& gpioConfig)
+void logSteadyStateAllocations()
 {
-#ifdef ENABLE_GSH_LOGS
-    log<level::INFO>("Starting gpio pins monitoring threads");
-#endif
-    runThreads = true;
-    if (!dbusPropMapLineObj.empty())
+    uint64_t allocations = getSteadyStateAllocations();
+    if (allocations > 0)
     {
-        for (auto it = dbusPropMapLineObj.cbegin();
-             it != dbusPropMapLineObj.cend(); ++it)
-        {
-            string pinName = it->first;
-            gpiod_line_t* line = it->second;
-            gpiod_chip_t* chip = gpiod_line_get_chip(line);
-            string chipName = gpiod_chip_name(chip);
-            unsigned pinNum = gpiod_line_offset(line);
-            double readPeriodSec =
-                gpioConfig
-                    .getConfig()[pinName][GpioJsonConfig::configKeyReadPeriod];
-            uint64_t readPeriodTicks =
-                max((uint64_t)1,
-                    (uint64_t)(readPeriodSec * 1e9 / lineEventWaitTimeoutNs));
-#ifdef ENABLE_GSH_LOGS
-            {
-                stringstream ss;
-                ss << "Setting up thread for:" << endl;
-                ss << "  pin_name = " << pinName << endl;
-                ss << "  " << GpioJsonConfig::configKeyGpioPin << " = "
-                   << pinNum << endl;
-                ss << "  " << GpioJsonConfig::configKeyGpioChip << " = "
-                   << chipName << endl;
-                ss << "  " << GpioJsonConfig::configKeyReadPeriod << " = "
-                   << readPeriodSec << endl;
-                ss << "  readPeriodTicks = " << readPeriodTicks;
-                logPinOperation<level::INFO>(ss.str().c_str(), pinName,
-                                             chipName, pinNum);
-            }
-#endif
-            threads.push_back(thread(syncAlertGpioPin, dbusInterface, line,
-                                     chipName, pinName, pinNum,
-                                     readPeriodTicks));
-#ifdef ENABLE_GSH_LOGS
-            log<level::INFO>("Thread started");
-#endif
-        }
-    }
-    else // ! !dbusPropMapLineObj.empty()
-    {
-        log<level::WARNING>("No gpio pins monitored");
+        stringstream ss;
+        ss << allocations << " heap allocations made in the steady state "
+           << "of the gpio monitoring threads";
+        log<level::ERR>(ss.str().c_str());
     }
 }
+#endif // SANDBOX_MODE
 
 /**
  * @brief Create the DBus object containing the properties corresponding to the
  * monitored gpio pins
  *
+ * The object implements also the @dbusStatsInterfaceName interface exposing
+ * the counters from @gpioStats and the @dbusChangeLogInterfaceName interface
+ * exposing the @changeLog, plus the @dbusFaultGroupsInterfaceName interface
+ * exposing the @faultGroups, the @dbusOutputsInterfaceName interface setting
+ * the @outputs and the @dbusPinGroupsInterfaceName interface suspending the
+ * @pinGroups, unless NULL. The 'GetAll' calls of the pin properties
+ * and the 'Introspect' calls of the object are answered by the @replyCache.
+ *
  * @param[out] io
  * @param[in] gpioConfig
- *
- * @return A pointer to the dbus interface with the properties set, all boolean,
- * corresponding to the attribute names in @gpioConfig.getConfig().
+ * @param[in,out] gpioStats
+ * @param[in,out] changeLog
+ * @param[in,out] faultGroups
+ * @param[in,out] outputs
+ * @param[in,out] pinGroups
+ * @param[out] replyCache
+ *
+ * @return A pointer to the dbus interface with the properties set, boolean for
+ * the pins and unsigned 64-bit integer for the buses and the measurements,
+ * corresponding to the entries in @gpioConfig.getPins() (see @ref
+ * GpioJsonConfig::getProperties). Their values are read from @changeLog.
  */
 shared_ptr<sdbusplus::asio::dbus_interface>
     createDbusObject(boost::asio::io_context& io,
-                     const GpioJsonConfig& gpioConfig)
+                     const GpioJsonConfig& gpioConfig, GpioStats& gpioStats,
+                     GpioChangeLog& changeLog, GpioFaultGroups* faultGroups,
+                     GpioOutputs* outputs, GpioPinGroups* pinGroups,
+                     optional<GpioReplyCache>& replyCache)
 {
     auto conn = make_shared<sdbusplus::asio::connection>(io);
 #ifdef ENABLE_GSH_LOGS
@@ -346,24 +320,140 @@ shared_ptr<sdbusplus::asio::dbus_interface>
     auto server = sdbusplus::asio::object_server(conn);
     auto dbusInterface =
         server.add_interface(dbusObjectPath, dbusInterfaceName);
-    for (auto it = gpioConfig.getConfig().cbegin();
-         it != gpioConfig.getConfig().cend(); ++it)
+    // The values are kept by the change log only, the publishers just signal
+    // the changes (see @ref GpioPublisher)
+    uint16_t propertyIndex = 0;
+    for (const auto& pin : gpioConfig.getPins())
     {
-        dbusInterface->register_property(
-            it.key(), (bool)it.value()[GpioJsonConfig::configKeyInitialPinVal],
-            sdbusplus::asio::PropertyPermission::readOnly);
+        for (const auto& property : GpioJsonConfig::getProperties(pin))
+        {
+            GpioChangeLog* changes = &changeLog;
+            if (property.isInteger)
+            {
+                dbusInterface->register_property_r(
+                    property.name, property.initial,
+                    sdbusplus::vtable::property_::emits_change,
+                    [changes, propertyIndex](const uint64_t&) {
+                        return changes->getValue(propertyIndex);
+                    });
+            }
+            else
+            {
+                dbusInterface->register_property_r(
+                    property.name, property.initial != 0,
+                    sdbusplus::vtable::property_::emits_change,
+                    [changes, propertyIndex](const bool&) {
+                        return changes->getValue(propertyIndex) != 0;
+                    });
+            }
+            ++propertyIndex;
+        }
     }
     dbusInterface->initialize();
+    gpioStats.createDbusInterface(server, dbusObjectPath,
+                                  dbusStatsInterfaceName);
+    changeLog.createDbusInterface(server, dbusObjectPath,
+                                  dbusChangeLogInterfaceName);
+    if (faultGroups != nullptr)
+    {
+        faultGroups->createDbusInterface(server, dbusObjectPath,
+                                         dbusFaultGroupsInterfaceName);
+    }
+    if (outputs != nullptr)
+    {
+        outputs->createDbusInterface(server, dbusObjectPath,
+                                     dbusOutputsInterfaceName);
+    }
+    if (pinGroups != nullptr)
+    {
+        pinGroups->createDbusInterface(server, dbusObjectPath,
+                                       dbusPinGroupsInterfaceName);
+    }
+    // Once all the interfaces are there, for the introspection data
+    replyCache.emplace(conn, dbusServiceName, dbusObjectPath,
+                       dbusInterfaceName, gpioConfig, changeLog);
     return dbusInterface;
 }
 
-void showLastThreadException()
+/**
+ * @brief Log the summaries of the repeated journal entries every @ref
+ * repeatedLogPeriod on the thread running the @timer context.
+ */
+void scheduleRepeatedLogSummaries(boost::asio::steady_timer& timer)
+{
+    timer.expires_after(repeatedLogPeriod);
+    timer.async_wait([&timer](const boost::system::error_code& ec) {
+        if (!ec)
+        {
+            logRepeatedSummaries();
+            scheduleRepeatedLogSummaries(timer);
+        }
+    });
+}
+
+/**
+ * @brief Get the read policy of the gpio chips of the @pins which are behind an
+ * I2C or SPI bus (see @ref isBusAttachedChip), allowing each
+ * @transactionsPerSec line reads per second.
+ */
+BusReadPolicy getBusReadPolicy(const vector<MonitoredPin>& pins,
+                               double transactionsPerSec)
+{
+    BusReadPolicy policy;
+    policy.transactionsPerSec = transactionsPerSec;
+    policy.mergeWindowNs = busReadMergeWindowNs;
+    for (const auto& pin : pins)
+    {
+        if (!policy.chipNames.contains(pin.chipName) &&
+            isBusAttachedChip(pin.chipName))
+        {
+            policy.chipNames.insert(pin.chipName);
+#ifdef ENABLE_GSH_LOGS
+            log<level::INFO>("Gpio chip behind a bus, its reads are merged",
+                             chipEntry(pin.chipName));
+#endif
+        }
+    }
+    return policy;
+}
+
+/**
+ * @brief Create the @recorder in @fileName for the pins and the properties of
+ * @gpioConfig and start appending the edges and the changes handled by the
+ * @publisher to it.
+ */
+void startFlightRecorder(optional<FlightRecorder>& recorder,
+                         const string& fileName,
+                         const GpioJsonConfig& gpioConfig,
+                         GpioPublisher& publisher)
+{
+    // Indexed by 'MonitoredPin::pinIndex' and 'MonitoredPin::propertyIndex'
+    vector<string> pinNames;
+    vector<string> propertyNames;
+    for (const auto& pin : gpioConfig.getPins())
+    {
+        pinNames.push_back(pin.name);
+        for (const auto& property : GpioJsonConfig::getProperties(pin))
+        {
+            propertyNames.push_back(property.name);
+        }
+    }
+    recorder.emplace(fileName, pinNames, propertyNames,
+                     flightRecorderRecords);
+    publisher.setFlightRecorder(&*recorder);
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Flight recorder started",
+                     entry("FILE=%s", fileName.c_str()));
+#endif
+}
+
+void showLastThreadException(const GpioPublisher& publisher)
 {
     try
     {
-        if (lastThreadException != NULL)
+        if (publisher.getLastException() != NULL)
         {
-            std::rethrow_exception(lastThreadException);
+            std::rethrow_exception(publisher.getLastException());
         }
     }
     catch (const std::exception& e)
@@ -394,6 +484,12 @@ void showLastThreadException()
  *   }
  * }
  *
+ * An entry may list "gpio_pins" instead of "gpio_pin", making a multi-bit bus
+ * published as a single unsigned integer property (see @ref GpioJsonConfig).
+ *
+ * In the builds with the 'embedded_config' meson option the config is the
+ * @ref embeddedGpioConfig table instead, and no file argument is expected.
+ *
  * Stop the program if config is malformed.
  *
  * Open all the chips specified in the config ("/dev/gpiochip0" in this case).
@@ -412,7 +508,10 @@ void showLastThreadException()
  *      line 111:      unnamed       unused   input  active-high
  *   ...
  *
- * Stop the program if any of those operations failed.
+ * Stop the program if any of those operations failed, except for the chips
+ * which don't exist (yet): their pins are listed in the 'UnavailablePins'
+ * statistics property and attached as soon as the chip appears, watched for
+ * by the uevents of the kernel (see @ref GpioHotplug).
  *
  * Create the DBus service "xyz.openbmc_project.GpioStatusHandler" providing
  * DBus object "/xyz/openbmc_project/GpioStatusHandler" implementing
@@ -431,14 +530,41 @@ void showLastThreadException()
  * DBus error occured.
  *
  * Start the DBus server thread and a monitoring thread per every pin specified
- * in the config (2 in this case). Run forever reflecting the state of the pins
- * on the "xyz.openbmc_project.GpioStatus" interface:
+ * in the config (2 in this case), or, if the '-w <workers>' option was given,
+ * the given number of worker threads serving the pins of disjoint sets of gpio
+ * chips (see @ref GpioWorkerPool), merging the reads of the chips behind an I2C
+ * or SPI bus within the '-t <reads/s>' budget, and, with the '-u' option,
+ * reading the edges through an io_uring per worker (see @ref GpioEventRing).
+ * Run forever reflecting the state of the pins on the
+ * "xyz.openbmc_project.GpioStatus" interface:
  *
  *   0 -> false
  *   1 -> true
  *
+ * and of the buses as the integers composed of their lines' values, the first
+ * line of the "gpio_pins" being the least significant bit.
+ *
+ * With the '-f <file>' option keep the last edges and published changes in a
+ * memory-mapped flight recorder file (see @ref FlightRecorder), readable with
+ * 'gsh-flight-decode' also after a crash of the service. With the
+ * '-e <socket>' option stream every edge to the local subscribers of the Unix
+ * socket (see @ref GpioEventStream). The actions of the pin transitions listed
+ * in the config are run by the '-a <workers>' threads (see @ref GpioActions).
+ * The first faults of the fault groups listed in the config are latched on
+ * the @ref dbusFaultGroupsInterfaceName interface (see @ref GpioFaultGroups).
+ * The output pins listed in the config are not monitored, they are set by the
+ * 'SetPins' method of the @ref dbusOutputsInterfaceName interface (see @ref
+ * GpioOutputs). The monitoring of the pin groups listed in the config is
+ * suspended and resumed by the methods of the @ref dbusPinGroupsInterfaceName
+ * interface (see @ref GpioPinGroups).
+ * The stalls of the loops longer than '-l <seconds>' are reported, and the
+ * systemd watchdog, if enabled, is pinged while no loop is stalled (see @ref
+ * GpioLoopMonitor).
+ *
  * Stop the service althogether if any reading operation on the gpio line
- * failed.
+ * failed, unless the chip of the line was removed and the pin is served by a
+ * thread of its own: the pin is detached and marked unavailable then, until
+ * the chip appears again.
  *
  *
  * All the output of the program goes to 'systemd-journald'. Use
@@ -485,23 +611,284 @@ void showLastThreadException()
 int main(int argc, char* argv[])
 {
     int mainResult;
-    if (argc > 1)
+    // 0: thread per pin
+    unsigned workerCount = 0;
+    bool ioUring = false;
+#ifdef SANDBOX_MODE
+    string recordFileName;
+    string replayFileName;
+    double replaySpeed = 1.0;
+    const char* optString = "w:ut:f:e:a:l:r:p:s:";
+#else
+    const char* optString = "w:ut:f:e:a:l:";
+#endif
+    string flightRecorderFileName;
+    string eventStreamSocketPath;
+    unsigned actionWorkerCount = defaultActionWorkers;
+    double stallThresholdSec = defaultStallThresholdSec;
+    double busTransactionsPerSec = defaultBusTransactionsPerSec;
+    bool argsGood = true;
+    int opt;
+    while ((opt = getopt(argc, argv, optString)) != -1)
+    {
+        switch (opt)
+        {
+            case 'w':
+            {
+                char* end = nullptr;
+                workerCount = strtoul(optarg, &end, 10);
+                argsGood = argsGood && *end == '\0';
+                break;
+            }
+            case 'u':
+#ifdef IO_URING_BACKEND
+                ioUring = true;
+#else
+                // Built without the io_uring support
+                argsGood = false;
+#endif
+                break;
+            case 't':
+            {
+                char* end = nullptr;
+                busTransactionsPerSec = strtod(optarg, &end);
+                argsGood = argsGood && *end == '\0' &&
+                           busTransactionsPerSec >= 0;
+                break;
+            }
+            case 'f':
+                flightRecorderFileName = optarg;
+                break;
+            case 'e':
+                eventStreamSocketPath = optarg;
+                break;
+            case 'a':
+            {
+                char* end = nullptr;
+                actionWorkerCount = strtoul(optarg, &end, 10);
+                argsGood = argsGood && *end == '\0' && actionWorkerCount > 0;
+                break;
+            }
+            case 'l':
+            {
+                char* end = nullptr;
+                stallThresholdSec = strtod(optarg, &end);
+                argsGood = argsGood && *end == '\0' && stallThresholdSec > 0;
+                break;
+            }
+#ifdef SANDBOX_MODE
+            case 'r':
+                recordFileName = optarg;
+                break;
+            case 'p':
+                replayFileName = optarg;
+                break;
+            case 's':
+            {
+                char* end = nullptr;
+                replaySpeed = strtod(optarg, &end);
+                argsGood = argsGood && *end == '\0' && replaySpeed >= 0;
+                break;
+            }
+#endif
+            default:
+                argsGood = false;
+        }
+    }
+    // Only the worker pool has the io_uring mode
+    argsGood = argsGood && (!ioUring || workerCount > 0);
+#ifdef EMBEDDED_GPIO_CONFIG
+    // The config is built into the service, no file to read
+    bool configGood = optind == argc;
+    string fileName = "<embedded>";
+#else
+    bool configGood = optind < argc;
+    string fileName = configGood ? argv[optind] : "";
+#endif
+    if (argsGood && configGood)
     {
-        string fileName = argv[1];
         try
         {
+#ifdef EMBEDDED_GPIO_CONFIG
+            GpioJsonConfig gpioConfig(embeddedGpioConfig);
+#else
             GpioJsonConfig gpioConfig(fileName);
+#endif
 
+            GpioStats gpioStats(io, gpioConfig);
+
+            GpioChangeLog changeLog(gpioConfig, changeLogCapacity);
+
+            GpioLoopMonitor loopMonitor(io, gpioStats.getGlobalStats(),
+                                        (uint64_t)(stallThresholdSec * 1e9));
+
+            optional<GpioFaultGroups> faultGroups;
+            if (GpioFaultGroups::hasFaultGroups(gpioConfig))
+            {
+                faultGroups.emplace(io, gpioConfig);
+            }
+
+            optional<GpioOutputs> outputs;
+            if (GpioOutputs::hasOutputs(gpioConfig))
+            {
+                outputs.emplace(gpioConfig);
+            }
+
+            optional<GpioPinGroups> pinGroups;
+            if (GpioPinGroups::hasPinGroups(gpioConfig))
+            {
+                pinGroups.emplace(gpioConfig, gpioStats);
+            }
+
+            optional<GpioReplyCache> replyCache;
             shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface =
-                createDbusObject(io, gpioConfig);
+                createDbusObject(io, gpioConfig, gpioStats, changeLog,
+                                 faultGroups ? &*faultGroups : nullptr,
+                                 outputs ? &*outputs : nullptr,
+                                 pinGroups ? &*pinGroups : nullptr,
+                                 replyCache);
 
-            GpioChips gpioChips(gpioConfig);
+            GpioPublisher publisher(dbusInterface, gpioStats.getGlobalStats(),
+                                    changeLog);
+            if (faultGroups)
+            {
+                publisher.setFaultGroups(&*faultGroups);
+            }
 
-            GpioLines gpioLines(gpioChips, gpioConfig);
+            optional<FlightRecorder> flightRecorder;
+            if (!flightRecorderFileName.empty())
+            {
+                startFlightRecorder(flightRecorder, flightRecorderFileName,
+                                    gpioConfig, publisher);
+            }
 
+            optional<GpioEventStream> eventStream;
+            if (!eventStreamSocketPath.empty())
+            {
+                // Pin indices in the stream are the config positions
+                vector<string> pinNames;
+                for (const auto& pin : gpioConfig.getPins())
+                {
+                    pinNames.push_back(pin.name);
+                }
+                eventStream.emplace(io, eventStreamSocketPath, pinNames);
+                publisher.setEventStream(&*eventStream);
+            }
+
+            optional<GpioActions> actions;
+            if (GpioActions::hasActions(gpioConfig))
+            {
+                actions.emplace(gpioConfig, gpioStats.getGlobalStats(),
+                                actionWorkerCount);
+                publisher.setActions(&*actions);
+            }
+
+            optional<GpioChips> gpioChips;
+            optional<GpioLines> gpioLines;
+            vector<MonitoredPin> pins;
+            vector<PolledLines> polledLines;
+            optional<GpioHotplug> gpioHotplug;
+            optional<GpioWorkerPool> workerPool;
             vector<thread> threads;
-            startThreads(threads, dbusInterface,
-                         gpioLines.getDbusPropMapLineObj(), gpioConfig);
+#ifdef SANDBOX_MODE
+            optional<TraceReader> traceReader;
+            optional<TraceRecorder> recorder;
+            if (!replayFileName.empty())
+            {
+                // No gpio hardware is touched when replaying
+                traceReader.emplace(replayFileName);
+                pins = createMonitoredPins(gpioConfig, gpioStats, {});
+                startReplayThread(threads, publisher, pins, *traceReader,
+                                  replaySpeed);
+            }
+            else
+#endif
+            {
+                // A single enumeration of all the gpio chips resolves all the
+                // line names
+                if (gpioConfig.hasLineNames())
+                {
+                    gpioConfig.resolveLineNames(GpioLineNames());
+                }
+
+                gpioChips.emplace(gpioConfig);
+
+                gpioLines.emplace(*gpioChips, gpioConfig);
+
+                pins = createMonitoredPins(gpioConfig, gpioStats,
+                                           gpioLines->getDbusPropMapLineObj());
+                polledLines = createPolledLines(
+                    pins, gpioLines->getPolledRequests());
+                for (auto& polled : polledLines)
+                {
+                    polled.heartbeat =
+                        &loopMonitor.addLoop(polled.chipName + " polls");
+                }
+                // Also for the pins of the worker pool, attached late with
+                // a thread of their own
+                for (auto& pin : pins)
+                {
+                    if (!pin.isOutput)
+                    {
+                        pin.heartbeat = &loopMonitor.addLoop(pin.pinName);
+                    }
+                }
+                if (pinGroups)
+                {
+                    pinGroups->gate(pins);
+                }
+
+                // The pins attached late get a thread of their own, also
+                // with the worker pool
+                gpioHotplug.emplace(
+                    io, *gpioChips, *gpioLines, gpioConfig, gpioStats, pins,
+                    [&threads, &publisher, &outputs](MonitoredPin& pin) {
+                        if (pin.isOutput)
+                        {
+                            outputs->onAttached(pin);
+                        }
+                        else
+                        {
+                            startPinThread(threads, publisher, pin);
+                        }
+                    });
+                setPinThreadsHotplug(&*gpioHotplug);
+#ifdef SANDBOX_MODE
+                if (!recordFileName.empty())
+                {
+                    // Pin indices in the trace are the config positions
+                    vector<string> pinNames;
+                    for (const auto& pin : pins)
+                    {
+                        pinNames.push_back(pin.pinName);
+                    }
+                    recorder.emplace(recordFileName, pinNames);
+                    publisher.setTraceRecorder(&*recorder);
+                }
+#endif
+                if (workerCount > 0)
+                {
+                    workerPool.emplace(
+                        io, publisher, pins, workerCount, loopMonitor,
+                        getBusReadPolicy(pins, busTransactionsPerSec),
+                        ioUring);
+                    runThreads = true;
+                    workerPool->start();
+                }
+                else
+                {
+                    startThreads(threads, publisher, pins);
+                }
+                gpioHotplug->start();
+            }
+            if (outputs)
+            {
+                outputs->serve(publisher, pins);
+            }
+            loopMonitor.start();
+
+            boost::asio::steady_timer summaryTimer(io);
+            scheduleRepeatedLogSummaries(summaryTimer);
 
             // Nested try/catch so that opened lines in
             // between could be closed gracefully.
@@ -526,9 +913,29 @@ int main(int argc, char* argv[])
 #ifdef ENABLE_GSH_LOGS
             log<level::INFO>("Waiting for gpio monitoring threads to finish");
 #endif
+            if (workerPool)
+            {
+                workerPool->stop();
+            }
+            if (pinGroups)
+            {
+                pinGroups->stop();
+            }
             finishThreads(threads);
-            showLastThreadException();
+            setPinThreadsHotplug(nullptr);
+            publisher.setFlightRecorder(nullptr);
+            publisher.setEventStream(nullptr);
+            publisher.setActions(nullptr);
+            publisher.setFaultGroups(nullptr);
+#ifdef SANDBOX_MODE
+            publisher.setTraceRecorder(nullptr);
+#endif
+            showLastThreadException(publisher);
+            logRepeatedSummaries(true);
             mainResult = threadsExitCode;
+#ifdef SANDBOX_MODE
+            logSteadyStateAllocations();
+#endif
         }
         catch (const json::exception& e)
         {
@@ -548,12 +955,49 @@ int main(int argc, char* argv[])
             mainResult = 1;
         }
     }
-    else // ! argc > 1
+    else // ! argsGood && configGood
     {
         stringstream ss;
+#ifdef EMBEDDED_GPIO_CONFIG
+        ss << "No config file expected, the gpio config is embedded in the "
+           << "service" << endl;
+#else
         ss << "A json configuration file expected as the first argument "
            << "in the format: " << endl
            << GpioJsonConfig::expectedJsonConfigFormat;
+#endif
+        ss << "Options:" << endl
+           << "  -w <workers>     serve the pins with the given number of "
+           << "worker threads, each owning a set of gpio chips, instead of a "
+           << "thread per pin" << endl;
+#ifdef IO_URING_BACKEND
+        ss << "  -u               with -w, read the edges of the lines through "
+           << "an io_uring per worker rather than waiting on an epoll set"
+           << endl;
+#endif
+        ss << "  -t <reads/s>     with -w, line reads per second allowed per "
+           << "gpio chip behind an I2C or SPI bus, 0 for no limit (default: "
+           << defaultBusTransactionsPerSec << ")" << endl
+           << "  -f <file>        keep the last " << flightRecorderRecords
+           << " edges and published changes in the memory-mapped flight "
+           << "recorder file, the previous one renamed to <file>.1" << endl
+           << "  -e <socket>      stream the edges to the subscribers of the "
+           << "SOCK_SEQPACKET Unix socket" << endl
+           << "  -a <workers>     number of the threads running the actions of "
+           << "the pin transitions (default: " << defaultActionWorkers << ")"
+           << endl
+           << "  -l <seconds>     report the stalls of the DBus server and "
+           << "gpio monitoring loops longer than this (default: "
+           << defaultStallThresholdSec << ")" << endl;
+#ifdef SANDBOX_MODE
+        ss << "Sandbox mode options:" << endl
+           << "  -r <trace_file>  record the gpio edges to the trace file"
+           << endl
+           << "  -p <trace_file>  replay the trace file instead of monitoring "
+           << "the gpio lines" << endl
+           << "  -s <speed>       replay speed factor, 0 for maximal speed "
+           << "(default: 1)" << endl;
+#endif
         log<level::ERR>(ss.str().c_str());
         mainResult = 1;
     }
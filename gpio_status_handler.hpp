@@ -1,6 +1,14 @@
+#pragma once
+
 #include <gpiod.h>
 
 #include <nlohmann/json.hpp>
 
 typedef struct gpiod_chip gpiod_chip_t;
 typedef struct gpiod_line gpiod_line_t;
+
+/**
+ * @brief Stop the DBus server loop and all the gpio monitoring threads, making
+ * the service exit with @exitCode. Can be called from any thread.
+ */
+void stopService(int exitCode);
@@ -0,0 +1,160 @@
+#include <gpio_trace.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+static constexpr char traceMagic[4] = {'G', 'S', 'H', 'T'};
+
+/** @brief Number of records buffered before writing them to the file **/
+static constexpr size_t traceBufferRecords = 4096;
+
+TraceRecorder::TraceRecorder(const string& fileName,
+                             const vector<string>& pinNames)
+{
+    if (pinNames.size() > numeric_limits<uint16_t>::max())
+    {
+        throw invalid_argument("Too many pins for the trace file format");
+    }
+    file = fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to create the trace file " + fileName);
+    }
+    uint16_t version = traceFormatVersion;
+    uint16_t pinCount = pinNames.size();
+    bool ok = fwrite(traceMagic, sizeof(traceMagic), 1, file) == 1 &&
+              fwrite(&version, sizeof(version), 1, file) == 1 &&
+              fwrite(&pinCount, sizeof(pinCount), 1, file) == 1;
+    for (auto it = pinNames.cbegin(); it != pinNames.cend() && ok; ++it)
+    {
+        if (it->size() > numeric_limits<uint8_t>::max())
+        {
+            fclose(file);
+            throw invalid_argument("Pin name too long for the trace file "
+                                   "format: " +
+                                   *it);
+        }
+        uint8_t nameLen = it->size();
+        ok = fwrite(&nameLen, sizeof(nameLen), 1, file) == 1 &&
+             fwrite(it->data(), 1, nameLen, file) == nameLen;
+    }
+    if (!ok)
+    {
+        int lastErrno = errno;
+        fclose(file);
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to write the trace file header");
+    }
+    buffer.reserve(traceBufferRecords);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    flush();
+    fclose(file);
+}
+
+void TraceRecorder::record(uint16_t pinIndex, uint8_t bit,
+                           const struct timespec& ts, bool level) noexcept
+{
+    TraceRecord record{(uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec,
+                       pinIndex, level, bit};
+    lock_guard<std::mutex> lock(mutex);
+    buffer.push_back(record);
+    if (buffer.size() == traceBufferRecords)
+    {
+        flush();
+    }
+}
+
+// Expected to be called with 'mutex' held or from the destructor
+void TraceRecorder::flush() noexcept
+{
+    if (!buffer.empty() && !writeFailed)
+    {
+        if (fwrite(buffer.data(), sizeof(TraceRecord), buffer.size(), file) !=
+                buffer.size() ||
+            fflush(file) != 0)
+        {
+            int lastErrno = errno;
+            log<level::ERR>("Failed to write the trace file, recording stopped",
+                            entry("ERRNO=%d", lastErrno),
+                            entry("ERRNO_STR=%s", strerror(lastErrno)));
+            writeFailed = true;
+        }
+    }
+    buffer.clear();
+}
+
+TraceReader::TraceReader(const string& fileName)
+{
+    file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+    {
+        throw system_error(error_code(errno, system_category()),
+                           "Failed to open the trace file " + fileName);
+    }
+    char magic[sizeof(traceMagic)];
+    uint16_t version = 0;
+    uint16_t pinCount = 0;
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+              memcmp(magic, traceMagic, sizeof(magic)) == 0 &&
+              fread(&version, sizeof(version), 1, file) == 1 &&
+              version == traceFormatVersion &&
+              fread(&pinCount, sizeof(pinCount), 1, file) == 1;
+    for (auto i = 0u; i < pinCount && ok; ++i)
+    {
+        uint8_t nameLen = 0;
+        string name;
+        ok = fread(&nameLen, sizeof(nameLen), 1, file) == 1;
+        if (ok)
+        {
+            name.resize(nameLen);
+            ok = fread(name.data(), 1, nameLen, file) == nameLen;
+        }
+        pinNames.push_back(name);
+    }
+    if (!ok)
+    {
+        fclose(file);
+        throw runtime_error("Not a valid trace file (version " +
+                            to_string(traceFormatVersion) +
+                            " expected): " + fileName);
+    }
+}
+
+TraceReader::~TraceReader()
+{
+    fclose(file);
+}
+
+const vector<string>& TraceReader::getPinNames() const
+{
+    return pinNames;
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+    size_t n = fread(&record, 1, sizeof(record), file);
+    if (n != 0 && n != sizeof(record))
+    {
+        throw runtime_error("Truncated trace record");
+    }
+    return n == sizeof(record);
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @file
+ *
+ * Recording and reading of the gpio edge traces (sandbox mode only).
+ *
+ * Trace file layout, all integers little-endian (native on the BMC):
+ *
+ *   magic       4 bytes  "GSHT"
+ *   version     uint16   @ref traceFormatVersion
+ *   pinCount    uint16
+ *   pinCount times:
+ *     nameLen   uint8
+ *     name      nameLen bytes, no terminating zero
+ *   records     @ref TraceRecord until the end of file
+ *
+ * A record refers to its pin by the index in the pin names table, so a trace
+ * can be replayed with a config listing the pins in any order.
+ */
+
+namespace gpio_handler
+{
+
+static constexpr uint16_t traceFormatVersion = 1;
+
+/** @brief A single edge event as stored in the trace file **/
+struct __attribute__((packed)) TraceRecord
+{
+    /** @brief Kernel timestamp of the event (@gpiod_line_event.ts) **/
+    uint64_t timestampNs;
+    /** @brief Index in the pin names table of the trace **/
+    uint16_t pinIndex;
+    /** @brief Line level right after the edge: 1 rising, 0 falling **/
+    uint8_t level;
+    /** @brief Position of the line in the bus, 0 for a single pin **/
+    uint8_t bit;
+};
+
+static_assert(sizeof(TraceRecord) == 12, "Trace record format changed");
+
+/**
+ * @brief Writer of the trace file
+ *
+ * Records are buffered in memory and written in chunks, so the cost per
+ * recorded event is a mutex acquisition and a copy of 12 bytes. The class is
+ * thread-safe.
+ */
+class TraceRecorder
+{
+  public:
+    /**
+     * @brief Create (truncate) the @fileName trace and write its header
+     * listing @pinNames.
+     *
+     * Throw @ref std::system_error if the file could not be written and
+     * @ref std::invalid_argument if @pinNames don't fit the format.
+     */
+    TraceRecorder(const std::string& fileName,
+                  const std::vector<std::string>& pinNames);
+
+    /** @brief Flush the buffered records and close the file **/
+    ~TraceRecorder();
+
+    /**
+     * @brief Append the edge event of the line @bit of the pin @pinIndex.
+     * Write errors are logged once and further records are dropped.
+     */
+    void record(uint16_t pinIndex, uint8_t bit, const struct timespec& ts,
+                bool level) noexcept;
+
+  private:
+    FILE* file;
+    std::mutex mutex;
+    std::vector<TraceRecord> buffer;
+    bool writeFailed = false;
+
+    void flush() noexcept;
+};
+
+/** @brief Sequential reader of the trace file **/
+class TraceReader
+{
+  public:
+    /**
+     * @brief Open the @fileName trace and read its header.
+     *
+     * Throw @ref std::system_error if the file could not be read and
+     * @ref std::runtime_error if it's not a valid trace.
+     */
+    explicit TraceReader(const std::string& fileName);
+    ~TraceReader();
+
+    /** @brief Pin names table of the trace, indexed by
+     * @ref TraceRecord::pinIndex **/
+    const std::vector<std::string>& getPinNames() const;
+
+    /**
+     * @brief Read the next record into @record.
+     *
+     * Return false at the end of the trace. Throw @ref std::runtime_error on a
+     * truncated record.
+     */
+    bool next(TraceRecord& record);
+
+  private:
+    FILE* file;
+    std::vector<std::string> pinNames;
+};
+
+} // namespace gpio_handler
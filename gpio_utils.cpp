@@ -1,6 +1,8 @@
 #include <gpio_utils.hpp>
 #include <phosphor-logging/log.hpp>
 
+#include <array>
+#include <mutex>
 #include <sstream>
 
 using namespace std;
@@ -8,24 +10,219 @@ using phosphor::logging::entry;
 using phosphor::logging::level;
 using phosphor::logging::log;
 
+namespace
+{
+
+using Clock = chrono::steady_clock;
+
+/** @brief The occurrences of a deduplicated journal entry **/
+struct Repetition
+{
+    /** @brief Hash of (pin, message, errno), 0 if the slot is free **/
+    uint64_t key = 0;
+    level severity;
+    bool isCallError;
+    /** @brief The message, or the FUNCALL of a libgpiod call error **/
+    string message;
+    int result;
+    int lastErrno;
+    string pinName;
+    string chipName;
+    int pinNum;
+    /** @brief Since the entry was logged or summarized last **/
+    Clock::time_point periodStart;
+    Clock::time_point lastSeen;
+    /** @brief Occurrences not logged since @ref periodStart **/
+    uint64_t count;
+};
+
+mutex repetitionsMutex;
+array<Repetition, repeatedLogSlots> repetitions;
+
+uint64_t hashEntry(const string& message, int lastErrno, const string& pinName)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+        }
+    };
+    add(message.data(), message.size() + 1);
+    add(&lastErrno, sizeof(lastErrno));
+    add(pinName.data(), pinName.size());
+    return hash != 0 ? hash : 1;
+}
+
+template <level L>
+void logSummary(const Repetition& r, const char* message)
+{
+    if (r.isCallError && r.pinName.empty())
+    {
+        log<L>(message, entry("FUNCALL=%s", r.message.c_str()),
+               entry("RESULT=%d", r.result), entry("ERRNO=%d", r.lastErrno),
+               entry("ERRNO_STR=%s", strerror(r.lastErrno)));
+    }
+    else if (r.isCallError)
+    {
+        log<L>(message, entry("FUNCALL=%s", r.message.c_str()),
+               entry("RESULT=%d", r.result), entry("ERRNO=%d", r.lastErrno),
+               entry("ERRNO_STR=%s", strerror(r.lastErrno)),
+               pinNameEntry(r.pinName), chipEntry(r.chipName),
+               pinNumEntry(r.pinNum));
+    }
+    else if (r.chipName.empty())
+    {
+        log<L>(message, pinNameEntry(r.pinName));
+    }
+    else
+    {
+        log<L>(message, pinNameEntry(r.pinName), chipEntry(r.chipName),
+               pinNumEntry(r.pinNum));
+    }
+}
+
+// Called with 'repetitionsMutex' locked
+void logSummary(const Repetition& repetition, Clock::time_point now)
+{
+    stringstream ss;
+    ss << (repetition.isCallError ? "libgpiod function call error"
+                                  : repetition.message)
+       << " (" << repetition.count << " occurrences in "
+       << chrono::ceil<chrono::seconds>(now - repetition.periodStart).count()
+       << " s)";
+    string message = ss.str();
+    switch (repetition.severity)
+    {
+        case level::EMERG:
+            logSummary<level::EMERG>(repetition, message.c_str());
+            break;
+        case level::ALERT:
+            logSummary<level::ALERT>(repetition, message.c_str());
+            break;
+        case level::CRIT:
+            logSummary<level::CRIT>(repetition, message.c_str());
+            break;
+        case level::ERR:
+            logSummary<level::ERR>(repetition, message.c_str());
+            break;
+        case level::WARNING:
+            logSummary<level::WARNING>(repetition, message.c_str());
+            break;
+        case level::NOTICE:
+            logSummary<level::NOTICE>(repetition, message.c_str());
+            break;
+        case level::INFO:
+            logSummary<level::INFO>(repetition, message.c_str());
+            break;
+        case level::DEBUG:
+            logSummary<level::DEBUG>(repetition, message.c_str());
+            break;
+    }
+}
+
+} // namespace
+
+bool isFirstOccurrence(level severity, bool isCallError, const string& message,
+                       int result, int lastErrno, const string& pinName,
+                       const string& chipName, int pinNum)
+{
+    uint64_t key = hashEntry(message, lastErrno, pinName);
+    auto now = Clock::now();
+    lock_guard<mutex> lock(repetitionsMutex);
+    Repetition* slot = &repetitions.front();
+    for (auto& repetition : repetitions)
+    {
+        if (repetition.key == key)
+        {
+            ++repetition.count;
+            repetition.lastSeen = now;
+            return false;
+        }
+        // A free slot, or else the least recently seen
+        if (slot->key != 0 &&
+            (repetition.key == 0 || repetition.lastSeen < slot->lastSeen))
+        {
+            slot = &repetition;
+        }
+    }
+    if (slot->key != 0 && slot->count > 0)
+    {
+        logSummary(*slot, now);
+    }
+    slot->key = key;
+    slot->severity = severity;
+    slot->isCallError = isCallError;
+    slot->message = message;
+    slot->result = result;
+    slot->lastErrno = lastErrno;
+    slot->pinName = pinName;
+    slot->chipName = chipName;
+    slot->pinNum = pinNum;
+    slot->periodStart = now;
+    slot->lastSeen = now;
+    slot->count = 0;
+    return true;
+}
+
+void logRepeatedSummaries(bool all)
+{
+    auto now = Clock::now();
+    lock_guard<mutex> lock(repetitionsMutex);
+    for (auto& repetition : repetitions)
+    {
+        if (repetition.key == 0)
+        {
+            continue;
+        }
+        if (repetition.count > 0)
+        {
+            logSummary(repetition, now);
+            repetition.periodStart = now;
+            repetition.count = 0;
+        }
+        else if (now - repetition.periodStart >= repeatedLogPeriod)
+        {
+            repetition.key = 0;
+        }
+        if (all)
+        {
+            repetition.key = 0;
+        }
+    }
+}
+
 void logLibgpioCallError(const stringstream& funcall, int result, int lastErrno)
 {
-    log<level::ERR>("libgpiod function call error",
-                    entry("FUNCALL=%s", funcall.str().c_str()),
-                    entry("RESULT=%d", result), entry("ERRNO=%d", lastErrno),
-                    entry("ERRNO_STR=%s", strerror(lastErrno)));
+    string call = funcall.str();
+    if (isFirstOccurrence(level::ERR, true, call, result, lastErrno, "", "",
+                          -1))
+    {
+        log<level::ERR>("libgpiod function call error",
+                        entry("FUNCALL=%s", call.c_str()),
+                        entry("RESULT=%d", result),
+                        entry("ERRNO=%d", lastErrno),
+                        entry("ERRNO_STR=%s", strerror(lastErrno)));
+    }
 }
 
 void logLibgpioCallError(const stringstream& funcall, int result, int lastErrno,
                          const string& pinName, const string& chipName,
                          int pinNum)
 {
-    log<level::ERR>("libgpiod function call error",
-                    entry("FUNCALL=%s", funcall.str().c_str()),
-                    entry("RESULT=%d", result), entry("ERRNO=%d", lastErrno),
-                    entry("ERRNO_STR=%s", strerror(lastErrno)),
-                    pinNameEntry(pinName), chipEntry(chipName),
-                    pinNumEntry(pinNum));
+    string call = funcall.str();
+    if (isFirstOccurrence(level::ERR, true, call, result, lastErrno, pinName,
+                          chipName, pinNum))
+    {
+        log<level::ERR>("libgpiod function call error",
+                        entry("FUNCALL=%s", call.c_str()),
+                        entry("RESULT=%d", result),
+                        entry("ERRNO=%d", lastErrno),
+                        entry("ERRNO_STR=%s", strerror(lastErrno)),
+                        pinNameEntry(pinName), chipEntry(chipName),
+                        pinNumEntry(pinNum));
+    }
 }
 
 tuple<const char*, const char*> pinNameEntry(const string& pinName)
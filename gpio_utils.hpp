@@ -1,5 +1,7 @@
 #include <phosphor-logging/log.hpp>
 
+#include <chrono>
+#include <cstddef>
 #include <sstream>
 #include <string>
 
@@ -34,7 +36,46 @@
  * always precedes the termination of the program, and the internally
  * caused termination of the program should always be accompanied by ERR
  * entry. If you observed a different behavior please let me know.
+ *
+ * A failing or flapping line must not flood the journal, so the entries logged
+ * by @ref logLibgpioCallError and @ref logPinOperation are deduplicated by
+ * (pin, message, errno). The first occurrence is logged right away, the
+ * repeated ones are only counted and summarized by a single entry with the
+ * same fields and the message suffixed by "(N occurrences in T s)", see @ref
+ * logRepeatedSummaries. At most @ref repeatedLogSlots distinct entries are
+ * tracked at once, the least recently seen one is summarized and forgotten
+ * first.
+ */
+
+/** @brief The shortest period summarized by a single entry **/
+constexpr std::chrono::seconds repeatedLogPeriod(10);
+
+/** @brief Number of the distinct entries deduplicated at once **/
+constexpr size_t repeatedLogSlots = 64;
+
+/**
+ * @brief Log the summaries of the entries repeated since they were logged or
+ * summarized last. An entry not repeated for @ref repeatedLogPeriod is
+ * forgotten, so its next occurrence is logged right away again.
+ *
+ * To be called every @ref repeatedLogPeriod, and at the end of the service
+ * with @all set, which forgets all the entries.
+ */
+void logRepeatedSummaries(bool all = false);
+
+/**
+ * @brief Count an occurrence of the @message with @lastErrno (0 if none) about
+ * the @pinName (empty if none), logged at the @severity.
+ *
+ * The @chipName, @pinNum and @result (of a libgpiod call, with @isCallError
+ * set) are the fields of the summary entry.
+ *
+ * @return True if the occurrence is the first one and should be logged.
  */
+bool isFirstOccurrence(phosphor::logging::level severity, bool isCallError,
+                       const std::string& message, int result, int lastErrno,
+                       const std::string& pinName,
+                       const std::string& chipName, int pinNum);
 
 void logLibgpioCallError(const std::stringstream& funcall, int result,
                          int lastErrno);
@@ -51,12 +92,19 @@ template <phosphor::logging::level L>
 void logPinOperation(const char* message, const std::string& pinName,
                      const std::string& chipName, int pinNum)
 {
-    phosphor::logging::log<L>(message, pinNameEntry(pinName),
-                              chipEntry(chipName), pinNumEntry(pinNum));
+    if (isFirstOccurrence(L, false, message, 0, 0, pinName, chipName, pinNum))
+    {
+        phosphor::logging::log<L>(message, pinNameEntry(pinName),
+                                  chipEntry(chipName), pinNumEntry(pinNum));
+    }
 }
 
 template <phosphor::logging::level L>
 void logPinOperation(const char* message, const std::string& pinName)
 {
-    phosphor::logging::log<L>(message, pinNameEntry(pinName));
+    // An empty chip name marks the entries without the chip fields
+    if (isFirstOccurrence(L, false, message, 0, 0, pinName, "", -1))
+    {
+        phosphor::logging::log<L>(message, pinNameEntry(pinName));
+    }
 }
@@ -0,0 +1,1308 @@
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef IO_URING_BACKEND
+#include <linux/gpio.h>
+
+#include <gpio_event_ring.hpp>
+#endif
+#include <gpio_alloc_count.hpp>
+#include <gpio_utils.hpp>
+#include <gpio_workers.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+using phosphor::logging::entry;
+using phosphor::logging::level;
+using phosphor::logging::log;
+
+namespace gpio_handler
+{
+
+/** @brief Maximal number of ready descriptors handled per worker wakeup **/
+static constexpr int maxEpollEvents = 64;
+
+/** @brief Maximal number of edge events read from a line at once **/
+static constexpr unsigned maxLineEvents = 16;
+
+/** @brief Maximal number of measurements of a pin waiting for the DBus thread,
+ * of the windows closed since it last drained the pin **/
+static constexpr unsigned maxPendingMeasurements = 8;
+
+using Clock = chrono::steady_clock;
+
+/** @brief A line of a pin, the entry of the worker's epoll set **/
+struct GpioWorkerPool::WorkerLine
+{
+    WorkerPin* workerPin;
+    /** @brief Position of the line in the bus, 0 for a single pin **/
+    unsigned bit;
+    int eventFd;
+#ifdef IO_URING_BACKEND
+    /** @brief In the io_uring mode, a request on the line is posted: a read
+     * into @ref buffer, or a poll if @ref polling **/
+    bool posted = false;
+    bool polling = false;
+    unique_ptr<struct gpioevent_data[]> buffer = nullptr;
+#endif
+};
+
+struct GpioWorkerPool::WorkerPin
+{
+    explicit WorkerPin(MonitoredPin& pin) :
+        pin(pin), handedValue(pin.publishedValue),
+        pendingValue(pin.publishedValue)
+    {
+        // A polled line has no edge events to watch
+        for (auto bit = 0u; bit < pin.lines.size() && !pin.isPolled; ++bit)
+        {
+            lines.push_back(WorkerLine{
+                this, bit, gpiod_line_event_get_fd(pin.lines[bit])});
+        }
+    }
+
+    MonitoredPin& pin;
+    vector<WorkerLine> lines;
+
+    // Owned by the worker thread
+    Clock::time_point nextPoll;
+    bool hasLastValue = false;
+    uint64_t lastValue = 0;
+    uint64_t handedValue;
+    /** @brief Schedule of the pin's chip if it's behind a bus, NULL
+     * otherwise **/
+    ChipSchedule* chip = nullptr;
+    /** @brief The line request shared with the other polled pins of the chip,
+     * NULL if the pin is not polled **/
+    PolledRequest* polled = nullptr;
+    /** @brief An edge requested the next read of the chip to read the pin,
+     * the first one at @ref edgeDetectedNs **/
+    bool edgeRequested = false;
+    uint64_t edgeDetectedNs = 0;
+    /** @brief The pin's deadline is out of the queue until the chip read **/
+    bool deadlineHeld = false;
+    /** @brief The pin's deadline is in the queue **/
+    bool deadlineQueued = false;
+    /** @brief The pin's group is suspended, its lines are out of the epoll
+     * set (or their requests cancelled) and its deadline out of the queue **/
+    bool parked = false;
+
+    // Shared with the DBus thread
+    /** @brief The latest value to be published and when it was detected,
+     * guarded by 'handedOverMutex' so they are always taken as a pair **/
+    uint64_t pendingValue;
+    uint64_t pendingDetectedNs = 0;
+    /** @brief The measurements to be published, oldest first, and when their
+     * windows were closed, guarded by 'handedOverMutex' **/
+    array<PinMeasurement, maxPendingMeasurements> pendingMeasurements;
+    array<uint64_t, maxPendingMeasurements> pendingMeasurementsNs;
+    unsigned pendingMeasurementCount = 0;
+    /** @brief True if the pin is in 'handedOver' or being drained **/
+    atomic<bool> queued = false;
+};
+
+/** @brief The polled pins sharing a line request, read together, see
+ * 'PolledLines' **/
+struct GpioWorkerPool::PolledRequest
+{
+    const PolledLines& polled;
+    /** @brief In the order of the pins of 'polled' **/
+    vector<WorkerPin*> pins;
+    /** @brief A pin is due for the next read of the chip **/
+    bool readRequested = false;
+};
+
+/** @brief The reads of the pins on a chip behind a bus, see
+ * 'BusReadPolicy' **/
+struct GpioWorkerPool::ChipSchedule
+{
+    /** @brief All the pins of the chip served by the worker, except the
+     * measured ones, which are never read **/
+    vector<WorkerPin*> pins;
+    /** @brief The requests of the polled ones among the @ref pins **/
+    vector<PolledRequest*> polled;
+    /** @brief A pin is waiting for the next read **/
+    bool readRequested = false;
+    /** @brief The earliest time the budget allows the next read **/
+    Clock::time_point nextAllowed;
+};
+
+struct GpioWorkerPool::Worker
+{
+    int epollFd = -1;
+#ifdef IO_URING_BACKEND
+    /** @brief Replaces the epoll set in the io_uring mode **/
+    optional<GpioEventRing> ring;
+#endif
+    /** @brief Event descriptor in the epoll set (or polled by the io_uring),
+     * signalled when a group of the worker's pins was resumed **/
+    int resumeFd = -1;
+    vector<WorkerPin*> pins;
+    vector<unique_ptr<ChipSchedule>> chips;
+    vector<unique_ptr<PolledRequest>> polledRequests;
+    LoopHeartbeat* heartbeat = nullptr;
+    thread workerThread;
+};
+
+/** @brief What woke up a worker: the epoll data of a ready descriptor, or the
+ * data and the result of an io_uring completion **/
+struct GpioWorkerPool::ReadyLine
+{
+    void* data;
+    int result;
+};
+
+static void closeFd(int& fd) noexcept
+{
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+static bool isSuspended(const MonitoredPin& pin) noexcept
+{
+    return pin.group != nullptr && pin.group->isSuspended();
+}
+
+GpioWorkerPool::GpioWorkerPool(boost::asio::io_context& io,
+                               GpioPublisher& publisher,
+                               vector<MonitoredPin>& pins,
+                               unsigned workerCount,
+                               GpioLoopMonitor& loopMonitor,
+                               const BusReadPolicy& busReadPolicy,
+                               bool ioUring) :
+    io(io),
+    publisher(publisher), busReadPolicy(busReadPolicy), ioUring(ioUring),
+    drainEvent(io)
+{
+    if (workerCount == 0)
+    {
+        throw invalid_argument("At least one worker required");
+    }
+#ifndef IO_URING_BACKEND
+    if (ioUring)
+    {
+        throw invalid_argument("The io_uring support is not built in");
+    }
+#endif
+
+    map<string, vector<WorkerPin*>> chipPins;
+    for (auto& pin : pins)
+    {
+        if (pin.lines.empty() || pin.isOutput)
+        {
+            // The chip is missing, the pin is attached later with a thread of
+            // its own (see @ref GpioHotplug), or the pin is not monitored
+            continue;
+        }
+        workerPins.push_back(make_unique<WorkerPin>(pin));
+        chipPins[pin.chipName].push_back(workerPins.back().get());
+    }
+    handedOver.reserve(workerPins.size());
+    draining.reserve(workerPins.size());
+
+    // Largest chips first, each to the least loaded worker. There is no point
+    // in having more workers than chips.
+    vector<const vector<WorkerPin*>*> chips;
+    for (const auto& [chipName, chipPinsList] : chipPins)
+    {
+        chips.push_back(&chipPinsList);
+    }
+    sort(chips.begin(), chips.end(),
+         [](const auto* a, const auto* b) { return a->size() > b->size(); });
+    workerCount = min(workerCount, (unsigned)chips.size());
+    for (auto i = 0u; i < workerCount; ++i)
+    {
+        workers.push_back(make_unique<Worker>());
+        workers.back()->heartbeat =
+            &loopMonitor.addLoop("worker#" + to_string(i));
+    }
+    for (const auto* chip : chips)
+    {
+        auto leastLoaded = min_element(
+            workers.begin(), workers.end(), [](const auto& a, const auto& b) {
+                return a->pins.size() < b->pins.size();
+            });
+        (*leastLoaded)->pins.insert((*leastLoaded)->pins.end(), chip->begin(),
+                                    chip->end());
+    }
+    // A chip has a single worker, so its schedule and its polled requests are
+    // owned by that one
+    for (auto& worker : workers)
+    {
+        map<const MonitoredPin*, WorkerPin*> workerPinsByPin;
+        for (WorkerPin* workerPin : worker->pins)
+        {
+            workerPinsByPin[&workerPin->pin] = workerPin;
+        }
+        map<string, ChipSchedule*> schedules;
+        for (WorkerPin* workerPin : worker->pins)
+        {
+            const MonitoredPin& pin = workerPin->pin;
+            if (pin.polledLines != nullptr &&
+                pin.polledLines->pins.front() == &pin)
+            {
+                worker->polledRequests.push_back(make_unique<PolledRequest>(
+                    PolledRequest{*pin.polledLines, {}}));
+                PolledRequest& request = *worker->polledRequests.back();
+                for (const MonitoredPin* polledPin : pin.polledLines->pins)
+                {
+                    WorkerPin* polledWorkerPin =
+                        workerPinsByPin.at(polledPin);
+                    request.pins.push_back(polledWorkerPin);
+                    polledWorkerPin->polled = &request;
+                }
+            }
+        }
+        for (WorkerPin* workerPin : worker->pins)
+        {
+            const MonitoredPin& pin = workerPin->pin;
+            if (pin.meter || !busReadPolicy.chipNames.contains(pin.chipName))
+            {
+                continue;
+            }
+            ChipSchedule*& chip = schedules[pin.chipName];
+            if (chip == nullptr)
+            {
+                worker->chips.push_back(make_unique<ChipSchedule>());
+                chip = worker->chips.back().get();
+            }
+            chip->pins.push_back(workerPin);
+            workerPin->chip = chip;
+            if (workerPin->polled != nullptr &&
+                workerPin->polled->pins.front() == workerPin)
+            {
+                chip->polled.push_back(workerPin->polled);
+            }
+        }
+    }
+
+    int lastErrno = 0;
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stopFd < 0)
+    {
+        lastErrno = errno;
+    }
+    if (lastErrno == 0)
+    {
+        drainFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (drainFd < 0)
+        {
+            lastErrno = errno;
+        }
+    }
+    for (auto it = workers.begin(); it != workers.end() && lastErrno == 0;
+         ++it)
+    {
+        Worker& worker = **it;
+        worker.resumeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (worker.resumeFd < 0)
+        {
+            lastErrno = errno;
+            continue;
+        }
+#ifdef IO_URING_BACKEND
+        if (ioUring)
+        {
+            try
+            {
+                createRing(worker);
+            }
+            catch (const system_error& e)
+            {
+                lastErrno = e.code().value();
+            }
+            continue;
+        }
+#endif
+        worker.epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        // NULL 'ptr' denotes the stop request
+        ev.data.ptr = nullptr;
+        if (worker.epollFd < 0 ||
+            epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, stopFd, &ev) != 0)
+        {
+            lastErrno = errno;
+        }
+        // The address of 'resumeFd' denotes a resumed group
+        ev.data.ptr = &worker.resumeFd;
+        if (lastErrno == 0 && epoll_ctl(worker.epollFd, EPOLL_CTL_ADD,
+                                        worker.resumeFd, &ev) != 0)
+        {
+            lastErrno = errno;
+        }
+        for (auto pinIt = worker.pins.begin();
+             pinIt != worker.pins.end() && lastErrno == 0; ++pinIt)
+        {
+            for (auto& line : (*pinIt)->lines)
+            {
+                ev.data.ptr = &line;
+                if (lastErrno == 0 && epoll_ctl(worker.epollFd, EPOLL_CTL_ADD,
+                                                line.eventFd, &ev) != 0)
+                {
+                    lastErrno = errno;
+                    const MonitoredPin& pin = (*pinIt)->pin;
+                    stringstream ss;
+                    ss << "Cannot watch the line #" << line.bit << " of <"
+                       << pin.chipName << " " << pin.pinNum << ">, fd "
+                       << line.eventFd;
+                    logPinOperation<level::ERR>(ss.str().c_str(), pin.pinName,
+                                                pin.chipName, pin.pinNum);
+                }
+            }
+        }
+    }
+    if (lastErrno == 0)
+    {
+        boost::system::error_code ec;
+        drainEvent.assign(drainFd, ec);
+        lastErrno = ec.value();
+    }
+    if (lastErrno != 0)
+    {
+        for (auto& worker : workers)
+        {
+            closeFd(worker->epollFd);
+            closeFd(worker->resumeFd);
+#ifdef IO_URING_BACKEND
+            worker->ring.reset();
+#endif
+        }
+        closeFd(stopFd);
+        closeFd(drainFd);
+        throw system_error(error_code(lastErrno, system_category()),
+                           "Failed to create the gpio worker pool");
+    }
+    for (auto& worker : workers)
+    {
+        set<PinGroupGate*> gates;
+        for (WorkerPin* workerPin : worker->pins)
+        {
+            PinGroupGate* gate = workerPin->pin.group;
+            if (gate != nullptr && gates.insert(gate).second)
+            {
+                gate->addResumeFd(worker->resumeFd);
+            }
+        }
+    }
+
+#ifdef ENABLE_GSH_LOGS
+    for (auto i = 0u; i < workers.size(); ++i)
+    {
+        stringstream ss;
+        ss << "Worker #" << i << " serves " << workers[i]->pins.size()
+           << " pins";
+        log<level::INFO>(ss.str().c_str());
+    }
+#endif
+}
+
+#ifdef IO_URING_BACKEND
+void GpioWorkerPool::createRing(Worker& worker)
+{
+    // The stop and the resume events and a request per line, the
+    // cancellations of the parked pins' requests are completed on top
+    unsigned requests = 2;
+    for (WorkerPin* workerPin : worker.pins)
+    {
+        for (auto& line : workerPin->lines)
+        {
+            // Read by the ring as soon as they are readable, rather than by a
+            // blocking read in a kernel worker thread per line
+            int flags = fcntl(line.eventFd, F_GETFL);
+            if (flags < 0 ||
+                fcntl(line.eventFd, F_SETFL, flags | O_NONBLOCK) != 0)
+            {
+                throw system_error(error_code(errno, system_category()),
+                                   "Failed to make a line non-blocking");
+            }
+            line.buffer = make_unique<struct gpioevent_data[]>(maxLineEvents);
+            ++requests;
+        }
+    }
+    worker.ring.emplace(requests);
+}
+#endif
+
+GpioWorkerPool::~GpioWorkerPool()
+{
+    stop();
+    for (auto& worker : workers)
+    {
+        closeFd(worker->epollFd);
+        closeFd(worker->resumeFd);
+    }
+    closeFd(stopFd);
+}
+
+void GpioWorkerPool::start()
+{
+#ifdef ENABLE_GSH_LOGS
+    log<level::INFO>("Starting gpio worker threads");
+#endif
+    waitForHandOver();
+    for (auto& worker : workers)
+    {
+        worker->workerThread =
+            thread(&GpioWorkerPool::runWorker, this, ref(*worker));
+    }
+}
+
+void GpioWorkerPool::stop() noexcept
+{
+    uint64_t one = 1;
+    if (stopFd >= 0 && write(stopFd, &one, sizeof(one)) != sizeof(one))
+    {
+        log<level::ERR>("Failed to signal the gpio workers to stop");
+    }
+    for (auto& worker : workers)
+    {
+        if (worker->workerThread.joinable())
+        {
+            worker->workerThread.join();
+        }
+    }
+}
+
+void GpioWorkerPool::runWorker(Worker& worker) noexcept
+{
+    GlobalStats& globalStats = publisher.getGlobalStats();
+    ReadyLine ready[maxEpollEvents];
+    struct gpiod_line_event lineEvents[maxLineEvents];
+
+    using Deadline = pair<Clock::time_point, WorkerPin*>;
+    vector<Deadline> deadlinesStorage;
+    deadlinesStorage.reserve(worker.pins.size());
+    // At most one entry per pin, none while the pin is parked or held by its
+    // chip. An entry is re-queued with the pin's current deadline when it
+    // expires, so edges postponing the polls don't have to touch the queue.
+    priority_queue<Deadline, vector<Deadline>, greater<Deadline>> deadlines(
+        greater<Deadline>(), move(deadlinesStorage));
+    auto queueDeadline = [&deadlines](WorkerPin& workerPin) {
+        deadlines.push(Deadline(workerPin.nextPoll, &workerPin));
+        workerPin.deadlineQueued = true;
+    };
+
+    bool ok = true;
+    for (auto it = worker.pins.begin(); it != worker.pins.end() && ok; ++it)
+    {
+        WorkerPin& workerPin = **it;
+        if (workerPin.pin.meter)
+        {
+            // The only reading of a measured pin, starting the first window
+            uint64_t level;
+            ok = readPinValue(workerPin.pin, level);
+            if (ok)
+            {
+                workerPin.pin.meter->start(EdgeMeter::nowNs(), level != 0);
+                ok = measurePin(workerPin, nullptr, 0);
+            }
+        }
+        else if (workerPin.polled != nullptr)
+        {
+            // Read with all the pins of its request at once
+            if (workerPin.polled->pins.front() == &workerPin)
+            {
+                ok = readPolled(*workerPin.polled);
+            }
+        }
+        else
+        {
+            ok = readPin(workerPin, true, EdgeMeter::nowNs());
+        }
+        queueDeadline(workerPin);
+    }
+#ifdef IO_URING_BACKEND
+    if (worker.ring)
+    {
+        // NULL data denotes the stop request. The events are polled, not
+        // read, so the stop request stays signalled for all the workers.
+        if (ok && (!worker.ring->poll(stopFd, nullptr) ||
+                   !worker.ring->poll(worker.resumeFd, &worker.resumeFd)))
+        {
+            log<level::ERR>("Failed to post the polls of the worker events");
+            ok = false;
+        }
+        for (auto it = worker.pins.begin(); it != worker.pins.end() && ok;
+             ++it)
+        {
+            for (auto& line : (*it)->lines)
+            {
+                ok = ok && watchLine(worker, line);
+            }
+        }
+    }
+#endif
+
+    // From here on serving the pins must not allocate
+    SteadyStateScope steadyState;
+    bool stopRequested = false;
+    while (ok && !stopRequested)
+    {
+        bool resumed = false;
+        auto wakeUp = Clock::time_point::max();
+        if (!deadlines.empty())
+        {
+            wakeUp = deadlines.top().first;
+        }
+        for (const auto& chip : worker.chips)
+        {
+            if (chip->readRequested)
+            {
+                wakeUp = min(wakeUp, chip->nextAllowed);
+            }
+        }
+        int timeoutMs = -1;
+        if (wakeUp != Clock::time_point::max())
+        {
+            auto untilWakeUp =
+                chrono::ceil<chrono::milliseconds>(wakeUp - Clock::now());
+            timeoutMs = max((int64_t)0, (int64_t)untilWakeUp.count());
+        }
+        worker.heartbeat->waiting(timeoutMs < 0 ? LoopHeartbeat::noTimeout
+                                                : timeoutMs * 1000000ull);
+        int n = waitReady(worker, timeoutMs, ready);
+        worker.heartbeat->woke();
+        globalStats.wakeups.inc();
+        if (n < 0 && errno != EINTR)
+        {
+            int lastErrno = errno;
+            stringstream funcall;
+            if (ioUring)
+            {
+                funcall << "io_uring_submit_and_wait_timeout()";
+            }
+            else
+            {
+                funcall << "epoll_wait(" << worker.epollFd << ")";
+            }
+            logLibgpioCallError(funcall, n, lastErrno);
+            ok = false;
+        }
+        // The lines of the critical pins first, so that they don't wait for
+        // the normal ones ready at the same time
+        for (int pass = 0; pass < 2 && ok; ++pass)
+        {
+            for (int i = 0; i < n && ok; ++i)
+            {
+                void* data = ready[i].data;
+                WorkerLine* workerLine = (WorkerLine*)data;
+                if (data == nullptr)
+                {
+                    stopRequested = true;
+                }
+                else if (data == &worker.resumeFd)
+                {
+                    resumed = true;
+                }
+                else if ((workerLine->workerPin->pin.priority ==
+                          PinPriority::critical) == (pass == 0))
+                {
+#ifdef IO_URING_BACKEND
+                    if (worker.ring)
+                    {
+                        ok = serveCompletion(worker, *workerLine,
+                                             ready[i].result, lineEvents);
+                        continue;
+                    }
+#endif
+                    ok = isSuspended(workerLine->workerPin->pin)
+                             ? park(worker, *workerLine->workerPin)
+                             : serveLine(*workerLine, lineEvents);
+                }
+            }
+        }
+        auto now = Clock::now();
+        while (ok && !stopRequested && !deadlines.empty() &&
+               deadlines.top().first <= now)
+        {
+            WorkerPin* workerPin = deadlines.top().second;
+            deadlines.pop();
+            workerPin->deadlineQueued = false;
+            if (isSuspended(workerPin->pin))
+            {
+                // Back to the queue once the group was resumed
+                ok = park(worker, *workerPin);
+                continue;
+            }
+            if (workerPin->nextPoll <= now)
+            {
+                if (workerPin->chip != nullptr)
+                {
+                    // Back to the queue once the chip was read
+                    requestChipRead(*workerPin, true, 0);
+                    workerPin->deadlineHeld = true;
+                    continue;
+                }
+                if (workerPin->pin.meter)
+                {
+                    ok = measurePin(*workerPin, nullptr, 0);
+                }
+                else if (workerPin->polled != nullptr)
+                {
+                    // Postpones the polls of the other pins of the request
+                    ok = readPolled(*workerPin->polled);
+                }
+                else
+                {
+                    ok = readPin(*workerPin, true, EdgeMeter::nowNs());
+                }
+            }
+            queueDeadline(*workerPin);
+        }
+        for (auto it = worker.chips.begin();
+             it != worker.chips.end() && ok && !stopRequested; ++it)
+        {
+            ChipSchedule& chip = **it;
+            if (chip.readRequested && chip.nextAllowed <= now)
+            {
+                ok = readChip(chip);
+                for (WorkerPin* workerPin : chip.pins)
+                {
+                    if (workerPin->deadlineHeld)
+                    {
+                        workerPin->deadlineHeld = false;
+                        queueDeadline(*workerPin);
+                    }
+                }
+            }
+        }
+        if (resumed && ok && !stopRequested)
+        {
+            // Reset the event before looking at the pins, the groups resumed
+            // after that signal it again
+            uint64_t signalled;
+            if (read(worker.resumeFd, &signalled, sizeof(signalled)) < 0 &&
+                errno != EAGAIN)
+            {
+                log<level::ERR>("Failed to reset the resumed pin group event");
+            }
+#ifdef IO_URING_BACKEND
+            // A poll completes once, the next resumption needs another
+            if (worker.ring &&
+                !worker.ring->poll(worker.resumeFd, &worker.resumeFd))
+            {
+                log<level::ERR>("Failed to post the poll of the resumed pin "
+                                "group event");
+                ok = false;
+            }
+#endif
+            for (auto it = worker.pins.begin(); it != worker.pins.end() && ok;
+                 ++it)
+            {
+                WorkerPin& workerPin = **it;
+                if (workerPin.parked && !isSuspended(workerPin.pin))
+                {
+                    ok = unpark(worker, workerPin);
+                    if (ok && !workerPin.deadlineQueued &&
+                        !workerPin.deadlineHeld)
+                    {
+                        queueDeadline(workerPin);
+                    }
+                }
+            }
+        }
+    }
+    worker.heartbeat->stopped();
+    if (!ok)
+    {
+        stopService(1);
+    }
+}
+
+int GpioWorkerPool::waitReady(Worker& worker, int timeoutMs,
+                              ReadyLine* ready) noexcept
+{
+#ifdef IO_URING_BACKEND
+    if (worker.ring)
+    {
+        GpioEventRing::Completion completions[maxEpollEvents];
+        int n = worker.ring->wait(timeoutMs, completions, maxEpollEvents);
+        for (int i = 0; i < n; ++i)
+        {
+            ready[i] = ReadyLine{completions[i].data, completions[i].result};
+        }
+        return n;
+    }
+#endif
+    epoll_event events[maxEpollEvents];
+    int n = epoll_wait(worker.epollFd, events, maxEpollEvents, timeoutMs);
+    for (int i = 0; i < n; ++i)
+    {
+        ready[i] = ReadyLine{events[i].data.ptr, 0};
+    }
+    return n;
+}
+
+bool GpioWorkerPool::park(Worker& worker, WorkerPin& workerPin) noexcept
+{
+    if (workerPin.parked)
+    {
+        return true;
+    }
+    workerPin.parked = true;
+    workerPin.edgeRequested = false;
+    for (auto& line : workerPin.lines)
+    {
+        if (!unwatchLine(worker, line))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GpioWorkerPool::unpark(Worker& worker, WorkerPin& workerPin) noexcept
+{
+    MonitoredPin& pin = workerPin.pin;
+    workerPin.parked = false;
+    // The edges queued while suspended are stale, the fresh reading replaces
+    // them: the group's bulk one, unless an edge came after it. Those
+    // arriving from now on are watched again below.
+    uint64_t lastEdgeNs;
+    uint64_t value;
+    if (!dropLineEvents(pin, lastEdgeNs))
+    {
+        return false;
+    }
+    if (pin.group->takeReading(pin, lastEdgeNs, value))
+    {
+        scheduleNextPoll(workerPin);
+        if (!servePinValue(workerPin, value, false, EdgeMeter::nowNs()))
+        {
+            return false;
+        }
+    }
+    else if (!readPin(workerPin, false, EdgeMeter::nowNs()))
+    {
+        return false;
+    }
+    if (workerPin.chip != nullptr)
+    {
+        chargeChipBudget(*workerPin.chip, pin.lines.size());
+    }
+    for (auto& line : workerPin.lines)
+    {
+        if (!watchLine(worker, line))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GpioWorkerPool::watchLine(Worker& worker, WorkerLine& workerLine) noexcept
+{
+#ifdef IO_URING_BACKEND
+    if (worker.ring)
+    {
+        // A request whose cancellation is still pending is posted again once
+        // cancelled
+        return workerLine.posted || postLineRequest(worker, workerLine, false);
+    }
+#endif
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &workerLine;
+    if (epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, workerLine.eventFd, &ev) != 0)
+    {
+        int lastErrno = errno;
+        const MonitoredPin& pin = workerLine.workerPin->pin;
+        stringstream funcall;
+        funcall << "epoll_ctl(" << worker.epollFd << ", EPOLL_CTL_ADD, "
+                << workerLine.eventFd << ")";
+        logLibgpioCallError(funcall, -1, lastErrno, pin.pinName, pin.chipName,
+                            pin.pinNum);
+        return false;
+    }
+    return true;
+}
+
+bool GpioWorkerPool::unwatchLine(Worker& worker,
+                                 WorkerLine& workerLine) noexcept
+{
+    const MonitoredPin& pin = workerLine.workerPin->pin;
+#ifdef IO_URING_BACKEND
+    if (worker.ring)
+    {
+        // Stays posted until its cancellation completes
+        if (workerLine.posted && !worker.ring->cancel(&workerLine))
+        {
+            stringstream ss;
+            ss << "Cannot cancel the request on the line #" << workerLine.bit
+               << " of <" << pin.chipName << " " << pin.pinNum << ">";
+            logPinOperation<level::ERR>(ss.str().c_str(), pin.pinName,
+                                        pin.chipName, pin.pinNum);
+            return false;
+        }
+        return true;
+    }
+#endif
+    if (epoll_ctl(worker.epollFd, EPOLL_CTL_DEL, workerLine.eventFd,
+                  nullptr) != 0)
+    {
+        int lastErrno = errno;
+        stringstream funcall;
+        funcall << "epoll_ctl(" << worker.epollFd << ", EPOLL_CTL_DEL, "
+                << workerLine.eventFd << ")";
+        logLibgpioCallError(funcall, -1, lastErrno, pin.pinName, pin.chipName,
+                            pin.pinNum);
+        return false;
+    }
+    return true;
+}
+
+bool GpioWorkerPool::serveLine(WorkerLine& workerLine,
+                               struct gpiod_line_event* lineEvents) noexcept
+{
+    WorkerPin& workerPin = *workerLine.workerPin;
+    MonitoredPin& pin = workerPin.pin;
+    int eventsRead = gpiod_line_event_read_fd_multiple(
+        workerLine.eventFd, lineEvents, maxLineEvents);
+    if (eventsRead < 0)
+    {
+        int lastErrno = errno;
+        pin.stats->errors.inc();
+        stringstream funcall;
+        funcall << "gpiod_line_event_read_fd_multiple(<" << pin.chipName << " "
+                << pin.pinNum << ">)";
+        logLibgpioCallError(funcall, eventsRead, lastErrno, pin.pinName,
+                            pin.chipName, pin.pinNum);
+        return false;
+    }
+    return serveEvents(workerLine, lineEvents, eventsRead);
+}
+
+bool GpioWorkerPool::serveEvents(WorkerLine& workerLine,
+                                 const struct gpiod_line_event* lineEvents,
+                                 int eventCount) noexcept
+{
+    WorkerPin& workerPin = *workerLine.workerPin;
+    MonitoredPin& pin = workerPin.pin;
+    for (int j = 0; j < eventCount; ++j)
+    {
+        publisher.onEdge(pin, workerLine.bit, lineEvents[j]);
+    }
+    if (pin.meter)
+    {
+        return measurePin(workerPin, lineEvents, eventCount);
+    }
+    // The change happened at the first edge
+    uint64_t detectedNs = eventCount > 0 ? getEventTimeNs(lineEvents[0])
+                                         : EdgeMeter::nowNs();
+    if (workerPin.chip == nullptr)
+    {
+        return readPin(workerPin, false, detectedNs);
+    }
+    if (pin.priority != PinPriority::critical)
+    {
+        requestChipRead(workerPin, false, detectedNs);
+        return true;
+    }
+    bool ok = readPin(workerPin, false, detectedNs);
+    chargeChipBudget(*workerPin.chip, pin.lines.size());
+    return ok;
+}
+
+#ifdef IO_URING_BACKEND
+bool GpioWorkerPool::postLineRequest(Worker& worker, WorkerLine& workerLine,
+                                     bool poll) noexcept
+{
+    workerLine.polling = poll;
+    workerLine.posted =
+        poll ? worker.ring->poll(workerLine.eventFd, &workerLine)
+             : worker.ring->read(workerLine.eventFd, workerLine.buffer.get(),
+                                 maxLineEvents * sizeof(gpioevent_data),
+                                 &workerLine);
+    if (!workerLine.posted)
+    {
+        const MonitoredPin& pin = workerLine.workerPin->pin;
+        stringstream ss;
+        ss << "Cannot post a request on the line #" << workerLine.bit << " of <"
+           << pin.chipName << " " << pin.pinNum << ">";
+        logPinOperation<level::ERR>(ss.str().c_str(), pin.pinName,
+                                    pin.chipName, pin.pinNum);
+    }
+    return workerLine.posted;
+}
+
+bool GpioWorkerPool::serveCompletion(
+    Worker& worker, WorkerLine& workerLine, int result,
+    struct gpiod_line_event* lineEvents) noexcept
+{
+    WorkerPin& workerPin = *workerLine.workerPin;
+    MonitoredPin& pin = workerPin.pin;
+    workerLine.posted = false;
+    if (result == -EAGAIN && !workerLine.polling)
+    {
+        // Older kernels complete the read of a non-blocking descriptor with
+        // nothing to read rather than waiting for it, poll it first then
+        return workerPin.parked || postLineRequest(worker, workerLine, true);
+    }
+    if (result < 0 && result != -ECANCELED)
+    {
+        pin.stats->errors.inc();
+        stringstream funcall;
+        funcall << (workerLine.polling ? "io_uring poll" : "io_uring read")
+                << "(<" << pin.chipName << " " << pin.pinNum << ">)";
+        logLibgpioCallError(funcall, result, -result, pin.pinName,
+                            pin.chipName, pin.pinNum);
+        return false;
+    }
+    bool ok = true;
+    // The edges read while parked are dropped, as the queued ones
+    if (result >= 0 && !workerPin.parked)
+    {
+        if (isSuspended(pin))
+        {
+            ok = park(worker, workerPin);
+        }
+        else if (!workerLine.polling)
+        {
+            // Converted as by 'gpiod_line_event_read_fd_multiple'
+            int eventCount = result / sizeof(struct gpioevent_data);
+            for (int i = 0; i < eventCount; ++i)
+            {
+                const struct gpioevent_data& event = workerLine.buffer[i];
+                lineEvents[i].ts.tv_sec = event.timestamp / 1000000000ull;
+                lineEvents[i].ts.tv_nsec = event.timestamp % 1000000000ull;
+                lineEvents[i].event_type =
+                    event.id == GPIOEVENT_EVENT_RISING_EDGE
+                        ? GPIOD_LINE_EVENT_RISING_EDGE
+                        : GPIOD_LINE_EVENT_FALLING_EDGE;
+            }
+            ok = serveEvents(workerLine, lineEvents, eventCount);
+        }
+    }
+    // Also a cancelled one, if the pin was resumed meanwhile
+    if (ok && !workerPin.parked)
+    {
+        ok = postLineRequest(worker, workerLine, false);
+    }
+    return ok;
+}
+#endif
+
+void GpioWorkerPool::requestChipRead(WorkerPin& workerPin, bool isPoll,
+                                     uint64_t detectedNs) noexcept
+{
+    // A due poll is picked up by the read without being marked
+    if (!isPoll && !workerPin.edgeRequested)
+    {
+        workerPin.edgeRequested = true;
+        workerPin.edgeDetectedNs = detectedNs;
+    }
+    workerPin.chip->readRequested = true;
+}
+
+bool GpioWorkerPool::readChip(ChipSchedule& chip) noexcept
+{
+    chip.readRequested = false;
+    auto mergeUntil =
+        Clock::now() + chrono::nanoseconds(busReadPolicy.mergeWindowNs);
+    unsigned lineReads = 0;
+    bool ok = true;
+    // Every pin monitored for its edges has its own line request, so they
+    // can't be read by a single bulk call, but they are read back to back.
+    // The polled ones are read with the other pins of their request.
+    for (auto it = chip.pins.begin(); it != chip.pins.end() && ok; ++it)
+    {
+        WorkerPin& workerPin = **it;
+        if (workerPin.polled != nullptr)
+        {
+            if (workerPin.nextPoll <= mergeUntil)
+            {
+                workerPin.polled->readRequested = true;
+            }
+            continue;
+        }
+        if (workerPin.edgeRequested)
+        {
+            workerPin.edgeRequested = false;
+            ok = readPin(workerPin, false, workerPin.edgeDetectedNs);
+        }
+        else if (workerPin.nextPoll <= mergeUntil)
+        {
+            ok = readPin(workerPin, true, EdgeMeter::nowNs());
+        }
+        else
+        {
+            continue;
+        }
+        lineReads += workerPin.pin.lines.size();
+    }
+    for (auto it = chip.polled.begin(); it != chip.polled.end() && ok; ++it)
+    {
+        PolledRequest& request = **it;
+        if (request.readRequested)
+        {
+            request.readRequested = false;
+            ok = readPolled(request);
+            // A single transaction for all the lines
+            ++lineReads;
+        }
+    }
+    chargeChipBudget(chip, lineReads);
+    return ok;
+}
+
+bool GpioWorkerPool::readPolled(PolledRequest& request) noexcept
+{
+    uint64_t values[GPIOD_LINE_BULK_MAX_LINES];
+    uint64_t detectedNs = EdgeMeter::nowNs();
+    bool ok = readPolledLines(request.polled, values);
+    for (auto i = 0u; i < request.pins.size() && ok; ++i)
+    {
+        scheduleNextPoll(*request.pins[i]);
+        ok = servePinValue(*request.pins[i], values[i], true, detectedNs);
+    }
+    return ok;
+}
+
+void GpioWorkerPool::chargeChipBudget(ChipSchedule& chip,
+                                      unsigned lineReads) noexcept
+{
+    if (busReadPolicy.transactionsPerSec > 0)
+    {
+        chip.nextAllowed =
+            max(chip.nextAllowed, Clock::now()) +
+            chrono::nanoseconds((int64_t)(lineReads * 1e9 /
+                                          busReadPolicy.transactionsPerSec));
+    }
+}
+
+bool GpioWorkerPool::readPin(WorkerPin& workerPin, bool isPoll,
+                             uint64_t detectedNs) noexcept
+{
+    MonitoredPin& pin = workerPin.pin;
+    uint64_t value;
+    bool readOk = readPinValue(pin, value);
+    scheduleNextPoll(workerPin);
+    return readOk && servePinValue(workerPin, value, isPoll, detectedNs);
+}
+
+void GpioWorkerPool::scheduleNextPoll(WorkerPin& workerPin) noexcept
+{
+    workerPin.nextPoll =
+        Clock::now() + chrono::nanoseconds(workerPin.pin.readPeriodNs);
+}
+
+bool GpioWorkerPool::servePinValue(WorkerPin& workerPin, uint64_t value,
+                                   bool isPoll, uint64_t detectedNs) noexcept
+{
+    MonitoredPin& pin = workerPin.pin;
+    if (isPoll)
+    {
+        pin.stats->polls.inc();
+        if (workerPin.hasLastValue && value != workerPin.lastValue)
+        {
+            pin.stats->pollChanges.inc();
+        }
+    }
+    workerPin.hasLastValue = true;
+    workerPin.lastValue = value;
+    if (pin.priority == PinPriority::critical)
+    {
+        // The fast path, published by this thread right away
+        return publisher.publish(pin, value, detectedNs);
+    }
+    if (value != workerPin.handedValue)
+    {
+        workerPin.handedValue = value;
+        handOver(workerPin, value, detectedNs);
+    }
+    else
+    {
+        pin.stats->writesSuppressed.inc();
+    }
+    return true;
+}
+
+bool GpioWorkerPool::measurePin(WorkerPin& workerPin,
+                                const struct gpiod_line_event* events,
+                                int eventCount) noexcept
+{
+    MonitoredPin& pin = workerPin.pin;
+    EdgeMeter& meter = *pin.meter;
+    PinMeasurement measurement;
+    uint64_t closedNs = EdgeMeter::nowNs();
+    bool ok = true;
+    // Every window closed, by the edges of the batch or by now
+    auto closeWindows = [&](uint64_t timeNs) {
+        while (ok && meter.closeWindow(timeNs, measurement))
+        {
+            if (pin.priority == PinPriority::critical)
+            {
+                ok = publisher.publishMeasurement(pin, measurement, closedNs);
+            }
+            else
+            {
+                handOverMeasurement(workerPin, measurement, closedNs);
+            }
+        }
+    };
+    for (int i = 0; i < eventCount && ok; ++i)
+    {
+        uint64_t edgeNs = getEventTimeNs(events[i]);
+        closeWindows(edgeNs);
+        meter.onEdge(edgeNs,
+                     events[i].event_type == GPIOD_LINE_EVENT_RISING_EDGE);
+    }
+    closeWindows(closedNs);
+    // The steady clock is the CLOCK_MONOTONIC of the meter
+    workerPin.nextPoll =
+        Clock::time_point(chrono::nanoseconds(meter.getWindowEndNs()));
+    return ok;
+}
+
+void GpioWorkerPool::handOver(WorkerPin& workerPin, uint64_t pinValue,
+                              uint64_t detectedNs) noexcept
+{
+    // Once per published change, like the hand-over of the measurements
+    lock_guard<mutex> lock(handedOverMutex);
+    workerPin.pendingValue = pinValue;
+    workerPin.pendingDetectedNs = detectedNs;
+    if (!workerPin.queued.exchange(true, memory_order_acq_rel))
+    {
+        enqueue(workerPin);
+    }
+}
+
+void GpioWorkerPool::handOverMeasurement(WorkerPin& workerPin,
+                                         const PinMeasurement& measurement,
+                                         uint64_t closedNs) noexcept
+{
+    // At most once per measurement window, the lock is cheap enough
+    lock_guard<mutex> lock(handedOverMutex);
+    unsigned& count = workerPin.pendingMeasurementCount;
+    if (count == maxPendingMeasurements)
+    {
+        // The DBus thread is that far behind, drop the oldest window
+        workerPin.pin.stats->errors.inc();
+        move(workerPin.pendingMeasurements.begin() + 1,
+             workerPin.pendingMeasurements.end(),
+             workerPin.pendingMeasurements.begin());
+        move(workerPin.pendingMeasurementsNs.begin() + 1,
+             workerPin.pendingMeasurementsNs.end(),
+             workerPin.pendingMeasurementsNs.begin());
+        --count;
+    }
+    workerPin.pendingMeasurements[count] = measurement;
+    workerPin.pendingMeasurementsNs[count] = closedNs;
+    ++count;
+    if (!workerPin.queued.exchange(true, memory_order_acq_rel))
+    {
+        enqueue(workerPin);
+    }
+}
+
+// Called with 'handedOverMutex' locked
+void GpioWorkerPool::enqueue(WorkerPin& workerPin) noexcept
+{
+    handedOver.push_back(&workerPin);
+    if (!drainPosted)
+    {
+        drainPosted = true;
+        uint64_t one = 1;
+        if (write(drainFd, &one, sizeof(one)) != sizeof(one))
+        {
+            log<level::ERR>("Failed to signal the hand-over to the DBus "
+                            "thread");
+        }
+    }
+}
+
+// Runs on the DBus server thread, except for the first call by 'start'
+void GpioWorkerPool::waitForHandOver()
+{
+    drainEvent.async_wait(boost::asio::posix::descriptor_base::wait_read,
+                          [this](const boost::system::error_code& ec) {
+                              if (!ec)
+                              {
+                                  SteadyStateScope steadyState;
+                                  drainHandedOver();
+                                  waitForHandOver();
+                              }
+                          });
+}
+
+// Runs on the DBus server thread
+void GpioWorkerPool::drainHandedOver() noexcept
+{
+    // Reset the event before taking the pins, the workers signal it again
+    // for any pin handed over after the swap below
+    uint64_t signalled;
+    if (read(drainFd, &signalled, sizeof(signalled)) < 0 && errno != EAGAIN)
+    {
+        log<level::ERR>("Failed to reset the hand-over event");
+    }
+    {
+        lock_guard<mutex> lock(handedOverMutex);
+        swap(handedOver, draining);
+        drainPosted = false;
+    }
+    bool ok = true;
+    for (auto it = draining.begin(); it != draining.end() && ok; ++it)
+    {
+        WorkerPin* workerPin = *it;
+        if (workerPin->pin.meter)
+        {
+            // Dequeue before taking the measurements, so that one handed
+            // over in between re-queues the pin rather than getting lost
+            workerPin->queued.exchange(false, memory_order_acq_rel);
+            array<PinMeasurement, maxPendingMeasurements> measurements;
+            array<uint64_t, maxPendingMeasurements> closedNs;
+            unsigned count;
+            {
+                lock_guard<mutex> lock(handedOverMutex);
+                measurements = workerPin->pendingMeasurements;
+                closedNs = workerPin->pendingMeasurementsNs;
+                count = workerPin->pendingMeasurementCount;
+                workerPin->pendingMeasurementCount = 0;
+            }
+            for (auto i = 0u; i < count && ok; ++i)
+            {
+                ok = publisher.publishMeasurement(
+                    workerPin->pin, measurements[i], closedNs[i]);
+            }
+        }
+        else
+        {
+            uint64_t value;
+            uint64_t detectedNs;
+            {
+                // The value with its own detection time, the pin dequeued
+                // at once so that a later value queues it again
+                lock_guard<mutex> lock(handedOverMutex);
+                workerPin->queued.exchange(false, memory_order_acq_rel);
+                value = workerPin->pendingValue;
+                detectedNs = workerPin->pendingDetectedNs;
+            }
+            ok = publisher.publish(workerPin->pin, value, detectedNs);
+        }
+    }
+    draining.clear();
+    if (!ok)
+    {
+        stopService(1);
+    }
+}
+
+} // namespace gpio_handler
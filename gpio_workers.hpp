@@ -0,0 +1,217 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_publisher.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gpio_handler
+{
+
+/** @brief How the pins on the gpio chips behind a slow bus are read, see @ref
+ * GpioWorkerPool **/
+struct BusReadPolicy
+{
+    /** @brief The chips behind a bus, see @ref isBusAttachedChip **/
+    std::set<std::string> chipNames;
+    /** @brief Line reads allowed per second per chip, 0 for no limit. A bulk
+     * read of the polled lines of the chip counts as one. **/
+    double transactionsPerSec = 0;
+    /** @brief The polls due within this window after a read of the chip are
+     * done by that read [nanoseconds] **/
+    uint64_t mergeWindowNs = 0;
+};
+
+/**
+ * @brief Alternative to the thread per pin model: a fixed number of worker
+ * threads, each serving the pins of a disjoint set of gpio chips
+ *
+ * Every chip is assigned to exactly one worker, so a slow chip (like an I2C
+ * gpio expander, where every line access is a bus transaction) never delays
+ * the pins on another chip served by a different worker. The chips are
+ * distributed so that the number of pins per worker is balanced (largest
+ * chips first, each to the least loaded worker).
+ *
+ * A worker owns an epoll set with the event file descriptors of all its lines.
+ * It sleeps until an edge arrives or the earliest polling deadline among its
+ * pins expires, so an idle worker causes no periodic wakeups.
+ *
+ * The workers don't publish the values themselves. They hand them over to the
+ * DBus server thread (the one running the @io context), which publishes the
+ * latest value of every changed pin. A pin changing faster than the DBus
+ * thread can publish is coalesced to its latest value, taken together with
+ * its detection time under the hand-over lock. The DBus thread is
+ * woken up through an event descriptor it waits on, so handing over allocates
+ * no memory, unlike posting a handler.
+ *
+ * The pins in the "measure" mode feed their edges to the pin's meter instead
+ * of being read, and their polling deadline is the end of the current
+ * measurement window. The measurement of every closed window is handed over
+ * the same way as the values, but queued rather than coalesced, so that every
+ * window is published. Only if the DBus thread falls several windows behind
+ * are the oldest of them dropped, counted as errors of the pin.
+ *
+ * The critical pins skip the hand-over: their worker publishes them right
+ * away, and serves their lines before those of the normal pins that became
+ * ready at the same time.
+ *
+ * The pins on the chips of the @ref BusReadPolicy (like I2C gpio expanders)
+ * are not read one by one on their own schedule. A due poll or an edge only
+ * requests a read of the chip. The chip read takes all the requested pins,
+ * and the pins whose polls are due within the merge window, in one burst of
+ * bus transactions. The chip reads are spaced so that the chip sees at most
+ * the allowed number of line reads per second, the requests arriving in
+ * between are coalesced into the next read. Only the edges of the critical
+ * pins are read right away, their reads are still charged to the budget.
+ *
+ * The polled pins sharing a line request (see @ref PolledLines) have no
+ * lines in the epoll set. Whenever the poll of any of them is due, all of them
+ * are read by a single bulk read and their polls postponed, so the request is
+ * read at the shortest read period among its pins. Behind a bus, that bulk
+ * read is done by the chip read.
+ *
+ * A pin of a suspended group (see @ref GpioPinGroups) is parked at its next
+ * edge or deadline: its lines leave the epoll set and its deadline the queue,
+ * so it wakes up its worker no more. The groups signal their resumption to the
+ * workers of their pins through an event descriptor in the epoll sets. The
+ * worker then puts the resumed pins back, drops the edges queued meanwhile,
+ * and reads and publishes the pins afresh.
+ *
+ * In the io_uring mode (see @ref GpioEventRing, a build option) a worker
+ * owns an io_uring instead of the epoll set. A read stays posted on every line
+ * event descriptor, so the edges of a line arrive already read, and the reads
+ * are posted again, the completions reaped and the next ones waited for by a
+ * single system call per wakeup, whatever the number of lines served by it. A
+ * parked pin has its reads cancelled instead of leaving the epoll set.
+ *
+ * The pins whose gpio chip is missing at the start are left out, they get a
+ * thread of their own once attached (see @ref GpioHotplug). A removal of a
+ * chip served by a worker stops the service.
+ */
+class GpioWorkerPool
+{
+  public:
+    /**
+     * @brief Distribute the @pins among @workerCount workers and create their
+     * epoll sets or io_urings. The workers are not started yet.
+     *
+     * The @pins must have their lines requested for the edge events. The
+     * @pins, the @publisher and the @io context are assumed to outlive this
+     * object.
+     *
+     * The pins on the chips in the @busReadPolicy are read according to it.
+     * Every worker reports its waits to the @loopMonitor, which must outlive
+     * this object too.
+     *
+     * With @ioUring the workers own an io_uring rather than an epoll set, and
+     * the line event descriptors are made non-blocking.
+     *
+     * Throw @ref std::system_error if any epoll, io_uring or eventfd call
+     * failed, @ref std::invalid_argument if @ioUring is set but the service
+     * was built without the io_uring support. Strong exception guarantee.
+     */
+    GpioWorkerPool(boost::asio::io_context& io, GpioPublisher& publisher,
+                   std::vector<MonitoredPin>& pins, unsigned workerCount,
+                   GpioLoopMonitor& loopMonitor,
+                   const BusReadPolicy& busReadPolicy = {},
+                   bool ioUring = false);
+
+    /** @brief Stop the workers, if not stopped yet, and release the epoll
+     * sets or io_urings **/
+    ~GpioWorkerPool();
+
+    GpioWorkerPool(const GpioWorkerPool&) = delete;
+    GpioWorkerPool& operator=(const GpioWorkerPool&) = delete;
+
+    /**
+     * @brief Start all the worker threads.
+     *
+     * Any error in a worker stops the whole service (see @ref stopService).
+     */
+    void start();
+
+    /** @brief Signal all the workers to finish and wait until they did **/
+    void stop() noexcept;
+
+  private:
+    struct WorkerLine;
+    struct WorkerPin;
+    struct PolledRequest;
+    struct ChipSchedule;
+    struct Worker;
+    struct ReadyLine;
+
+    boost::asio::io_context& io;
+    GpioPublisher& publisher;
+    BusReadPolicy busReadPolicy;
+    /** @brief The workers own an io_uring rather than an epoll set **/
+    bool ioUring;
+    std::vector<std::unique_ptr<WorkerPin>> workerPins;
+    std::vector<std::unique_ptr<Worker>> workers;
+    /** @brief Event descriptor in every epoll set (or polled by every
+     * io_uring), signalled to stop **/
+    int stopFd = -1;
+
+    /** @brief Pins handed over to the DBus thread, not published yet **/
+    std::vector<WorkerPin*> handedOver;
+    /** @brief Pins being published by the DBus thread **/
+    std::vector<WorkerPin*> draining;
+    std::mutex handedOverMutex;
+    /** @brief True if @ref drainEvent was signalled and not drained yet **/
+    bool drainPosted = false;
+    /** @brief Event descriptor signalled by the workers when the first pin is
+     * handed over, waited on by the DBus thread **/
+    boost::asio::posix::stream_descriptor drainEvent;
+    /** @brief The descriptor of @ref drainEvent, owned by it **/
+    int drainFd = -1;
+
+    void runWorker(Worker& worker) noexcept;
+    int waitReady(Worker& worker, int timeoutMs, ReadyLine* ready) noexcept;
+    bool park(Worker& worker, WorkerPin& workerPin) noexcept;
+    bool unpark(Worker& worker, WorkerPin& workerPin) noexcept;
+    bool watchLine(Worker& worker, WorkerLine& workerLine) noexcept;
+    bool unwatchLine(Worker& worker, WorkerLine& workerLine) noexcept;
+    bool serveLine(WorkerLine& workerLine,
+                   struct gpiod_line_event* lineEvents) noexcept;
+    bool serveEvents(WorkerLine& workerLine,
+                     const struct gpiod_line_event* lineEvents,
+                     int eventCount) noexcept;
+#ifdef IO_URING_BACKEND
+    void createRing(Worker& worker);
+    bool postLineRequest(Worker& worker, WorkerLine& workerLine,
+                         bool poll) noexcept;
+    bool serveCompletion(Worker& worker, WorkerLine& workerLine, int result,
+                         struct gpiod_line_event* lineEvents) noexcept;
+#endif
+    bool readPin(WorkerPin& workerPin, bool isPoll,
+                 uint64_t detectedNs) noexcept;
+    void scheduleNextPoll(WorkerPin& workerPin) noexcept;
+    bool servePinValue(WorkerPin& workerPin, uint64_t value, bool isPoll,
+                       uint64_t detectedNs) noexcept;
+    void requestChipRead(WorkerPin& workerPin, bool isPoll,
+                         uint64_t detectedNs) noexcept;
+    bool readChip(ChipSchedule& chip) noexcept;
+    bool readPolled(PolledRequest& request) noexcept;
+    void chargeChipBudget(ChipSchedule& chip, unsigned lineReads) noexcept;
+    bool measurePin(WorkerPin& workerPin,
+                    const struct gpiod_line_event* events,
+                    int eventCount) noexcept;
+    void handOver(WorkerPin& workerPin, uint64_t pinValue,
+                  uint64_t detectedNs) noexcept;
+    void handOverMeasurement(WorkerPin& workerPin,
+                             const PinMeasurement& measurement,
+                             uint64_t closedNs) noexcept;
+    void enqueue(WorkerPin& workerPin) noexcept;
+    void waitForHandOver();
+    void drainHandedOver() noexcept;
+};
+
+} // namespace gpio_handler
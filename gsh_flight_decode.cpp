@@ -0,0 +1,107 @@
+#include <gpio_flight_recorder.hpp>
+
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <string>
+
+using namespace std;
+using namespace gpio_handler;
+
+/**
+ * @file
+ *
+ * gsh-flight-decode: print the records of a flight recorder file written by
+ * the gpio status handler (see @ref FlightRecorder), the oldest first
+ *
+ *   $ gsh-flight-decode <file>
+ *
+ * Every record is printed on its own line as the wall clock time, the
+ * CLOCK_MONOTONIC time and the event:
+ *
+ *   2026-10-18T09:15:02.123456789 1234.567890123 I2C3_ALERT falling
+ *   2026-10-18T09:15:02.123501234 1234.567934568 I2C3_ALERT = 0
+ *
+ * The wall clock time is derived from the clock offset at the start of the
+ * service, so it's off by the clock adjustments made since.
+ */
+
+static const string& getName(const vector<string>& names, uint16_t index,
+                             string& unknown)
+{
+    if (index < names.size())
+    {
+        return names[index];
+    }
+    unknown = "#" + to_string(index);
+    return unknown;
+}
+
+static void printRecord(const FlightRecordReader& reader,
+                        const FlightRecord& record)
+{
+    int64_t realtimeNs = (int64_t)record.timestampNs +
+                         reader.getRealtimeOffsetNs();
+    time_t seconds = realtimeNs / 1000000000;
+    struct tm time;
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S",
+             localtime_r(&seconds, &time));
+    printf("%s.%09" PRId64 " %" PRIu64 ".%09" PRIu64 " ", date,
+           realtimeNs % 1000000000, record.timestampNs / 1000000000,
+           record.timestampNs % 1000000000);
+
+    string unknown;
+    switch ((FlightRecordType)record.type)
+    {
+        case FlightRecordType::fallingEdge:
+        case FlightRecordType::risingEdge:
+            printf("%s %s",
+                   getName(reader.getPinNames(), record.index, unknown)
+                       .c_str(),
+                   record.type == (uint8_t)FlightRecordType::risingEdge
+                       ? "rising"
+                       : "falling");
+            if (record.bit != 0)
+            {
+                printf(" bit %u", (unsigned)record.bit);
+            }
+            break;
+        case FlightRecordType::published:
+            printf("%s = %" PRIu64,
+                   getName(reader.getPropertyNames(), record.index, unknown)
+                       .c_str(),
+                   record.value);
+            break;
+        default:
+            printf("unknown record type %u", (unsigned)record.type);
+    }
+    putchar('\n');
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <flight recorder file>\n", argv[0]);
+        return 1;
+    }
+    try
+    {
+        FlightRecordReader reader(argv[1]);
+        const auto& records = reader.getRecords();
+        printf("# %s: %" PRIu64 " records appended, the last %zu kept\n",
+               argv[1], reader.getAppendedCount(), records.size());
+        for (const auto& record : records)
+        {
+            printRecord(reader, record);
+        }
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
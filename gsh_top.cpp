@@ -0,0 +1,355 @@
+#include <boost/asio/steady_timer.hpp>
+#include <gpio_status_client.hpp>
+#include <gpio_status_dbus.hpp>
+#include <sdbusplus/asio/connection.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+using namespace std;
+using namespace gpio_handler;
+
+/**
+ * @file
+ *
+ * gsh-top: a live view of the pins monitored by the gpio status handler
+ *
+ * Every refresh period the program reads all the properties of the @ref
+ * dbusStatsInterfaceName interface with a single 'GetAll' call and prints a
+ * table of the pins sorted by their activity, the busiest first. The pin
+ * values come from a @ref GpioStatusClient following the 'PropertiesChanged'
+ * signals of the service, which also dates the last change of every pin.
+ *
+ * The service is never polled for anything else, so watching it costs it one
+ * 'GetAll' per refresh period plus the signals it emits anyway.
+ *
+ *   $ gsh-top [-d <refresh period [s]>] [-n <refreshes>] [-b]
+ */
+
+/** @brief Per pin counters of the 'Stats' interface, see @ref PinStats **/
+using PinStatsTuple =
+    tuple<uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t>;
+
+/** @brief Count, total and maximum of @ref LatencyStats **/
+using LatencyStatsTuple = tuple<uint64_t, uint64_t, uint64_t>;
+
+/** @brief Property value types of the @ref dbusStatsInterfaceName
+ * interface **/
+using StatsValue = variant<uint64_t, double, PinStatsTuple, LatencyStatsTuple,
+                           map<string, LatencyStatsTuple>>;
+
+/** @brief Suffix of the frequency property of the pins in the "measure"
+ * mode **/
+constexpr auto frequencyPropertySuffix = "_FrequencyMilliHz";
+
+/** @brief One 'GetAll' reply of the 'Stats' interface **/
+struct StatsSample
+{
+    chrono::steady_clock::time_point time;
+    map<string, PinStatsTuple> pins;
+    map<string, LatencyStatsTuple> pinLatencies;
+    double wakeupsPerSecond = 0;
+};
+
+/** @brief A row of the printed table **/
+struct PinRow
+{
+    string name;
+    string value;
+    double edgesPerSec;
+    double writesPerSec;
+    string lastChange;
+    double latencyAvgUs;
+    double latencyMaxUs;
+    uint64_t errors;
+};
+
+/** @brief State of the viewer kept between the refreshes **/
+struct GshTop
+{
+    boost::asio::io_context& io;
+    shared_ptr<sdbusplus::asio::connection> conn;
+    boost::asio::steady_timer timer;
+    chrono::duration<double> period;
+    unsigned refreshesLeft;
+    bool batch;
+    GpioStatusClient client;
+    map<string, chrono::steady_clock::time_point> lastChanges;
+    optional<StatsSample> previous;
+
+    GshTop(boost::asio::io_context& io,
+           shared_ptr<sdbusplus::asio::connection> conn, double periodSec,
+           unsigned refreshes, bool batch) :
+        io(io),
+        conn(conn), timer(io), period(periodSec), refreshesLeft(refreshes),
+        batch(batch),
+        client(conn, {}, [this](const string& propertyName, uint64_t) {
+            // The values of the initial synchronization are not changes
+            if (client.isSynchronized())
+            {
+                lastChanges[propertyName] = chrono::steady_clock::now();
+            }
+        })
+    {}
+};
+
+static string formatValue(const GpioStatusClient& client, const string& name)
+{
+    char text[32];
+    if (auto value = client.getValue(name))
+    {
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)*value);
+        return text;
+    }
+    if (auto frequency = client.getValue(name + frequencyPropertySuffix))
+    {
+        snprintf(text, sizeof(text), "%.1fHz", *frequency / 1000.0);
+        return text;
+    }
+    return "-";
+}
+
+static string formatAge(const GshTop& top, const string& name,
+                        chrono::steady_clock::time_point now)
+{
+    auto change = top.lastChanges.find(name);
+    if (change == top.lastChanges.end())
+    {
+        change = top.lastChanges.find(name + frequencyPropertySuffix);
+    }
+    if (change == top.lastChanges.end())
+    {
+        return "-";
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "%.1fs ago",
+             chrono::duration<double>(now - change->second).count());
+    return text;
+}
+
+/**
+ * @brief Build the table rows from the difference between the @current and
+ * the previous sample
+ *
+ * The rates and the latencies are those of the refresh period. The first
+ * sample has no previous one, so its rates are 0 and its latencies cover the
+ * whole lifetime of the service.
+ */
+static vector<PinRow> getPinRows(const GshTop& top,
+                                 const StatsSample& current)
+{
+    double elapsedSec = 0;
+    if (top.previous)
+    {
+        elapsedSec =
+            chrono::duration<double>(current.time - top.previous->time)
+                .count();
+    }
+    vector<PinRow> rows;
+    for (const auto& [name, stats] : current.pins)
+    {
+        PinStatsTuple before{};
+        LatencyStatsTuple latencyBefore{};
+        if (top.previous)
+        {
+            auto pin = top.previous->pins.find(name);
+            if (pin != top.previous->pins.end())
+            {
+                before = pin->second;
+            }
+            auto latency = top.previous->pinLatencies.find(name);
+            if (latency != top.previous->pinLatencies.end())
+            {
+                latencyBefore = latency->second;
+            }
+        }
+        LatencyStatsTuple latency{};
+        auto pinLatency = current.pinLatencies.find(name);
+        if (pinLatency != current.pinLatencies.end())
+        {
+            latency = pinLatency->second;
+        }
+        uint64_t count = get<0>(latency) - get<0>(latencyBefore);
+        uint64_t totalNs = get<1>(latency) - get<1>(latencyBefore);
+
+        PinRow row;
+        row.name = name;
+        row.value = formatValue(top.client, name);
+        row.edgesPerSec =
+            elapsedSec > 0 ? (get<0>(stats) - get<0>(before)) / elapsedSec : 0;
+        row.writesPerSec =
+            elapsedSec > 0 ? (get<3>(stats) - get<3>(before)) / elapsedSec : 0;
+        row.lastChange = formatAge(top, name, current.time);
+        row.latencyAvgUs = count > 0 ? totalNs / 1e3 / count : 0;
+        // The service keeps the maximum since its start only
+        row.latencyMaxUs = get<2>(latency) / 1e3;
+        row.errors = get<5>(stats);
+        rows.push_back(move(row));
+    }
+    sort(rows.begin(), rows.end(), [](const PinRow& a, const PinRow& b) {
+        return tie(b.edgesPerSec, b.writesPerSec, a.name) <
+               tie(a.edgesPerSec, a.writesPerSec, b.name);
+    });
+    return rows;
+}
+
+static void printTable(const GshTop& top, const StatsSample& current)
+{
+    if (!top.batch)
+    {
+        // Cursor home and clear the screen
+        fputs("\033[H\033[2J", stdout);
+    }
+    printf("%s: %zu pins, %.1f wakeups/s\n\n", dbusServiceName,
+           current.pins.size(), current.wakeupsPerSecond);
+    printf("%-24s %10s %9s %9s %12s %10s %10s %7s\n", "PIN", "VALUE",
+           "EDGES/s", "WRITES/s", "CHANGED", "LAT avg", "LAT max",
+           "ERRORS");
+    for (const PinRow& row : getPinRows(top, current))
+    {
+        printf("%-24s %10s %9.1f %9.1f %12s %8.1fus %8.1fus %7llu\n",
+               row.name.c_str(), row.value.c_str(), row.edgesPerSec,
+               row.writesPerSec, row.lastChange.c_str(), row.latencyAvgUs,
+               row.latencyMaxUs, (unsigned long long)row.errors);
+    }
+    if (top.batch)
+    {
+        putchar('\n');
+    }
+    fflush(stdout);
+}
+
+static StatsSample toStatsSample(const map<string, StatsValue>& properties)
+{
+    StatsSample sample;
+    sample.time = chrono::steady_clock::now();
+    for (const auto& [name, value] : properties)
+    {
+        if (auto pin = get_if<PinStatsTuple>(&value))
+        {
+            sample.pins[name] = *pin;
+        }
+        else if (auto latencies =
+                     get_if<map<string, LatencyStatsTuple>>(&value))
+        {
+            sample.pinLatencies = *latencies;
+        }
+        else if (name == "WakeupsPerSecond")
+        {
+            if (auto rate = get_if<double>(&value))
+            {
+                sample.wakeupsPerSecond = *rate;
+            }
+        }
+    }
+    return sample;
+}
+
+static void scheduleRefresh(GshTop& top);
+
+static void refresh(GshTop& top)
+{
+    top.conn->async_method_call(
+        [&top](const boost::system::error_code& ec,
+               const map<string, StatsValue>& properties) {
+            if (ec)
+            {
+                fprintf(stderr, "Reading %s failed: %s\n",
+                        dbusStatsInterfaceName, ec.message().c_str());
+            }
+            else
+            {
+                StatsSample current = toStatsSample(properties);
+                printTable(top, current);
+                top.previous = move(current);
+            }
+            if (top.refreshesLeft > 0 && --top.refreshesLeft == 0)
+            {
+                top.io.stop();
+                return;
+            }
+            scheduleRefresh(top);
+        },
+        dbusServiceName, dbusObjectPath, "org.freedesktop.DBus.Properties",
+        "GetAll", dbusStatsInterfaceName);
+}
+
+static void scheduleRefresh(GshTop& top)
+{
+    top.timer.expires_after(
+        chrono::duration_cast<chrono::steady_clock::duration>(top.period));
+    top.timer.async_wait([&top](const boost::system::error_code& ec) {
+        if (!ec)
+        {
+            refresh(top);
+        }
+    });
+}
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [-d <seconds>] [-n <count>] [-b]\n"
+            "  -d  refresh period, 1 second by default\n"
+            "  -n  number of refreshes before exiting, unlimited by default\n"
+            "  -b  batch mode, append the tables instead of redrawing\n",
+            program);
+}
+
+int main(int argc, char* argv[])
+{
+    double periodSec = 1;
+    unsigned refreshes = 0;
+    bool batch = false;
+    bool argsGood = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:b")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+            {
+                char* end = nullptr;
+                periodSec = strtod(optarg, &end);
+                argsGood = argsGood && *end == '\0' && periodSec > 0;
+                break;
+            }
+            case 'n':
+            {
+                char* end = nullptr;
+                refreshes = strtoul(optarg, &end, 10);
+                argsGood = argsGood && *end == '\0';
+                break;
+            }
+            case 'b':
+                batch = true;
+                break;
+            default:
+                argsGood = false;
+        }
+    }
+    if (!argsGood || optind != argc)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    boost::asio::io_context io;
+    auto conn = make_shared<sdbusplus::asio::connection>(io);
+    GshTop top(io, conn, periodSec, refreshes, batch);
+    // The first table has no rates yet, the later ones cover a period each
+    refresh(top);
+    io.run();
+    return 0;
+}
@@ -0,0 +1,1270 @@
+#!/usr/bin/env python3
+"""Generate the C++ validator and typed structs of the gpio config.
+
+Usage: gen_config_validator.py <schema.json> <output.hpp> <output.cpp>
+       gen_config_validator.py --embed <schema.json> <config.json> <output.hpp>
+
+The generator understands only the subset of JSON Schema used by
+'gpio-config-schema.json': a root object whose entries are described by a
+single 'patternProperties' schema of the form '^[<char class>]+$'. An entry is
+an object with scalar or array-of-scalar properties, an optional 'oneOf' list
+of branches selecting among them (by 'required', 'not': {'required'} or
+'not': {'anyOf': [{'required'}...]} and scalar 'properties' constraints), an
+optional 'allOf' list of further such 'oneOf' lists, exactly one branch of each
+list having to match, and no additional properties. Strings may be restricted
+by a 'pattern' of the same '^[<char class>]+$' form, or of the
+'^[<char class>][<char class>]*$' one restricting the first character apart.
+Any other keyword stops the generation with an error, so that the schema and
+the generated code can't silently diverge.
+
+For every entry property the generated struct 'GpioPinConfig' gets a field
+named after it in camel case. The properties not required by the entry schema
+itself are 'std::optional'. A property with several types becomes a
+'std::variant' of them, in the order listed. Integers with a non-negative
+'minimum' are 'uint64_t', other integers 'int64_t', numbers 'double'.
+
+The generated 'parseGpioConfig' checks and converts the whole config in a
+single pass over the json DOM. On error it reports the JSON pointer of the
+offending value and a static description of what was expected there.
+
+The generated 'GpioEmbeddedPinConfig' is the literal type counterpart of
+'GpioPinConfig' ('std::string_view' for strings, 'std::span' for arrays), so
+that a config can be a 'constexpr' table. With '--embed' the generator checks
+the given config against the schema, by the same rules as 'parseGpioConfig',
+and writes it as such a table sorted by name. The config must also pass the
+checks 'GpioJsonConfig' makes beyond the schema on a config file at startup:
+unique property names, the measured entries' included, and a valid syntax of
+the actions. A config failing any of them stops the generation with an error
+pointing at the offending value, so that the embedded table needs no check at
+startup.
+"""
+
+import json
+import re
+import sys
+import textwrap
+
+ROOT_KEYWORDS = {
+    "type",
+    "description",
+    "minProperties",
+    "patternProperties",
+    "additionalProperties",
+}
+ENTRY_KEYWORDS = {
+    "type",
+    "description",
+    "required",
+    "properties",
+    "oneOf",
+    "allOf",
+    "additionalProperties",
+}
+BRANCH_KEYWORDS = {"required", "not", "properties", "description"}
+VALUE_KEYWORDS = {
+    "type",
+    "description",
+    "enum",
+    "minimum",
+    "exclusiveMinimum",
+    "maximum",
+    "items",
+    "minItems",
+    "maxItems",
+    "uniqueItems",
+    "pattern",
+}
+
+
+# The suffixes of the properties of a measured entry, as
+# 'GpioJsonConfig::measurementPropertySuffixes'
+MEASUREMENT_PROPERTY_SUFFIXES = [
+    "_EdgeCount",
+    "_FrequencyMilliHz",
+    "_DutyCyclePpm",
+]
+# The bounds of the number of arguments of every action, as 'actionSyntax' of
+# 'gpio_json_config.cpp'
+ACTION_ARGUMENTS = {
+    "start_unit": (1, 1),
+    "stop_unit": (1, 1),
+    "restart_unit": (1, 1),
+    "call": (4, None),
+    "write": (2, 2),
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+class ConfigError(Exception):
+    def __init__(self, path, message):
+        super().__init__("%s: %s" % (path or "<root>", message))
+
+
+def check_keywords(schema, allowed, where):
+    unknown = set(schema) - allowed
+    if unknown:
+        raise SchemaError(
+            "%s: unsupported keywords %s" % (where, ", ".join(sorted(unknown)))
+        )
+
+
+def camel_case(name):
+    parts = name.split("_")
+    return parts[0] + "".join(p[:1].upper() + p[1:] for p in parts[1:])
+
+
+def pascal_case(name):
+    camel = camel_case(name)
+    return camel[:1].upper() + camel[1:]
+
+
+def cpp_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def cpp_number(value):
+    if isinstance(value, bool):
+        raise SchemaError("boolean given where a number is expected")
+    if isinstance(value, int):
+        return str(value)
+    return repr(float(value))
+
+
+def is_json_integer(value):
+    return isinstance(value, int) and not isinstance(value, bool)
+
+
+def is_json_number(value):
+    return isinstance(value, (int, float)) and not isinstance(value, bool)
+
+
+def doc_comment(text, indent):
+    """The repo's '/** @brief ... **/' comment, wrapped at 80 columns."""
+    lines = textwrap.wrap(
+        "/** @brief " + text + " **/",
+        width=80 - len(indent),
+        subsequent_indent=" * ",
+        break_long_words=False,
+        break_on_hyphens=False,
+    )
+    return [indent + line for line in lines]
+
+
+class ScalarType:
+    """A json scalar with optional bounds."""
+
+    def __init__(self, schema, json_type, where):
+        self.json_type = json_type
+        self.minimum = schema.get("minimum")
+        self.exclusive_minimum = schema.get("exclusiveMinimum")
+        self.maximum = schema.get("maximum")
+        self.enum = schema.get("enum")
+        self.pattern = schema.get("pattern")
+        # Named by the generator once all the patterns are known
+        self.pattern_function = None
+        if json_type not in ("boolean", "integer", "number", "string"):
+            raise SchemaError("%s: unsupported type '%s'" % (where, json_type))
+        if json_type in ("boolean", "string") and (
+            self.minimum is not None
+            or self.exclusive_minimum is not None
+            or self.maximum is not None
+        ):
+            # Bounds don't apply to non-numbers in JSON Schema
+            self.minimum = self.exclusive_minimum = self.maximum = None
+        if self.pattern is not None:
+            if json_type != "string":
+                raise SchemaError(
+                    "%s: 'pattern' only supported on strings" % where
+                )
+            self.pattern_ranges = parse_name_pattern(self.pattern)
+        if self.enum is not None:
+            if not self.enum or not all(self.check(v) for v in self.enum):
+                raise SchemaError(
+                    "%s: 'enum' values must be of type '%s'" % (where, json_type)
+                )
+
+    def is_unsigned(self):
+        lower = self.minimum
+        if self.exclusive_minimum is not None:
+            lower = self.exclusive_minimum
+        return self.json_type == "integer" and lower is not None and lower >= 0
+
+    def cpp_type(self):
+        if self.json_type == "boolean":
+            return "bool"
+        if self.json_type == "string":
+            return "std::string"
+        if self.json_type == "number":
+            return "double"
+        return "uint64_t" if self.is_unsigned() else "int64_t"
+
+    def condition(self, value):
+        """C++ expression true if the json @value matches."""
+        if self.json_type == "boolean":
+            return value + ".is_boolean()" + self.enum_condition(value)
+        if self.json_type == "string":
+            return (
+                value
+                + ".is_string()"
+                + self.pattern_condition(value)
+                + self.enum_condition(value)
+            )
+        if self.json_type == "number":
+            conditions = [value + ".is_number()"]
+            getter = value + ".get<double>()"
+        elif self.is_unsigned():
+            conditions = [value + ".is_number_unsigned()"]
+            getter = value + ".get<uint64_t>()"
+        else:
+            conditions = [value + ".is_number_integer()"]
+            getter = value + ".get<int64_t>()"
+        if self.minimum is not None and not (
+            self.is_unsigned() and self.minimum == 0
+        ):
+            conditions.append(
+                "%s >= %s" % (getter, cpp_number(self.minimum))
+            )
+        if self.exclusive_minimum is not None:
+            conditions.append(
+                "%s > %s" % (getter, cpp_number(self.exclusive_minimum))
+            )
+        if self.maximum is not None:
+            conditions.append("%s <= %s" % (getter, cpp_number(self.maximum)))
+        return " && ".join(conditions) + self.enum_condition(value)
+
+    def pattern_condition(self, value):
+        if self.pattern is None:
+            return ""
+        return " && %s(%s.get_ref<const json::string_t&>())" % (
+            self.pattern_function,
+            value,
+        )
+
+    def enum_condition(self, value):
+        if self.enum is None:
+            return ""
+        if self.json_type == "string":
+            getter = "%s.get_ref<const json::string_t&>()" % value
+        else:
+            getter = "%s.get<%s>()" % (value, self.cpp_type())
+        return " && (%s)" % " || ".join(
+            "%s == %s" % (getter, self.literal(v)) for v in self.enum
+        )
+
+    def embedded_type(self):
+        if self.json_type == "string":
+            return "std::string_view"
+        return self.cpp_type()
+
+    def check(self, value):
+        """Python counterpart of @ref condition."""
+        if self.enum is not None and value not in self.enum:
+            return False
+        if self.json_type == "boolean":
+            return isinstance(value, bool)
+        if self.json_type == "string":
+            return isinstance(value, str) and (
+                self.pattern is None
+                or matches_ranges(self.pattern_ranges, value)
+            )
+        if self.json_type == "number":
+            if not is_json_number(value):
+                return False
+        elif not is_json_integer(value) or (self.is_unsigned() and value < 0):
+            return False
+        return (
+            (self.minimum is None or value >= self.minimum)
+            and (
+                self.exclusive_minimum is None
+                or value > self.exclusive_minimum
+            )
+            and (self.maximum is None or value <= self.maximum)
+        )
+
+    def literal(self, value):
+        if self.json_type == "boolean":
+            return "true" if value else "false"
+        if self.json_type == "string":
+            return cpp_string(value)
+        if self.json_type == "number":
+            return repr(float(value))
+        return str(value)
+
+    def emit_convert(self, source, target, indent):
+        if self.json_type == "string":
+            return [indent + "%s = std::string(%s);" % (target, source)]
+        return [indent + "%s = %s;" % (target, source)]
+
+    def describe(self):
+        names = {
+            "boolean": "a boolean",
+            "string": "a string",
+            "number": "a number",
+            "integer": "an integer",
+        }
+        if self.enum is not None:
+            return "one of " + ", ".join(json.dumps(v) for v in self.enum)
+        if self.pattern is not None:
+            return "a string matching " + self.pattern
+        bounds = []
+        if self.minimum is not None:
+            bounds.append(">= %s" % self.minimum)
+        if self.exclusive_minimum is not None:
+            bounds.append("> %s" % self.exclusive_minimum)
+        if self.maximum is not None:
+            bounds.append("<= %s" % self.maximum)
+        return " ".join([names[self.json_type]] + bounds)
+
+    def emit_parse(self, value, target, indent):
+        return [
+            indent + "if (!(%s))" % self.condition(value),
+            indent + "{",
+            indent + "    return false;",
+            indent + "}",
+            indent + "%s = %s.get<%s>();" % (target, value, self.cpp_type()),
+        ]
+
+
+class UnionType:
+    """Several scalar types, a 'std::variant' of them."""
+
+    def __init__(self, schema, json_types, where):
+        self.alternatives = [ScalarType(schema, t, where) for t in json_types]
+        cpp_types = [a.cpp_type() for a in self.alternatives]
+        if len(set(cpp_types)) != len(cpp_types):
+            raise SchemaError("%s: ambiguous type list" % where)
+
+    def cpp_type(self):
+        return "std::variant<%s>" % ", ".join(
+            a.cpp_type() for a in self.alternatives
+        )
+
+    def condition(self, value):
+        return " || ".join(
+            "(%s)" % a.condition(value) for a in self.alternatives
+        )
+
+    def describe(self):
+        return " or ".join(a.describe() for a in self.alternatives)
+
+    def embedded_type(self):
+        return "std::variant<%s>" % ", ".join(
+            a.embedded_type() for a in self.alternatives
+        )
+
+    def check(self, value):
+        return any(a.check(value) for a in self.alternatives)
+
+    def literal(self, value):
+        # The first matching alternative, as 'emit_parse' picks it
+        for i, alternative in enumerate(self.alternatives):
+            if alternative.check(value):
+                return "%s(std::in_place_index<%d>, %s)" % (
+                    self.embedded_type(),
+                    i,
+                    alternative.literal(value),
+                )
+        raise ValueError("value not matching any alternative")
+
+    def emit_convert(self, source, target, indent):
+        lines = [indent + "switch (%s.index())" % source, indent + "{"]
+        for i in range(len(self.alternatives)):
+            lines += [
+                indent + "    case %d:" % i,
+                indent
+                + "        %s.emplace<%d>(std::get<%d>(%s));"
+                % (target, i, i, source),
+                indent + "        break;",
+            ]
+        lines.append(indent + "}")
+        return lines
+
+    def emit_parse(self, value, target, indent):
+        lines = []
+        for i, alternative in enumerate(self.alternatives):
+            keyword = "if" if i == 0 else "else if"
+            lines += [
+                indent + "%s (%s)" % (keyword, alternative.condition(value)),
+                indent + "{",
+                indent
+                + "    %s = %s.get<%s>();"
+                % (target, value, alternative.cpp_type()),
+                indent + "}",
+            ]
+        lines += [
+            indent + "else",
+            indent + "{",
+            indent + "    return false;",
+            indent + "}",
+        ]
+        return lines
+
+
+class ArrayType:
+    """A json array of scalars, a 'std::vector'."""
+
+    def __init__(self, schema, where):
+        if "items" not in schema:
+            raise SchemaError("%s: array without 'items'" % where)
+        self.items = parse_value_schema(schema["items"], where + "/items")
+        if not isinstance(self.items, ScalarType):
+            raise SchemaError("%s: only arrays of scalars supported" % where)
+        self.min_items = schema.get("minItems")
+        self.max_items = schema.get("maxItems")
+        self.unique = schema.get("uniqueItems", False)
+
+    def cpp_type(self):
+        return "std::vector<%s>" % self.items.cpp_type()
+
+    def condition(self, value):
+        raise SchemaError("arrays are not supported in 'oneOf' branches")
+
+    def describe(self):
+        text = "an array of"
+        if self.min_items is not None and self.max_items is not None:
+            text += " %d to %d" % (self.min_items, self.max_items)
+        elif self.min_items is not None:
+            text += " at least %d" % self.min_items
+        elif self.max_items is not None:
+            text += " at most %d" % self.max_items
+        if self.unique:
+            text += " distinct"
+        return text + " items, each " + self.items.describe()
+
+    def embedded_type(self):
+        return "std::span<const %s>" % self.items.embedded_type()
+
+    def check(self, value):
+        return (
+            isinstance(value, list)
+            and (self.min_items is None or len(value) >= self.min_items)
+            and (self.max_items is None or len(value) <= self.max_items)
+            and all(self.items.check(item) for item in value)
+            and (
+                not self.unique
+                or len(set(map(json.dumps, value))) == len(value)
+            )
+        )
+
+    def emit_convert(self, source, target, indent):
+        return [
+            indent
+            + "%s.assign(%s.begin(), %s.end());" % (target, source, source)
+        ]
+
+    def emit_parse(self, value, target, indent):
+        size_conditions = [value + ".is_array()"]
+        if self.min_items is not None:
+            size_conditions.append("%s.size() >= %d" % (value, self.min_items))
+        if self.max_items is not None:
+            size_conditions.append("%s.size() <= %d" % (value, self.max_items))
+        lines = [
+            indent + "if (!(%s))" % " && ".join(size_conditions),
+            indent + "{",
+            indent + "    return false;",
+            indent + "}",
+            indent + "%s.clear();" % target,
+            indent + "%s.reserve(%s.size());" % (target, value),
+            indent + "for (const json& item : %s)" % value,
+            indent + "{",
+            indent + "    %s element;" % self.items.cpp_type(),
+        ]
+        lines += self.items.emit_parse("item", "element", indent + "    ")
+        if self.unique:
+            lines += [
+                indent
+                + "    if (std::find(%s.begin(), %s.end(), element) !="
+                % (target, target),
+                indent + "        %s.end())" % target,
+                indent + "    {",
+                indent + "        return false;",
+                indent + "    }",
+            ]
+        lines += [
+            indent + "    %s.push_back(element);" % target,
+            indent + "}",
+        ]
+        return lines
+
+
+def parse_value_schema(schema, where):
+    check_keywords(schema, VALUE_KEYWORDS, where)
+    json_type = schema.get("type")
+    if isinstance(json_type, list):
+        return UnionType(schema, json_type, where)
+    if json_type == "array":
+        return ArrayType(schema, where)
+    if json_type is None:
+        raise SchemaError("%s: missing 'type'" % where)
+    return ScalarType(schema, json_type, where)
+
+
+def parse_name_pattern(pattern):
+    """Translate '^[<char class>]+$' or '^[<char class>][<char class>]*$'
+    into the lists of (first, last) ranges of the first character and of the
+    following ones."""
+    match = re.fullmatch(r"\^\[([^\]]+)\]\+\$", pattern)
+    if match:
+        ranges = parse_char_class(pattern, match.group(1))
+        return (ranges, ranges)
+    match = re.fullmatch(r"\^\[([^\]]+)\]\[([^\]]+)\]\*\$", pattern)
+    if match:
+        return (
+            parse_char_class(pattern, match.group(1)),
+            parse_char_class(pattern, match.group(2)),
+        )
+    raise SchemaError(
+        "pattern '%s': only '^[<char class>]+$' and "
+        "'^[<char class>][<char class>]*$' supported" % pattern
+    )
+
+
+def parse_char_class(pattern, chars):
+    """Translate the characters of a '[...]' class into a list of
+    (first, last) ranges."""
+    ranges = []
+    i = 0
+    while i < len(chars):
+        if i + 2 < len(chars) and chars[i + 1] == "-":
+            ranges.append((chars[i], chars[i + 2]))
+            i += 3
+        elif chars[i] == "\\":
+            raise SchemaError("pattern '%s': escapes not supported" % pattern)
+        else:
+            ranges.append((chars[i], chars[i]))
+            i += 1
+    return ranges
+
+
+def cpp_char(c):
+    return "'\\''" if c == "'" else "'%s'" % c.replace("\\", "\\\\")
+
+
+def in_ranges(ranges, c):
+    return any(first <= c <= last for first, last in ranges)
+
+
+def matches_ranges(ranges, text):
+    """Python counterpart of the generated pattern functions, @ranges as
+    returned by 'parse_name_pattern'."""
+    first_ranges, ranges = ranges
+    return (
+        bool(text)
+        and in_ranges(first_ranges, text[0])
+        and all(in_ranges(ranges, c) for c in text[1:])
+    )
+
+
+def scalar_types(value_type):
+    if isinstance(value_type, UnionType):
+        return value_type.alternatives
+    if isinstance(value_type, ArrayType):
+        return [value_type.items]
+    return [value_type]
+
+
+def range_conditions(ranges, indent):
+    conditions = []
+    for first, last in ranges:
+        if first == last:
+            conditions.append("c == %s" % cpp_char(first))
+        else:
+            conditions.append(
+                "(c >= %s && c <= %s)" % (cpp_char(first), cpp_char(last))
+            )
+    return (" ||\n" + " " * indent).join(conditions)
+
+
+def emit_pattern_function(function, pattern, ranges):
+    first_ranges, ranges = ranges
+    out = [
+        "// Pattern: %s" % pattern,
+        "static bool %s(const std::string& text)" % function,
+        "{",
+        "    if (text.empty())",
+        "    {",
+        "        return false;",
+        "    }",
+    ]
+    if first_ranges == ranges:
+        out += [
+            "    for (char c : text)",
+            "    {",
+            "        if (!(%s))" % range_conditions(ranges, 14),
+        ]
+    else:
+        out += [
+            "    for (size_t i = 0; i < text.size(); ++i)",
+            "    {",
+            "        char c = text[i];",
+            "        if (i == 0 ? !(%s)" % range_conditions(first_ranges, 23),
+            "                   : !(%s))" % range_conditions(ranges, 23),
+        ]
+    return out + [
+        "        {",
+        "            return false;",
+        "        }",
+        "    }",
+        "    return true;",
+        "}",
+        "",
+    ]
+
+
+class Property:
+    def __init__(self, name, schema, required):
+        self.name = name
+        self.field = camel_case(name)
+        self.required = required
+        self.description = schema.get("description", "")
+        self.type = parse_value_schema(schema, "/" + name)
+        self.function = "parse" + pascal_case(name)
+
+    def field_type(self):
+        if self.required:
+            return self.type.cpp_type()
+        return "std::optional<%s>" % self.type.cpp_type()
+
+    def embedded_field_type(self):
+        if self.required:
+            return self.type.embedded_type()
+        return "std::optional<%s>" % self.type.embedded_type()
+
+    def emit_convert(self, source, target, indent):
+        if self.required:
+            return self.type.emit_convert(source, target, indent)
+        lines = [
+            indent + "if (%s.has_value())" % source,
+            indent + "{",
+            indent + "    %s.emplace();" % target,
+        ]
+        lines += self.type.emit_convert(
+            "(*%s)" % source, "(*%s)" % target, indent + "    "
+        )
+        lines.append(indent + "}")
+        return lines
+
+
+class Branch:
+    def __init__(self, schema, properties, where):
+        check_keywords(schema, BRANCH_KEYWORDS, where)
+        self.required = schema.get("required", [])
+        negation = schema.get("not", {})
+        check_keywords(negation, {"required", "anyOf"}, where + "/not")
+        alternatives = negation.get("anyOf", [])
+        if negation.get("required"):
+            alternatives = [negation] + alternatives
+        # The branch is excluded if all the properties of any of these are
+        # present
+        self.exclusions = []
+        for i, alternative in enumerate(alternatives):
+            check_keywords(
+                alternative, {"required"}, "%s/not/anyOf/%d" % (where, i)
+            )
+            self.exclusions.append(alternative.get("required", []))
+        self.constraints = []
+        for name in self.required + sum(self.exclusions, []):
+            if name not in properties:
+                raise SchemaError("%s: unknown property '%s'" % (where, name))
+        for name, subschema in schema.get("properties", {}).items():
+            if name not in properties:
+                raise SchemaError("%s: unknown property '%s'" % (where, name))
+            self.constraints.append(
+                (name, parse_value_schema(subschema, where + "/" + name))
+            )
+
+    def matches(self, entry):
+        return (
+            all(name in entry for name in self.required)
+            and not any(
+                excluded and all(name in entry for name in excluded)
+                for excluded in self.exclusions
+            )
+            and all(
+                name not in entry or constraint.check(entry[name])
+                for name, constraint in self.constraints
+            )
+        )
+
+    def describe(self):
+        parts = ["'%s'" % name for name in self.required]
+        for excluded in self.exclusions:
+            parts.append(
+                "not all of %s"
+                % " and ".join("'%s'" % name for name in excluded)
+                if len(excluded) > 1
+                else "no '%s'" % excluded[0]
+            )
+        parts += [
+            "'%s' %s" % (name, constraint.describe())
+            for name, constraint in self.constraints
+        ]
+        return ", ".join(parts)
+
+
+def describe_branches(branches):
+    return "expected exactly one of: " + "; ".join(
+        b.describe() for b in branches
+    )
+
+
+class Generator:
+    def __init__(self, schema):
+        check_keywords(schema, ROOT_KEYWORDS, "<root>")
+        if schema.get("type") != "object":
+            raise SchemaError("<root>: object expected")
+        if schema.get("additionalProperties", True) is not False:
+            raise SchemaError("<root>: 'additionalProperties' must be false")
+        self.min_properties = schema.get("minProperties", 0)
+        patterns = schema.get("patternProperties", {})
+        if len(patterns) != 1:
+            raise SchemaError("<root>: exactly one pattern property expected")
+        self.name_pattern, entry = next(iter(patterns.items()))
+        self.name_ranges = parse_name_pattern(self.name_pattern)
+
+        check_keywords(entry, ENTRY_KEYWORDS, "<entry>")
+        if entry.get("type") != "object":
+            raise SchemaError("<entry>: object expected")
+        if entry.get("additionalProperties", True) is not False:
+            raise SchemaError("<entry>: 'additionalProperties' must be false")
+        required = entry.get("required", [])
+        self.properties = [
+            Property(name, subschema, name in required)
+            for name, subschema in entry.get("properties", {}).items()
+        ]
+        names = [p.name for p in self.properties]
+        for name in required:
+            if name not in names:
+                raise SchemaError("<entry>: unknown required '%s'" % name)
+        # The lists of branches, exactly one of each must match
+        self.branch_lists = []
+        if "oneOf" in entry:
+            self.branch_lists.append(
+                self.parse_branches(entry["oneOf"], names, "<entry>")
+            )
+        for i, alternatives in enumerate(entry.get("allOf", [])):
+            where = "<entry>/allOf/%d" % i
+            check_keywords(alternatives, {"oneOf", "description"}, where)
+            if "oneOf" not in alternatives:
+                raise SchemaError("%s: 'oneOf' expected" % where)
+            self.branch_lists.append(
+                self.parse_branches(alternatives["oneOf"], names, where)
+            )
+        self.branches = sum(self.branch_lists, [])
+        # One function per distinct pattern, the entry names' first
+        self.patterns = {self.name_pattern: self.name_ranges}
+        types = [p.type for p in self.properties]
+        for branch in self.branches:
+            types += [constraint for _, constraint in branch.constraints]
+        for scalar in sum((scalar_types(t) for t in types), []):
+            if scalar.pattern is not None:
+                self.patterns.setdefault(scalar.pattern, scalar.pattern_ranges)
+                scalar.pattern_function = self.pattern_function(scalar.pattern)
+
+    @staticmethod
+    def parse_branches(branches, names, where):
+        return [
+            Branch(branch, names, "%s/oneOf/%d" % (where, i))
+            for i, branch in enumerate(branches)
+        ]
+
+    def pattern_function(self, pattern):
+        return "matchesPattern%d" % list(self.patterns).index(pattern)
+
+    def index(self, name):
+        return [p.name for p in self.properties].index(name)
+
+    def header(self, schema_name):
+        out = [
+            "#pragma once",
+            "",
+            "// Generated by scripts/gen_config_validator.py from %s,"
+            % schema_name,
+            "// do not edit.",
+            "",
+            "#include <nlohmann/json.hpp>",
+            "",
+            "#include <cstdint>",
+            "#include <optional>",
+            "#include <span>",
+            "#include <string>",
+            "#include <string_view>",
+            "#include <variant>",
+            "#include <vector>",
+            "",
+            "namespace gpio_handler",
+            "{",
+            "",
+            "/** @brief A single entry of the gpio config **/",
+            "struct GpioPinConfig",
+            "{",
+            "    /** @brief The key of the entry, the name of the DBus property "
+            "**/",
+            "    std::string name;",
+        ]
+        for prop in self.properties:
+            if prop.description:
+                out += doc_comment(prop.description, "    ")
+            out.append("    %s %s;" % (prop.field_type(), prop.field))
+        out += [
+            "};",
+            "",
+            "/** @brief Literal type counterpart of @ref GpioPinConfig, an entry "
+            "of a",
+            " * config embedded at build time **/",
+            "struct GpioEmbeddedPinConfig",
+            "{",
+            "    std::string_view name;",
+        ]
+        for prop in self.properties:
+            out.append("    %s %s;" % (prop.embedded_field_type(), prop.field))
+        out += [
+            "};",
+            "",
+            "/** @brief Copy the embedded config @entry into its runtime form "
+            "**/",
+            "GpioPinConfig toGpioPinConfig(const GpioEmbeddedPinConfig& entry);",
+            "",
+            "/** @brief Location and cause of a gpio config validation "
+            "failure **/",
+            "struct GpioConfigValidationError",
+            "{",
+            '    /** @brief JSON pointer of the offending value, ie '
+            '"/I2C3_ALERT/gpio_pin" **/',
+            "    std::string path;",
+            "    /** @brief What was expected at @ref path **/",
+            "    const char* message = nullptr;",
+            "};",
+            "",
+            "/**",
+            " * @brief Check @config against the config schema and convert it "
+            "into",
+            " * @pins, in the order of the config object's keys.",
+            " *",
+            " * The @config is walked once. On failure @pins is unspecified "
+            "and @error",
+            " * describes the first violation found.",
+            " *",
+            " * @return True if @config matches the schema.",
+            " */",
+            "bool parseGpioConfig(const nlohmann::json& config,",
+            "                     std::vector<GpioPinConfig>& pins,",
+            "                     GpioConfigValidationError& error);",
+            "",
+            "} // namespace gpio_handler",
+            "",
+        ]
+        return "\n".join(out)
+
+    def source(self, header_name, schema_name):
+        count = len(self.properties)
+        out = [
+            "// Generated by scripts/gen_config_validator.py from %s,"
+            % schema_name,
+            "// do not edit.",
+            "",
+            "#include <%s>" % header_name,
+            "",
+            "#include <algorithm>",
+            "",
+            "using json = nlohmann::json;",
+            "",
+            "namespace gpio_handler",
+            "{",
+            "",
+        ]
+        for pattern, ranges in self.patterns.items():
+            out += emit_pattern_function(
+                self.pattern_function(pattern), pattern, ranges
+            )
+        for prop in self.properties:
+            out += [
+                "// %s: %s" % (prop.name, prop.type.describe()),
+                "static bool %s(const json& value, %s& target)"
+                % (prop.function, prop.type.cpp_type()),
+                "{",
+            ]
+            out += prop.type.emit_parse("value", "target", "    ")
+            out += ["    return true;", "}", ""]
+        for i, branch in enumerate(self.branches):
+            out += [
+                "// %s" % branch.describe(),
+                "static bool matchesBranch%d(const json* const values[])" % i,
+                "{",
+            ]
+            conditions = [
+                "values[%d] != nullptr" % self.index(name)
+                for name in branch.required
+            ]
+            for excluded in branch.exclusions:
+                conditions.append(
+                    "!(%s)"
+                    % " && ".join(
+                        "values[%d] != nullptr" % self.index(name)
+                        for name in excluded
+                    )
+                )
+            for name, constraint in branch.constraints:
+                value = "(*values[%d])" % self.index(name)
+                conditions.append(
+                    "(values[%d] == nullptr || (%s))"
+                    % (self.index(name), constraint.condition(value))
+                )
+            out += [
+                "    return %s;"
+                % (" &&\n           ".join(conditions) or "true"),
+                "}",
+                "",
+            ]
+        out += [
+            "static bool parseEntry(const std::string& name, const json& value,",
+            "                       GpioPinConfig& pin,",
+            "                       GpioConfigValidationError& error)",
+            "{",
+            "    if (!value.is_object())",
+            "    {",
+            '        error.path = "/" + name;',
+            '        error.message = "expected an object";',
+            "        return false;",
+            "    }",
+            "    pin.name = name;",
+            "    // Indexed by the position of the property in the schema",
+            "    const json* values[%d] = {};" % count,
+            "    for (auto it = value.cbegin(); it != value.cend(); ++it)",
+            "    {",
+            "        const std::string& key = it.key();",
+            "        const char* expected = nullptr;",
+        ]
+        for i, prop in enumerate(self.properties):
+            keyword = "if" if i == 0 else "else if"
+            target = "pin.%s" % prop.field
+            if not prop.required:
+                target += ".emplace()"
+            out += [
+                "        %s (key == %s)" % (keyword, cpp_string(prop.name)),
+                "        {",
+                "            values[%d] = &it.value();" % i,
+                "            if (!%s(it.value(), %s))" % (prop.function, target),
+                "            {",
+                "                expected = %s;"
+                % cpp_string("expected " + prop.type.describe()),
+                "            }",
+                "        }",
+            ]
+        out += [
+            "        else",
+            "        {",
+            '            expected = "unexpected attribute";',
+            "        }",
+            "        if (expected != nullptr)",
+            "        {",
+            '            error.path = "/" + name + "/" + key;',
+            "            error.message = expected;",
+            "            return false;",
+            "        }",
+            "    }",
+        ]
+        for i, prop in enumerate(self.properties):
+            if prop.required:
+                out += [
+                    "    if (values[%d] == nullptr)" % i,
+                    "    {",
+                    '        error.path = "/" + name + "/%s";' % prop.name,
+                    '        error.message = "missing required attribute";',
+                    "        return false;",
+                    "    }",
+                ]
+        first = 0
+        for branches in self.branch_lists:
+            # The count of the first list declares the variable
+            assignment = "    %sbranches = " % ("int " if first == 0 else "")
+            matches = (" +\n" + " " * len(assignment)).join(
+                "(int)matchesBranch%d(values)" % i
+                for i in range(first, first + len(branches))
+            )
+            first += len(branches)
+            out += [
+                assignment + matches + ";",
+                "    if (branches != 1)",
+                "    {",
+                '        error.path = "/" + name;',
+                "        error.message =",
+                "            %s;" % cpp_string(describe_branches(branches)),
+                "        return false;",
+                "    }",
+            ]
+        out += [
+            "    return true;",
+            "}",
+            "",
+            "GpioPinConfig toGpioPinConfig(const GpioEmbeddedPinConfig& entry)",
+            "{",
+            "    GpioPinConfig pin;",
+            "    pin.name = std::string(entry.name);",
+        ]
+        for prop in self.properties:
+            out += prop.emit_convert(
+                "entry." + prop.field, "pin." + prop.field, "    "
+            )
+        out += [
+            "    return pin;",
+            "}",
+            "",
+            "bool parseGpioConfig(const json& config, "
+            "std::vector<GpioPinConfig>& pins,",
+            "                     GpioConfigValidationError& error)",
+            "{",
+            "    if (!config.is_object())",
+            "    {",
+            '        error.path = "";',
+            '        error.message = "expected an object";',
+            "        return false;",
+            "    }",
+            "    if (config.size() < %d)" % self.min_properties,
+            "    {",
+            '        error.path = "";',
+            "        error.message = %s;"
+            % cpp_string(
+                "expected at least %d %s"
+                % (
+                    self.min_properties,
+                    "entry" if self.min_properties == 1 else "entries",
+                )
+            ),
+            "        return false;",
+            "    }",
+            "    pins.clear();",
+            "    pins.resize(config.size());",
+            "    auto pin = pins.begin();",
+            "    for (auto it = config.cbegin(); it != config.cend(); "
+            "++it, ++pin)",
+            "    {",
+            "        if (!%s(it.key()))"
+            % self.pattern_function(self.name_pattern),
+            "        {",
+            '            error.path = "/" + it.key();',
+            "            error.message = %s;"
+            % cpp_string("expected a name matching " + self.name_pattern),
+            "            return false;",
+            "        }",
+            "        if (!parseEntry(it.key(), it.value(), *pin, error))",
+            "        {",
+            "            return false;",
+            "        }",
+            "    }",
+            "    return true;",
+            "}",
+            "",
+            "} // namespace gpio_handler",
+            "",
+        ]
+        return "\n".join(out)
+
+
+    def validate(self, config):
+        """Python counterpart of 'parseGpioConfig', raise @ref ConfigError on
+        the first violation. Return the entries sorted by name."""
+        if not isinstance(config, dict):
+            raise ConfigError("", "expected an object")
+        if len(config) < self.min_properties:
+            raise ConfigError(
+                "",
+                "expected at least %d %s"
+                % (
+                    self.min_properties,
+                    "entry" if self.min_properties == 1 else "entries",
+                ),
+            )
+        names = {p.name: p for p in self.properties}
+        for name, entry in sorted(config.items()):
+            path = "/" + name
+            if not matches_ranges(self.name_ranges, name):
+                raise ConfigError(
+                    path, "expected a name matching " + self.name_pattern
+                )
+            if not isinstance(entry, dict):
+                raise ConfigError(path, "expected an object")
+            for key, value in entry.items():
+                if key not in names:
+                    raise ConfigError(path + "/" + key, "unexpected attribute")
+                if not names[key].type.check(value):
+                    raise ConfigError(
+                        path + "/" + key,
+                        "expected " + names[key].type.describe(),
+                    )
+            for prop in self.properties:
+                if prop.required and prop.name not in entry:
+                    raise ConfigError(
+                        path + "/" + prop.name, "missing required attribute"
+                    )
+            for branches in self.branch_lists:
+                if sum(branch.matches(entry) for branch in branches) != 1:
+                    raise ConfigError(path, describe_branches(branches))
+        return sorted(config.items())
+
+    def embedded(self, config, schema_name, config_name):
+        entries = self.validate(config)
+        check_config_rules(entries)
+        out = [
+            "#pragma once",
+            "",
+            "// Generated by scripts/gen_config_validator.py from %s"
+            % config_name,
+            "// checked against %s, do not edit." % schema_name,
+            "",
+            "#include <gpio_config_schema.hpp>",
+            "",
+            "#include <array>",
+            "",
+            "namespace gpio_handler",
+            "{",
+            "",
+        ]
+        # The arrays the spans of the table point to
+        arrays = {}
+        for index, (name, entry) in enumerate(entries):
+            for prop in self.properties:
+                if isinstance(prop.type, ArrayType) and prop.name in entry:
+                    array = "embedded%s%d" % (pascal_case(prop.name), index)
+                    arrays[(name, prop.name)] = array
+                    out.append(
+                        "inline constexpr %s %s[] = {%s};"
+                        % (
+                            prop.type.items.embedded_type(),
+                            array,
+                            ", ".join(
+                                prop.type.items.literal(item)
+                                for item in entry[prop.name]
+                            ),
+                        )
+                    )
+        if arrays:
+            out.append("")
+        out += [
+            "/** @brief The gpio config embedded at build time, in the order "
+            "of the",
+            " * entry names **/",
+            "inline constexpr std::array<GpioEmbeddedPinConfig, %d> "
+            "embeddedGpioConfig = {{" % len(entries),
+        ]
+        for name, entry in entries:
+            out += [
+                "    {",
+                "        .name = %s," % cpp_string(name),
+            ]
+            for prop in self.properties:
+                if prop.name not in entry:
+                    value = "std::nullopt"
+                elif isinstance(prop.type, ArrayType):
+                    value = "%s(%s)" % (
+                        prop.type.embedded_type(),
+                        arrays[(name, prop.name)],
+                    )
+                else:
+                    value = prop.type.literal(entry[prop.name])
+                out.append("        .%s = %s," % (prop.field, value))
+            out.append("    },")
+        out += [
+            "}};",
+            "",
+            "} // namespace gpio_handler",
+            "",
+        ]
+        return "\n".join(out)
+
+
+def check_config_rules(entries):
+    """Python counterpart of the checks of 'GpioJsonConfig' beyond the schema,
+    raise @ref ConfigError on the first violation."""
+    properties = set()
+    for name, entry in entries:
+        if entry.get("mode") == "measure":
+            names = [name + suffix for suffix in MEASUREMENT_PROPERTY_SUFFIXES]
+        else:
+            names = [name]
+        for property_name in names:
+            if property_name in properties:
+                raise ConfigError(
+                    "/" + name,
+                    "the property '%s' clashes with another property of the "
+                    "same name" % property_name,
+                )
+            properties.add(property_name)
+        for key in ("on_rising", "on_falling"):
+            for i, text in enumerate(entry.get(key, [])):
+                words = text.split()
+                bounds = ACTION_ARGUMENTS.get(words[0] if words else None)
+                if bounds is None or not (
+                    bounds[0] <= len(words) - 1
+                    and (bounds[1] is None or len(words) - 1 <= bounds[1])
+                ):
+                    raise ConfigError(
+                        "/%s/%s/%d" % (name, key, i),
+                        "invalid action '%s'" % text,
+                    )
+
+
+def base_name(path):
+    return path.replace("\\", "/").split("/")[-1]
+
+
+def reject_duplicate_keys(pairs):
+    keys = [key for key, _ in pairs]
+    for key in keys:
+        if keys.count(key) > 1:
+            raise ConfigError("", "duplicate key '%s'" % key)
+    return dict(pairs)
+
+
+def main_embed(argv):
+    schema_path, config_path, header_path = argv
+    with open(schema_path) as schema_file:
+        schema = json.load(schema_file)
+    try:
+        generator = Generator(schema)
+        with open(config_path) as config_file:
+            config = json.load(
+                config_file, object_pairs_hook=reject_duplicate_keys
+            )
+        header = generator.embedded(
+            config, base_name(schema_path), base_name(config_path)
+        )
+    except SchemaError as e:
+        sys.stderr.write("%s: %s\n" % (schema_path, e))
+        return 1
+    except (ConfigError, ValueError) as e:
+        sys.stderr.write("%s: %s\n" % (config_path, e))
+        return 1
+    with open(header_path, "w") as header_file:
+        header_file.write(header)
+    return 0
+
+
+def main(argv):
+    if len(argv) == 5 and argv[1] == "--embed":
+        return main_embed(argv[2:])
+    if len(argv) != 4:
+        sys.stderr.write(__doc__.split("\n\n")[1] + "\n")
+        return 2
+    schema_path, header_path, source_path = argv[1:]
+    with open(schema_path) as schema_file:
+        schema = json.load(schema_file)
+    schema_name = base_name(schema_path)
+    header_name = base_name(header_path)
+    try:
+        generator = Generator(schema)
+    except SchemaError as e:
+        sys.stderr.write("%s: %s\n" % (schema_path, e))
+        return 1
+    with open(header_path, "w") as header_file:
+        header_file.write(generator.header(schema_name))
+    with open(source_path, "w") as source_file:
+        source_file.write(generator.source(header_name, schema_name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,199 @@
+#include "gpio_fake_lines.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <linux/gpio.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+using namespace gpio_handler;
+
+namespace
+{
+
+void toLineEvent(const struct gpioevent_data& data,
+                 struct gpiod_line_event* event)
+{
+    event->ts.tv_sec = data.timestamp / 1000000000;
+    event->ts.tv_nsec = data.timestamp % 1000000000;
+    event->event_type = data.id == GPIOEVENT_EVENT_RISING_EDGE
+                            ? GPIOD_LINE_EVENT_RISING_EDGE
+                            : GPIOD_LINE_EVENT_FALLING_EDGE;
+}
+
+void countValueRead()
+{
+    if (onFakeValueRead != nullptr)
+    {
+        onFakeValueRead();
+    }
+}
+
+} // namespace
+
+extern "C"
+{
+
+// The libgpiod calls of the pin threads and the worker pool, over the faked
+// lines
+
+int gpiod_line_event_wait_bulk(struct gpiod_line_bulk* bulk,
+                               const struct timespec* timeout,
+                               struct gpiod_line_bulk* eventBulk)
+{
+    struct pollfd fds[GPIOD_LINE_BULK_MAX_LINES];
+    unsigned count = gpiod_line_bulk_num_lines(bulk);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        fds[i] = {gpiod_line_bulk_get_line(bulk, i)->fds[0], POLLIN, 0};
+    }
+    int result = poll(fds, count,
+                      timeout->tv_sec * 1000 + timeout->tv_nsec / 1000000);
+    if (result > 0)
+    {
+        gpiod_line_bulk_init(eventBulk);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (fds[i].revents != 0)
+            {
+                gpiod_line_bulk_add(eventBulk,
+                                    gpiod_line_bulk_get_line(bulk, i));
+            }
+        }
+        return 1;
+    }
+    return result;
+}
+
+int gpiod_line_event_get_fd(struct gpiod_line* line)
+{
+    return line->fds[0];
+}
+
+int gpiod_line_event_read_fd_multiple(int fd, struct gpiod_line_event* events,
+                                      unsigned int eventCount)
+{
+    struct gpioevent_data data[16];
+    eventCount = min(eventCount, 16u);
+    ssize_t result = read(fd, data, eventCount * sizeof(data[0]));
+    if (result < 0)
+    {
+        return -1;
+    }
+    int readCount = result / sizeof(data[0]);
+    for (int i = 0; i < readCount; ++i)
+    {
+        toLineEvent(data[i], &events[i]);
+    }
+    return readCount;
+}
+
+int gpiod_line_event_read(struct gpiod_line* line,
+                          struct gpiod_line_event* event)
+{
+    return gpiod_line_event_read_fd_multiple(line->fds[0], event, 1) == 1 ? 0
+                                                                         : -1;
+}
+
+int gpiod_line_get_value(struct gpiod_line* line)
+{
+    countValueRead();
+    return __atomic_load_n(&line->value, __ATOMIC_RELAXED);
+}
+
+int gpiod_line_get_value_bulk(struct gpiod_line_bulk* bulk, int* values)
+{
+    countValueRead();
+    for (unsigned i = 0; i < bulk->num_lines; ++i)
+    {
+        values[i] = __atomic_load_n(&bulk->lines[i]->value, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+struct gpiod_chip* gpiod_line_get_chip(struct gpiod_line* line)
+{
+    return line->chip;
+}
+
+const char* gpiod_chip_name(struct gpiod_chip* chip)
+{
+    return chip->name;
+}
+
+} // extern "C"
+
+namespace gpio_handler
+{
+
+void (*onFakeValueRead)() = nullptr;
+
+FakeLines::FakeLines(const vector<string>& names, unsigned chipCount) :
+    names(names), chips(chipCount), lines(names.size())
+{
+    for (unsigned i = 0; i < chipCount; ++i)
+    {
+        snprintf(chips[i].name, sizeof(chips[i].name), "gpiochip%u", i);
+    }
+    for (unsigned i = 0; i < lines.size(); ++i)
+    {
+        lines[i].chip = &chips[i % chipCount];
+        lines[i].value = 0;
+        if (pipe2(lines[i].fds, O_CLOEXEC) != 0)
+        {
+            perror("pipe2");
+            lines[i].fds[0] = lines[i].fds[1] = -1;
+            ready = false;
+            continue;
+        }
+        // Room for all the edges in flight
+        fcntl(lines[i].fds[1], F_SETPIPE_SZ, 1 << 20);
+    }
+}
+
+FakeLines::~FakeLines()
+{
+    for (auto& line : lines)
+    {
+        if (line.fds[0] >= 0)
+        {
+            close(line.fds[0]);
+            close(line.fds[1]);
+        }
+    }
+}
+
+map<string, vector<gpiod_line_t*>> FakeLines::getLineMap()
+{
+    map<string, vector<gpiod_line_t*>> lineMap;
+    for (unsigned i = 0; i < lines.size(); ++i)
+    {
+        lineMap[names[i]] = {&lines[i]};
+    }
+    return lineMap;
+}
+
+bool FakeLines::sendEdges(unsigned index, unsigned count, int value)
+{
+    array<struct gpioevent_data, maxBurst> events;
+    count = min(count, maxBurst);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        events[i].timestamp = now.tv_sec * 1000000000ull + now.tv_nsec;
+        events[i].id = i % 2 != 0 ? GPIOEVENT_EVENT_FALLING_EDGE
+                                  : GPIOEVENT_EVENT_RISING_EDGE;
+    }
+    __atomic_store_n(&lines[index].value, value, __ATOMIC_RELAXED);
+    return write(lines[index].fds[1], events.data(),
+                 count * sizeof(events[0])) >= 0;
+}
+
+} // namespace gpio_handler
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <gpio_status_handler.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** @brief A faked gpio chip **/
+struct gpiod_chip
+{
+    char name[16];
+};
+
+/** @brief A faked gpio line, the pipe of its edges and its value **/
+struct gpiod_line
+{
+    gpiod_chip* chip;
+    int fds[2];
+    int value;
+};
+
+namespace gpio_handler
+{
+
+/** @brief Called by every value read of the faked lines, an ioctl with the
+ * real library, if set **/
+extern void (*onFakeValueRead)();
+
+/**
+ * @brief Gpio lines faked by pipes carrying the kernel's 'gpioevent_data'
+ * records
+ *
+ * The libgpiod calls of the pin threads and of the worker pool are replaced
+ * by the ones in gpio_fake_lines.cpp, which read the edges from the pipes
+ * through the libc calls and the values from the @ref gpiod_line::value.
+ * The line of the @names[i] pin is on the chip "gpiochip<i % chipCount>".
+ */
+class FakeLines
+{
+  public:
+    FakeLines(const std::vector<std::string>& names, unsigned chipCount);
+    ~FakeLines();
+
+    FakeLines(const FakeLines&) = delete;
+    FakeLines& operator=(const FakeLines&) = delete;
+
+    /** @brief False if any pipe could not be created **/
+    bool isReady() const
+    {
+        return ready;
+    }
+
+    /** @brief The lines by the pin names, for @ref createMonitoredPins **/
+    std::map<std::string, std::vector<gpiod_line_t*>> getLineMap();
+
+    /**
+     * @brief Queue @count edges, rising and falling in turn, on the line
+     * @index and set its value to @value.
+     *
+     * @return False if the edges could not be written.
+     */
+    bool sendEdges(unsigned index, unsigned count, int value);
+
+    /** @brief Maximal number of edges sent at once **/
+    static constexpr unsigned maxBurst = 16;
+
+  private:
+    std::vector<std::string> names;
+    std::vector<gpiod_chip> chips;
+    /** @brief Never resized, the pins point to the lines **/
+    std::vector<gpiod_line> lines;
+    bool ready = true;
+};
+
+} // namespace gpio_handler
@@ -0,0 +1,316 @@
+#include "gpio_fake_lines.hpp"
+#include "gpio_test_bus.hpp"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <gpio_change_log.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_pin_threads.hpp>
+#include <gpio_publisher.hpp>
+#include <gpio_stats.hpp>
+#include <gpio_status_handler.hpp>
+#include <gpio_workers.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef IO_URING_BACKEND
+#include <liburing.h>
+#endif
+
+/*
+ * System calls per edge of the thread per pin model and of the worker pool,
+ * with the epoll sets and with the io_urings, under a synthetic load: the gpio
+ * lines are faked by pipes carrying the kernel's 'gpioevent_data' records,
+ * written in bursts of a few edges per line, and the libgpiod calls of the
+ * service are replaced by the ones of 'FakeLines'.
+ *
+ * Only the system calls made by the pin threads or the workers are counted,
+ * through the linker's '--wrap' of the libc calls (see test/meson.build): a
+ * value read counts as the single ioctl it is with the real library, and every
+ * submission to an io_uring as an 'io_uring_enter' call. The DBus signals are
+ * sent by sd-bus through calls not wrapped, so they are not counted in either
+ * model.
+ */
+
+using namespace std;
+using namespace gpio_handler;
+
+namespace
+{
+
+constexpr unsigned chipCount = 4;
+constexpr unsigned lineCount = 32;
+constexpr unsigned workerCount = 2;
+constexpr unsigned edgeCount = 200000;
+constexpr array<unsigned, 4> edgesPerWakeup = {1, 2, 4, 8};
+
+/** @brief How the pins are served **/
+enum class Model
+{
+    pinThreads,
+    epoll,
+    ioUring,
+};
+
+atomic<uint64_t> systemCalls{0};
+/** @brief Cleared in the threads other than the workers **/
+thread_local bool countSystemCalls = true;
+
+void countSystemCall()
+{
+    if (countSystemCalls)
+    {
+        systemCalls.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+extern "C"
+{
+
+ssize_t __real_read(int fd, void* buffer, size_t size);
+ssize_t __real_write(int fd, const void* buffer, size_t size);
+int __real_poll(struct pollfd* fds, nfds_t count, int timeoutMs);
+int __real_epoll_wait(int epollFd, struct epoll_event* events, int maxEvents,
+                      int timeoutMs);
+
+ssize_t __wrap_read(int fd, void* buffer, size_t size)
+{
+    countSystemCall();
+    return __real_read(fd, buffer, size);
+}
+
+ssize_t __wrap_write(int fd, const void* buffer, size_t size)
+{
+    countSystemCall();
+    return __real_write(fd, buffer, size);
+}
+
+int __wrap_poll(struct pollfd* fds, nfds_t count, int timeoutMs)
+{
+    countSystemCall();
+    return __real_poll(fds, count, timeoutMs);
+}
+
+int __wrap_epoll_wait(int epollFd, struct epoll_event* events, int maxEvents,
+                      int timeoutMs)
+{
+    countSystemCall();
+    return __real_epoll_wait(epollFd, events, maxEvents, timeoutMs);
+}
+
+#ifdef IO_URING_BACKEND
+int __real_io_uring_submit(struct io_uring* ring);
+int __real_io_uring_submit_and_wait_timeout(struct io_uring* ring,
+                                            struct io_uring_cqe** cqe,
+                                            unsigned waitCount,
+                                            struct __kernel_timespec* timeout,
+                                            sigset_t* sigmask);
+
+int __wrap_io_uring_submit(struct io_uring* ring)
+{
+    countSystemCall();
+    return __real_io_uring_submit(ring);
+}
+
+int __wrap_io_uring_submit_and_wait_timeout(struct io_uring* ring,
+                                            struct io_uring_cqe** cqe,
+                                            unsigned waitCount,
+                                            struct __kernel_timespec* timeout,
+                                            sigset_t* sigmask)
+{
+    countSystemCall();
+    return __real_io_uring_submit_and_wait_timeout(ring, cqe, waitCount,
+                                                   timeout, sigmask);
+}
+#endif
+
+} // extern "C"
+
+void stopService(int exitCode)
+{
+    fprintf(stderr, "The service was stopped with %d\n", exitCode);
+    _exit(exitCode);
+}
+
+namespace
+{
+
+/** @brief Pins "P00" to "P31" spread over the chips, polled rarely enough
+ * not to add to the counts **/
+vector<GpioEmbeddedPinConfig> createConfig(vector<string>& names)
+{
+    vector<GpioEmbeddedPinConfig> config;
+    names.resize(lineCount);
+    for (unsigned i = 0; i < lineCount; ++i)
+    {
+        char name[8];
+        snprintf(name, sizeof(name), "P%02u", i);
+        names[i] = name;
+        config.push_back(GpioEmbeddedPinConfig{
+            .name = names[i],
+            .gpioChip = i % chipCount,
+            .gpioPin = i,
+            .readPeriodSec = 10.0,
+            .initial = false,
+        });
+    }
+    return config;
+}
+
+/**
+ * @brief Send @edgeCount edges in bursts of @burst edges per line, round
+ * robin, to the pins served by the @model, and print the system calls per edge
+ * made by the pin threads or the workers.
+ *
+ * @return False if not all the edges were served.
+ */
+bool runLoad(Model model, unsigned burst)
+{
+    countSystemCalls = false;
+    vector<string> names;
+    vector<GpioEmbeddedPinConfig> table = createConfig(names);
+    FakeLines lines(names, chipCount);
+    if (!lines.isReady())
+    {
+        return false;
+    }
+
+    PeerBuses buses;
+    if (!buses.isReady())
+    {
+        fprintf(stderr, "Failed to connect the peer buses\n");
+        return false;
+    }
+    boost::asio::io_context io;
+    auto conn = make_shared<sdbusplus::asio::connection>(io, buses.client);
+    sdbusplus::asio::object_server server(conn);
+    GpioJsonConfig config(table);
+    GpioStats stats(io, config);
+    GpioChangeLog changeLog(config, 64);
+    GpioPublisher publisher(createPinInterface(server, config, changeLog),
+                            stats.getGlobalStats(), changeLog);
+    vector<MonitoredPin> pins =
+        createMonitoredPins(config, stats, lines.getLineMap());
+    GpioLoopMonitor loopMonitor(io, stats.getGlobalStats(), 1000000000);
+    vector<thread> pinThreads;
+    optional<GpioWorkerPool> pool;
+    if (model == Model::pinThreads)
+    {
+        for (auto& pin : pins)
+        {
+            pin.heartbeat = &loopMonitor.addLoop(pin.pinName);
+        }
+        startThreads(pinThreads, publisher, pins);
+    }
+    else
+    {
+        pool.emplace(io, publisher, pins, workerCount, loopMonitor,
+                     BusReadPolicy{}, model == Model::ioUring);
+        pool->start();
+    }
+
+    atomic<bool> running = true;
+    thread serverThread([&] {
+        countSystemCalls = false;
+        auto work = boost::asio::make_work_guard(io);
+        io.run();
+    });
+    thread peerThread([&] {
+        countSystemCalls = false;
+        while (running)
+        {
+            buses.drainPeer();
+            sd_bus_wait(buses.peer, 100000);
+        }
+    });
+    // Let the workers settle before counting
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    uint64_t callsBefore = systemCalls.load();
+    uint64_t wakeupsBefore = stats.getGlobalStats().wakeups.get();
+    unsigned sent = 0;
+    for (unsigned round = 0; sent < edgeCount; ++round)
+    {
+        unsigned line = round % lineCount;
+        if (!lines.sendEdges(line, burst, burst % 2))
+        {
+            perror("write");
+            break;
+        }
+        sent += burst;
+        // A pause per round over all the lines, so the edges of a line
+        // come in the given bursts rather than piling up further
+        if (line == lineCount - 1)
+        {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+    uint64_t served = 0;
+    for (int tries = 0; tries < 400 && served < sent; ++tries)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        served = 0;
+        for (const auto& pin : pins)
+        {
+            served += pin.stats->edges.get();
+        }
+    }
+    uint64_t calls = systemCalls.load() - callsBefore;
+    uint64_t wakeups = stats.getGlobalStats().wakeups.get() - wakeupsBefore;
+
+    if (pool)
+    {
+        pool->stop();
+    }
+    runThreads = false;
+    finishThreads(pinThreads);
+    io.stop();
+    running = false;
+    serverThread.join();
+    peerThread.join();
+
+    const char* modelName = model == Model::pinThreads ? "threads"
+                            : model == Model::epoll    ? "epoll"
+                                                       : "io_uring";
+    printf("%-8s %2u edges/wakeup: %6lu edges, %7lu calls, %.2f per edge, "
+           "%lu wakeups\n",
+           modelName, burst, (unsigned long)served,
+           (unsigned long)calls, served > 0 ? (double)calls / served : 0.0,
+           (unsigned long)wakeups);
+    return served == sent;
+}
+
+} // namespace
+
+int main()
+{
+    onFakeValueRead = countSystemCall;
+    bool ok = true;
+    for (unsigned burst : edgesPerWakeup)
+    {
+        ok = runLoad(Model::pinThreads, burst) && ok;
+        ok = runLoad(Model::epoll, burst) && ok;
+#ifdef IO_URING_BACKEND
+        ok = runLoad(Model::ioUring, burst) && ok;
+#endif
+    }
+    return ok ? 0 : 1;
+}
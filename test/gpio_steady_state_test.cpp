@@ -0,0 +1,257 @@
+#include "gpio_fake_lines.hpp"
+#include "gpio_test_bus.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <gpio_alloc_count.hpp>
+#include <gpio_change_log.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_loop_monitor.hpp>
+#include <gpio_publisher.hpp>
+#include <gpio_stats.hpp>
+#include <gpio_workers.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace gpio_handler;
+
+namespace
+{
+
+/** @brief A single pin and a measured one, the two ways of publishing **/
+constexpr array<GpioEmbeddedPinConfig, 2> testConfig = {{
+    {
+        .name = "FAN0_TACH",
+        .gpioChip = 0,
+        .gpioPin = 2,
+        .readPeriodSec = 1.0,
+        .initial = false,
+        .mode = "measure",
+        .windowSec = 0.1,
+    },
+    {
+        .name = "PSU0_ALERT",
+        .gpioChip = 0,
+        .gpioPin = 1,
+        .readPeriodSec = 1.0,
+        .initial = false,
+    },
+}};
+
+constexpr uint64_t windowNs = 100000000;
+
+/** @brief Two pins on a faked chip, polled rarely enough for the edges alone
+ * to wake the worker up **/
+constexpr array<GpioEmbeddedPinConfig, 2> workerConfig = {{
+    {
+        .name = "PSU0_ALERT",
+        .gpioChip = 0,
+        .gpioPin = 0,
+        .readPeriodSec = 10.0,
+        .initial = false,
+    },
+    {
+        .name = "PSU1_ALERT",
+        .gpioChip = 0,
+        .gpioPin = 1,
+        .readPeriodSec = 10.0,
+        .initial = false,
+    },
+}};
+
+/** @brief Edges sent per round to every pin of @ref workerConfig **/
+constexpr unsigned workerBurst = 3;
+
+struct gpiod_line_event makeEvent(uint64_t timeNs, bool rising)
+{
+    struct gpiod_line_event event;
+    event.ts.tv_sec = timeNs / 1000000000;
+    event.ts.tv_nsec = timeNs % 1000000000;
+    event.event_type =
+        rising ? GPIOD_LINE_EVENT_RISING_EDGE : GPIOD_LINE_EVENT_FALLING_EDGE;
+    return event;
+}
+
+uint64_t getServedEdges(const vector<MonitoredPin>& pins)
+{
+    uint64_t served = 0;
+    for (const auto& pin : pins)
+    {
+        served += pin.stats->edges.get();
+    }
+    return served;
+}
+
+/** @brief Wait up to 2 s for @pins to have served @edges edges **/
+bool waitServed(const vector<MonitoredPin>& pins, uint64_t edges)
+{
+    for (int tries = 0; tries < 2000 && getServedEdges(pins) < edges; ++tries)
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return getServedEdges(pins) >= edges;
+}
+
+} // namespace
+
+void stopService(int exitCode)
+{
+    ADD_FAILURE() << "The service was stopped with " << exitCode;
+}
+
+/*
+ * Serve the edges of both pins the way the monitoring threads do, each inside
+ * a 'SteadyStateScope', up to the change log and the 'PropertiesChanged'
+ * signal. Only the allocations through operator new are counted, the sd-bus
+ * messages are allocated by libsystemd with malloc.
+ */
+TEST(SteadyState, EdgesArePublishedWithoutAllocations)
+{
+    PeerBuses buses;
+    ASSERT_TRUE(buses.isReady());
+    boost::asio::io_context io;
+    auto conn = make_shared<sdbusplus::asio::connection>(io, buses.client);
+    sdbusplus::asio::object_server server(conn);
+
+    GpioJsonConfig config(testConfig);
+    GpioStats stats(io, config);
+    GpioChangeLog changeLog(config, 1024);
+    GpioPublisher publisher(createPinInterface(server, config, changeLog),
+                            stats.getGlobalStats(), changeLog);
+    vector<MonitoredPin> pins = createMonitoredPins(config, stats, {});
+    ASSERT_EQ(pins.size(), 2u);
+    MonitoredPin& measured = pins[0];
+    MonitoredPin& alert = pins[1];
+    ASSERT_TRUE(measured.meter.has_value());
+
+    uint64_t startNs = EdgeMeter::nowNs();
+    measured.meter->start(startNs, false);
+    uint64_t allocations = getSteadyStateAllocations();
+    bool published = true;
+    PinMeasurement measurement;
+    for (unsigned i = 1; i <= 256 && published; ++i)
+    {
+        // Four edges per window, so every fourth closes one
+        uint64_t timeNs = startNs + i * (windowNs / 4);
+        bool rising = i % 2 != 0;
+        {
+            SteadyStateScope steadyState;
+            struct gpiod_line_event event = makeEvent(timeNs, rising);
+            publisher.onEdge(alert, 0, event);
+            published = publisher.publish(alert, rising, timeNs);
+            publisher.onEdge(measured, 0, event);
+            while (published &&
+                   measured.meter->closeWindow(timeNs, measurement))
+            {
+                published =
+                    publisher.publishMeasurement(measured, measurement, timeNs);
+            }
+            measured.meter->onEdge(timeNs, rising);
+        }
+        buses.drain();
+    }
+
+    EXPECT_TRUE(published);
+    EXPECT_EQ(getSteadyStateAllocations() - allocations, 0u);
+    EXPECT_EQ(changeLog.getValue(alert.propertyIndex), 0u);
+    EXPECT_EQ(changeLog.getValue(measured.propertyIndex),
+              measured.publishedMeasurement.edgeCount);
+    EXPECT_EQ(measured.publishedMeasurement.edgeCount, 4u);
+}
+
+/*
+ * Run a worker of the pool over lines faked by pipes (see 'FakeLines'), so
+ * the edges are taken by the real worker loop, handed over and published by
+ * the DBus server thread, both in their steady state. The first round, which
+ * lets the lazily built state settle, is not counted.
+ */
+TEST(SteadyState, WorkerLoopServesEdgesWithoutAllocations)
+{
+    vector<string> names;
+    for (const auto& pin : workerConfig)
+    {
+        names.push_back(string(pin.name));
+    }
+    FakeLines lines(names, 1);
+    ASSERT_TRUE(lines.isReady());
+    PeerBuses buses;
+    ASSERT_TRUE(buses.isReady());
+    boost::asio::io_context io;
+    auto conn = make_shared<sdbusplus::asio::connection>(io, buses.client);
+    sdbusplus::asio::object_server server(conn);
+
+    GpioJsonConfig config(workerConfig);
+    GpioStats stats(io, config);
+    GpioChangeLog changeLog(config, 1024);
+    GpioPublisher publisher(createPinInterface(server, config, changeLog),
+                            stats.getGlobalStats(), changeLog);
+    vector<MonitoredPin> pins =
+        createMonitoredPins(config, stats, lines.getLineMap());
+    ASSERT_EQ(pins.size(), names.size());
+    GpioLoopMonitor loopMonitor(io, stats.getGlobalStats(), 1000000000);
+    GpioWorkerPool pool(io, publisher, pins, 1, loopMonitor);
+    pool.start();
+
+    atomic<bool> running = true;
+    thread serverThread([&] {
+        auto work = boost::asio::make_work_guard(io);
+        io.run();
+    });
+    thread peerThread([&] {
+        while (running)
+        {
+            buses.drainPeer();
+            sd_bus_wait(buses.peer, 100000);
+        }
+    });
+
+    uint64_t sent = 0;
+    uint64_t allocations = 0;
+    bool served = true;
+    for (unsigned round = 0; round < 64 && served; ++round)
+    {
+        for (unsigned i = 0; i < names.size() && served; ++i)
+        {
+            served = lines.sendEdges(i, workerBurst, round % 2);
+            sent += workerBurst;
+        }
+        served = served && waitServed(pins, sent);
+        if (round == 0)
+        {
+            allocations = getSteadyStateAllocations();
+        }
+    }
+    // The last values, handed over after the edges
+    for (int tries = 0; tries < 2000; ++tries)
+    {
+        if (changeLog.getValue(pins[0].propertyIndex) == 1 &&
+            changeLog.getValue(pins[1].propertyIndex) == 1)
+        {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    uint64_t steadyAllocations = getSteadyStateAllocations() - allocations;
+
+    pool.stop();
+    io.stop();
+    running = false;
+    serverThread.join();
+    peerThread.join();
+
+    EXPECT_TRUE(served);
+    EXPECT_EQ(steadyAllocations, 0u);
+    EXPECT_EQ(changeLog.getValue(pins[0].propertyIndex), 1u);
+    EXPECT_EQ(changeLog.getValue(pins[1].propertyIndex), 1u);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-id128.h>
+
+#include <gpio_change_log.hpp>
+#include <gpio_json_config.hpp>
+#include <gpio_status_dbus.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <memory>
+
+namespace gpio_handler
+{
+
+/**
+ * @brief Two sd-bus connections talking to each other over a socket pair,
+ * so that the properties are signalled by the real sd-bus without any bus
+ * daemon
+ *
+ * The @ref client carries the object, the @ref peer only takes in the
+ * signals.
+ */
+class PeerBuses
+{
+  public:
+    PeerBuses()
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        {
+            return;
+        }
+        sd_id128_t id;
+        sd_id128_randomize(&id);
+        sd_bus_new(&peer);
+        sd_bus_set_fd(peer, fds[0], fds[0]);
+        sd_bus_set_server(peer, 1, id);
+        sd_bus_new(&client);
+        sd_bus_set_fd(client, fds[1], fds[1]);
+        if (sd_bus_start(peer) < 0 || sd_bus_start(client) < 0)
+        {
+            return;
+        }
+        // The authentication, over the local socket pair
+        for (int i = 0; i < 1000 && !isReady(); ++i)
+        {
+            sd_bus_process(peer, nullptr);
+            sd_bus_process(client, nullptr);
+        }
+    }
+
+    ~PeerBuses()
+    {
+        sd_bus_flush_close_unref(client);
+        sd_bus_flush_close_unref(peer);
+    }
+
+    PeerBuses(const PeerBuses&) = delete;
+    PeerBuses& operator=(const PeerBuses&) = delete;
+
+    bool isReady() const
+    {
+        return client != nullptr && peer != nullptr &&
+               sd_bus_is_ready(client) > 0 && sd_bus_is_ready(peer) > 0;
+    }
+
+    /** @brief Take in the signals sent so far, so the socket never fills
+     * up **/
+    void drain()
+    {
+        sd_bus_flush(client);
+        drainPeer();
+    }
+
+    /** @brief Take in the signals received by the @ref peer so far, without
+     * touching the @ref client, which may be used by another thread **/
+    void drainPeer()
+    {
+        while (sd_bus_process(peer, nullptr) > 0)
+        {}
+    }
+
+    sd_bus* client = nullptr;
+    sd_bus* peer = nullptr;
+};
+
+/** @brief The service's pin object with the properties of @config, read
+ * from @changeLog like in 'createDbusObject' **/
+inline std::shared_ptr<sdbusplus::asio::dbus_interface>
+    createPinInterface(sdbusplus::asio::object_server& server,
+                       const GpioJsonConfig& config, GpioChangeLog& changeLog)
+{
+    auto dbusInterface =
+        server.add_interface(dbusObjectPath, dbusInterfaceName);
+    uint16_t propertyIndex = 0;
+    for (const auto& pin : config.getPins())
+    {
+        for (const auto& property : GpioJsonConfig::getProperties(pin))
+        {
+            GpioChangeLog* changes = &changeLog;
+            if (property.isInteger)
+            {
+                dbusInterface->register_property_r(
+                    property.name, property.initial,
+                    sdbusplus::vtable::property_::emits_change,
+                    [changes, propertyIndex](const uint64_t&) {
+                        return changes->getValue(propertyIndex);
+                    });
+            }
+            else
+            {
+                dbusInterface->register_property_r(
+                    property.name, property.initial != 0,
+                    sdbusplus::vtable::property_::emits_change,
+                    [changes, propertyIndex](const bool&) {
+                        return changes->getValue(propertyIndex) != 0;
+                    });
+            }
+            ++propertyIndex;
+        }
+    }
+    dbusInterface->initialize();
+    return dbusInterface;
+}
+
+} // namespace gpio_handler